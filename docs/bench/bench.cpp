@@ -0,0 +1,469 @@
+// End-to-end frame benchmark. Renders synthetic scenes headless (e.g. on
+// lavapipe) and measures the cpu time of the frame phases and the gpu time
+// of the frame. Writes the results as json.
+// Usage: rvg_bench [--rects n] [--circles n] [--strokes n] [--texts n]
+//   [--paints n] [--churn fraction] [--frames n] [--warmup n]
+//   [--size n] [--font file] [--always-record] [--deferred]
+//   [--threads n] [--out file]
+
+#include <rvg/context.hpp>
+#include <rvg/headless.hpp>
+#include <rvg/shapes.hpp>
+#include <rvg/polygon.hpp>
+#include <rvg/paint.hpp>
+#include <rvg/text.hpp>
+#include <rvg/font.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/state.hpp>
+
+#include <vpp/vk.hpp>
+#include <vpp/device.hpp>
+#include <vpp/instance.hpp>
+#include <vpp/queue.hpp>
+#include <vpp/submit.hpp>
+#include <vpp/commandBuffer.hpp>
+#include <nytl/matOps.hpp>
+#include <nytl/vecOps.hpp>
+#include <dlg/dlg.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef RVG_BENCH_FONT
+	#define RVG_BENCH_FONT "OpenSans-Regular.ttf"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+	unsigned rects {1000};
+	unsigned circles {1000};
+	unsigned strokes {500};
+	unsigned texts {200};
+	unsigned paints {16};
+	float churn {0.05f}; // fraction of objects changed per frame
+	unsigned frames {200};
+	unsigned warmup {10};
+	unsigned size {1024};
+	std::string font {RVG_BENCH_FONT};
+	std::string out {"rvg_bench.json"};
+	bool alwaysRecord {}; // record every frame, not only when needed
+	bool deferred {};
+	unsigned threads {};
+};
+
+// Durations of all measured frames in microseconds
+struct Phase {
+	const char* name;
+	std::vector<double> samples;
+};
+
+bool parse(int argc, char** argv, Config& config) {
+	auto next = [&](int& i) -> const char* {
+		if(i + 1 >= argc) {
+			std::cerr << "Missing value for " << argv[i] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		return argv[++i];
+	};
+
+	for(auto i = 1; i < argc; ++i) {
+		auto arg = std::string(argv[i]);
+		if(arg == "--rects") {
+			config.rects = std::atoi(next(i));
+		} else if(arg == "--circles") {
+			config.circles = std::atoi(next(i));
+		} else if(arg == "--strokes") {
+			config.strokes = std::atoi(next(i));
+		} else if(arg == "--texts") {
+			config.texts = std::atoi(next(i));
+		} else if(arg == "--paints") {
+			config.paints = std::max(std::atoi(next(i)), 1);
+		} else if(arg == "--churn") {
+			config.churn = std::clamp(float(std::atof(next(i))), 0.f, 1.f);
+		} else if(arg == "--frames") {
+			config.frames = std::max(std::atoi(next(i)), 1);
+		} else if(arg == "--warmup") {
+			config.warmup = std::atoi(next(i));
+		} else if(arg == "--size") {
+			config.size = std::max(std::atoi(next(i)), 1);
+		} else if(arg == "--font") {
+			config.font = next(i);
+		} else if(arg == "--out") {
+			config.out = next(i);
+		} else if(arg == "--always-record") {
+			config.alwaysRecord = true;
+		} else if(arg == "--deferred") {
+			config.deferred = true;
+		} else if(arg == "--threads") {
+			config.threads = std::atoi(next(i));
+		} else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// The synthetic scene. All coordinates are in pixels.
+class Scene {
+public:
+	Scene(rvg::Context& ctx, const Config& config) : config_(config) {
+		auto mat = nytl::identity<4, float>();
+		mat[0][0] = 2.f / config.size;
+		mat[1][1] = 2.f / config.size;
+		mat[0][3] = -1.f;
+		mat[1][3] = -1.f;
+		transform_ = {ctx, mat};
+
+		auto pos = position();
+		std::uniform_real_distribution<float> size(2.f, 50.f);
+
+		auto fill = rvg::DrawMode {true, 0.f};
+		rects_.reserve(config.rects);
+		for(auto i = 0u; i < config.rects; ++i) {
+			auto round = (i % 2) ? 4.f : 0.f;
+			rects_.emplace_back(ctx, nytl::Vec2f{pos(rng_), pos(rng_)},
+				nytl::Vec2f{size(rng_), size(rng_)}, fill,
+				std::array<float, 4>{round, round, round, round});
+		}
+
+		circles_.reserve(config.circles);
+		for(auto i = 0u; i < config.circles; ++i) {
+			circles_.emplace_back(ctx, nytl::Vec2f{pos(rng_), pos(rng_)},
+				0.5f * size(rng_), fill);
+		}
+
+		strokes_.reserve(config.strokes);
+		for(auto i = 0u; i < config.strokes; ++i) {
+			strokes_.emplace_back(ctx);
+			updateStroke(strokes_.back());
+		}
+
+		if(config.texts) {
+			font_ = {ctx, config.font};
+			texts_.reserve(config.texts);
+			for(auto i = 0u; i < config.texts; ++i) {
+				texts_.emplace_back(ctx, nytl::Vec2f{pos(rng_), pos(rng_)},
+					text(), font_, 12u);
+			}
+		}
+
+		paints_.reserve(config.paints);
+		for(auto i = 0u; i < config.paints; ++i) {
+			paints_.emplace_back(ctx, rvg::colorPaint(color()));
+		}
+	}
+
+	// Changes churn * count objects of each kind
+	void change() {
+		auto count = [&](auto size) {
+			return unsigned(std::ceil(config_.churn * size));
+		};
+
+		auto pos = position();
+		for(auto i = 0u; i < count(rects_.size()); ++i) {
+			auto& rect = rects_[next_++ % rects_.size()];
+			rect.change()->position = {pos(rng_), pos(rng_)};
+		}
+
+		for(auto i = 0u; i < count(circles_.size()); ++i) {
+			auto& circle = circles_[next_++ % circles_.size()];
+			circle.change()->center = {pos(rng_), pos(rng_)};
+		}
+
+		for(auto i = 0u; i < count(strokes_.size()); ++i) {
+			updateStroke(strokes_[next_++ % strokes_.size()]);
+		}
+
+		for(auto i = 0u; i < count(texts_.size()); ++i) {
+			texts_[next_++ % texts_.size()].change()->text = text();
+		}
+
+		for(auto i = 0u; i < count(paints_.size()); ++i) {
+			auto& paint = paints_[next_++ % paints_.size()];
+			paint.paint(rvg::colorPaint(color()));
+		}
+	}
+
+	void draw(rvg::Recorder& rec) const {
+		auto paint = [&](auto i) -> auto& {
+			return paints_[i % paints_.size()];
+		};
+
+		transform_.bind(rec);
+		for(auto i = 0u; i < rects_.size(); ++i) {
+			paint(i).bind(rec);
+			rects_[i].fill(rec);
+		}
+
+		for(auto i = 0u; i < circles_.size(); ++i) {
+			paint(i).bind(rec);
+			circles_[i].fill(rec);
+		}
+
+		for(auto i = 0u; i < strokes_.size(); ++i) {
+			paint(i).bind(rec);
+			strokes_[i].stroke(rec);
+		}
+
+		for(auto i = 0u; i < texts_.size(); ++i) {
+			paint(i).bind(rec);
+			texts_[i].draw(rec);
+		}
+	}
+
+protected:
+	std::uniform_real_distribution<float> position() const {
+		auto max = 0.95f * config_.size;
+		return std::uniform_real_distribution<float>(0.f, max);
+	}
+
+	void updateStroke(rvg::Polygon& polygon) {
+		auto pos = position();
+		std::uniform_real_distribution<float> offset(-50.f, 50.f);
+		std::uniform_int_distribution<unsigned> count(2u, 32u);
+		std::vector<nytl::Vec2f> points(count(rng_));
+		auto start = nytl::Vec2f{pos(rng_), pos(rng_)};
+		for(auto& point : points) {
+			point = start + nytl::Vec2f{offset(rng_), offset(rng_)};
+		}
+
+		auto mode = rvg::DrawMode {false, 2.f};
+		mode.aaStroke = true;
+		polygon.update(points, mode);
+	}
+
+	std::string text() {
+		std::uniform_int_distribution<unsigned> length(4u, 32u);
+		std::uniform_int_distribution<int> chars('a', 'z');
+		std::string ret(length(rng_), ' ');
+		for(auto& c : ret) {
+			c = char(chars(rng_));
+		}
+
+		return ret;
+	}
+
+	rvg::Color color() {
+		std::uniform_int_distribution<unsigned> channel(0u, 255u);
+		return {rvg::u8(channel(rng_)), rvg::u8(channel(rng_)),
+			rvg::u8(channel(rng_))};
+	}
+
+protected:
+	const Config& config_;
+	std::mt19937 rng_ {42u}; // fixed seed, results must be comparable
+	unsigned next_ {};
+
+	rvg::Transform transform_;
+	std::vector<rvg::RectShape> rects_;
+	std::vector<rvg::CircleShape> circles_;
+	std::vector<rvg::Polygon> strokes_;
+	std::vector<rvg::Text> texts_;
+	std::vector<rvg::Paint> paints_;
+	rvg::Font font_;
+};
+
+double elapsed(Clock::time_point start) {
+	auto diff = Clock::now() - start;
+	return std::chrono::duration<double, std::micro>(diff).count();
+}
+
+// The samples must be sorted
+void writeStats(std::ostream& os, const Phase& phase) {
+	auto& samples = phase.samples;
+	auto sum = 0.0;
+	for(auto s : samples) {
+		sum += s;
+	}
+
+	auto n = samples.size();
+	auto at = [&](double q) { return samples[std::size_t(q * (n - 1))]; };
+	os << "\t\t\"" << phase.name << "\": {"
+		<< "\"mean_us\": " << (n ? sum / n : 0.0) << ", "
+		<< "\"median_us\": " << (n ? at(0.5) : 0.0) << ", "
+		<< "\"p95_us\": " << (n ? at(0.95) : 0.0) << ", "
+		<< "\"min_us\": " << (n ? samples.front() : 0.0) << ", "
+		<< "\"max_us\": " << (n ? samples.back() : 0.0) << "}";
+}
+
+int main(int argc, char** argv) {
+	Config config;
+	if(!parse(argc, argv, config)) {
+		return EXIT_FAILURE;
+	}
+
+	// no surface or validation, we render headless
+	vk::InstanceCreateInfo instanceInfo;
+	vpp::Instance instance {instanceInfo};
+	vpp::Device dev {instance};
+	auto& props = dev.properties();
+	dlg_info("Device: {}", props.deviceName.data());
+
+	rvg::HeadlessTarget target(dev, {config.size, config.size});
+	auto settings = target.contextSettings();
+	settings.deferredUpdate = config.deferred;
+	settings.updateThreads = config.threads;
+	rvg::Context ctx(dev, settings);
+
+	auto setupStart = Clock::now();
+	Scene scene(ctx, config);
+	ctx.updateDevice();
+	auto setup = elapsed(setupStart);
+
+	// two timestamps around all draws
+	auto& qs = dev.queueSubmitter();
+	auto family = qs.queue().family();
+	auto families = vk::getPhysicalDeviceQueueFamilyProperties(
+		dev.vkPhysicalDevice());
+	auto gpuTiming = families[family].timestampValidBits != 0;
+	vk::QueryPoolCreateInfo queryInfo;
+	queryInfo.queryType = vk::QueryType::timestamp;
+	queryInfo.queryCount = 2u;
+	auto queryPool = vk::createQueryPool(dev, queryInfo);
+
+	auto cmdBuf = dev.commandAllocator().get(family,
+		vk::CommandPoolCreateBits::resetCommandBuffer);
+	auto record = [&]{
+		vk::beginCommandBuffer(cmdBuf, {});
+		vk::cmdResetQueryPool(cmdBuf, queryPool, 0, 2);
+		vk::cmdWriteTimestamp(cmdBuf, vk::PipelineStageBits::topOfPipe,
+			queryPool, 0);
+		target.beginRenderPass(cmdBuf, {1.f, 1.f, 1.f, 1.f});
+
+		rvg::Recorder rec(ctx, cmdBuf);
+		ctx.bindDefaults(rec);
+		scene.draw(rec);
+
+		target.endRenderPass(cmdBuf);
+		vk::cmdWriteTimestamp(cmdBuf, vk::PipelineStageBits::bottomOfPipe,
+			queryPool, 1);
+		vk::endCommandBuffer(cmdBuf);
+	};
+
+	record();
+
+	Phase update {"update", {}};
+	Phase updateDevice {"updateDevice", {}};
+	Phase stageUpload {"stageUpload", {}};
+	Phase recording {"record", {}};
+	Phase gpu {"gpu", {}};
+	Phase frame {"frame", {}};
+	auto rerecords = 0u;
+
+	for(auto i = 0u; i < config.warmup + config.frames; ++i) {
+		auto measure = i >= config.warmup;
+		auto frameStart = Clock::now();
+
+		auto start = Clock::now();
+		scene.change();
+		auto tUpdate = elapsed(start);
+
+		start = Clock::now();
+		auto rerecord = ctx.updateDevice();
+		auto tUpdateDevice = elapsed(start);
+
+		auto tRecord = 0.0;
+		if(rerecord || config.alwaysRecord) {
+			start = Clock::now();
+			record();
+			tRecord = elapsed(start);
+			rerecords += measure && rerecord;
+		}
+
+		start = Clock::now();
+		auto semaphore = ctx.stageUpload();
+		auto tStage = elapsed(start);
+
+		vk::SubmitInfo submission;
+		submission.commandBufferCount = 1u;
+		submission.pCommandBuffers = &cmdBuf.vkHandle();
+		auto stage = vk::PipelineStageFlags(
+			vk::PipelineStageBits::allGraphics);
+		if(semaphore) {
+			submission.pWaitSemaphores = &semaphore;
+			submission.pWaitDstStageMask = &stage;
+			submission.waitSemaphoreCount = 1u;
+		}
+
+		qs.wait(qs.add(submission));
+		auto tFrame = elapsed(frameStart);
+
+		if(!measure) {
+			continue;
+		}
+
+		update.samples.push_back(tUpdate);
+		updateDevice.samples.push_back(tUpdateDevice);
+		stageUpload.samples.push_back(tStage);
+		recording.samples.push_back(tRecord);
+		frame.samples.push_back(tFrame);
+
+		if(gpuTiming) {
+			std::uint64_t stamps[2];
+			vk::getQueryPoolResults(dev, queryPool, 0, 2, sizeof(stamps),
+				stamps, sizeof(stamps[0]), vk::QueryResultBits::e64 |
+				vk::QueryResultBits::wait);
+			auto ticks = double(stamps[1] - stamps[0]);
+			gpu.samples.push_back(ticks * props.limits.timestampPeriod * 1e-3);
+		}
+	}
+
+	vk::destroyQueryPool(dev, queryPool);
+
+	std::ofstream out(config.out);
+	if(!out.is_open()) {
+		std::cerr << "Can't open " << config.out << "\n";
+		return EXIT_FAILURE;
+	}
+
+	out << std::boolalpha << "{\n"
+		<< "\t\"device\": \"" << props.deviceName.data() << "\",\n"
+		<< "\t\"config\": {"
+		<< "\"rects\": " << config.rects << ", "
+		<< "\"circles\": " << config.circles << ", "
+		<< "\"strokes\": " << config.strokes << ", "
+		<< "\"texts\": " << config.texts << ", "
+		<< "\"paints\": " << config.paints << ", "
+		<< "\"churn\": " << config.churn << ", "
+		<< "\"frames\": " << config.frames << ", "
+		<< "\"size\": " << config.size << ", "
+		<< "\"alwaysRecord\": " << config.alwaysRecord << ", "
+		<< "\"deferred\": " << config.deferred << ", "
+		<< "\"threads\": " << config.threads << "},\n"
+		<< "\t\"setup_us\": " << setup << ",\n"
+		<< "\t\"rerecords\": " << rerecords << ",\n"
+		<< "\t\"gpuTiming\": " << gpuTiming << ",\n"
+		<< "\t\"phases\": {\n";
+
+	auto first = true;
+	for(auto* phase : {&update, &updateDevice, &recording, &stageUpload,
+			&gpu, &frame}) {
+		if(!first) {
+			out << ",\n";
+		}
+
+		first = false;
+		auto& samples = phase->samples;
+		std::sort(samples.begin(), samples.end());
+		writeStats(out, *phase);
+		std::cout << phase->name << ": " << (samples.empty() ? 0.0 :
+			samples[samples.size() / 2]) << "us (median)\n";
+	}
+
+	out << "\n\t}\n}\n";
+	std::cout << "rerecords: " << rerecords << "\n"
+		<< "results written to " << config.out << "\n";
+}
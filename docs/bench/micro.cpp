@@ -0,0 +1,462 @@
+// Cpu microbenchmarks of the host side hot paths: tessellation, shape
+// outlines, text layout and color conversions. Doesn't need a gpu.
+// Reports the time and the number of heap allocations per operation,
+// sweeping point counts, stroke widths, aa and color flags and
+// string lengths.
+// Usage: rvg_microbench [--filter substring] [--min-time ms] [--reps n]
+//   [--font file] [--out file]
+
+#include <rvg/polygon.hpp>
+#include <rvg/shapes.hpp>
+#include <rvg/paint.hpp>
+#include <rvg/text.hpp>
+#include <rvg/fontstash.h>
+
+#include <nytl/math.hpp>
+#include <nytl/vecOps.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef RVG_BENCH_FONT
+	#define RVG_BENCH_FONT "OpenSans-Regular.ttf"
+#endif
+
+// Counts all allocations of the program, including the ones in rvg,
+// katachi and fontstash (which uses malloc though).
+namespace {
+std::atomic<std::size_t> allocations {};
+} // anon namespace
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if(auto ptr = std::malloc(size ? size : 1)) {
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using rvg::Vec2f;
+using rvg::Vec4u8;
+
+struct Config {
+	std::string filter;
+	double minTime {0.05}; // seconds per repetition
+	unsigned reps {5};
+	std::string font {RVG_BENCH_FONT};
+	std::string out {"rvg_microbench.json"};
+};
+
+struct Result {
+	std::string name;
+	std::string params;
+	double ns; // median over the repetitions
+	double allocs;
+	std::size_t iterations; // per repetition
+};
+
+bool parse(int argc, char** argv, Config& config) {
+	auto next = [&](int& i) -> const char* {
+		if(i + 1 >= argc) {
+			std::cerr << "Missing value for " << argv[i] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		return argv[++i];
+	};
+
+	for(auto i = 1; i < argc; ++i) {
+		auto arg = std::string(argv[i]);
+		if(arg == "--filter") {
+			config.filter = next(i);
+		} else if(arg == "--min-time") {
+			config.minTime = std::max(std::atof(next(i)), 1.0) / 1000.0;
+		} else if(arg == "--reps") {
+			config.reps = std::max(std::atoi(next(i)), 1);
+		} else if(arg == "--font") {
+			config.font = next(i);
+		} else if(arg == "--out") {
+			config.out = next(i);
+		} else {
+			std::cerr << "Unknown argument " << arg << "\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Prevents the compiler from optimizing the computation of value away
+template<typename T>
+void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r"(&value) : "memory");
+#else
+	static volatile const void* sink;
+	sink = &value;
+#endif
+}
+
+class Runner {
+public:
+	Runner(const Config& config) : config_(config) {}
+
+	// Runs func repeatedly until minTime passed, config.reps times.
+	template<typename F>
+	void run(std::string name, std::string params, F&& func) {
+		auto full = name + "/" + params;
+		if(full.find(config_.filter) == std::string::npos) {
+			return;
+		}
+
+		// warmup, fills caches (e.g. the glyph cache) and
+		// finds the number of iterations per repetition
+		std::size_t iterations = 1;
+		while(true) {
+			auto start = Clock::now();
+			for(auto i = 0u; i < iterations; ++i) {
+				func();
+			}
+
+			std::chrono::duration<double> time = Clock::now() - start;
+			if(time.count() >= config_.minTime || iterations >= (1u << 30)) {
+				break;
+			}
+
+			auto factor = time.count() > 0.0 ?
+				1.2 * config_.minTime / time.count() : 16.0;
+			factor = std::clamp(factor, 2.0, 16.0);
+			iterations = std::size_t(iterations * factor);
+		}
+
+		std::vector<double> samples;
+		auto allocs = std::size_t(0);
+		for(auto r = 0u; r < config_.reps; ++r) {
+			auto allocsBefore = allocations.load(std::memory_order_relaxed);
+			auto start = Clock::now();
+			for(auto i = 0u; i < iterations; ++i) {
+				func();
+			}
+
+			std::chrono::duration<double, std::nano> time = Clock::now() - start;
+			allocs += allocations.load(std::memory_order_relaxed) - allocsBefore;
+			samples.push_back(time.count() / iterations);
+		}
+
+		std::sort(samples.begin(), samples.end());
+		auto ns = samples[samples.size() / 2];
+		auto perOp = double(allocs) / (double(iterations) * config_.reps);
+
+		std::printf("%-16s %-40s %12.1f ns/op %8.2f allocs/op\n",
+			name.c_str(), params.c_str(), ns, perOp);
+		results_.push_back({std::move(name), std::move(params), ns, perOp,
+			iterations});
+	}
+
+	const auto& results() const { return results_; }
+
+protected:
+	const Config& config_;
+	std::vector<Result> results_;
+};
+
+// A closed, non-convex star-like outline with the given number of
+// points (pixel coordinates), exercises miters in both directions.
+std::vector<Vec2f> outline(unsigned count) {
+	std::vector<Vec2f> points;
+	points.reserve(count + 1);
+	for(auto i = 0u; i < count; ++i) {
+		auto a = float(2 * nytl::constants::pi * i / count);
+		auto r = 200.f + ((i % 2) ? 20.f : -20.f);
+		points.push_back({500.f + r * std::cos(a), 500.f + r * std::sin(a)});
+	}
+
+	points.push_back(points.front());
+	return points;
+}
+
+std::vector<Vec4u8> colors(unsigned count) {
+	std::vector<Vec4u8> ret;
+	ret.reserve(count);
+	for(auto i = 0u; i < count; ++i) {
+		ret.push_back({std::uint8_t(i), std::uint8_t(3 * i),
+			std::uint8_t(255 - i), 255});
+	}
+
+	return ret;
+}
+
+std::string loremText(unsigned length) {
+	constexpr auto lorem = "Lorem ipsum dolor sit amet, consectetur "
+		"adipiscing elit, sed do eiusmod tempor incididunt ut labore et "
+		"dolore magna aliqua. ";
+	std::string ret;
+	while(ret.size() < length) {
+		ret += lorem;
+	}
+
+	ret.resize(length);
+	return ret;
+}
+
+std::string flags(bool aa, bool color) {
+	return std::string(aa ? "aa" : "noaa") + (color ? ",color" : "");
+}
+
+// Like Polygon, keeps the capacity of the vertex vectors across updates
+void clear(rvg::Vertices& v) {
+	v.points.clear();
+	v.aa.clear();
+	v.color.clear();
+}
+
+void tessellation(Runner& runner) {
+	rvg::Vertices fill, fillAA, stroke;
+	for(auto count : {8u, 64u, 512u, 4096u}) {
+		auto points = outline(count);
+		auto pointColors = colors(points.size());
+		auto pc = "points=" + std::to_string(count) + ",";
+
+		for(auto aa : {false, true}) {
+			for(auto color : {false, true}) {
+				rvg::DrawMode mode;
+				mode.fill = true;
+				mode.aaFill = aa;
+				mode.color.fill = color;
+				if(color) {
+					mode.color.points = pointColors;
+				}
+
+				runner.run("fill", pc + flags(aa, color), [&]{
+					clear(fill);
+					clear(fillAA);
+					rvg::tessellateFill(points, mode, fill, fillAA);
+					keep(fill.points.data());
+					keep(fillAA.points.data());
+				});
+			}
+		}
+
+		for(auto width : {1.f, 4.f, 16.f}) {
+			for(auto aa : {false, true}) {
+				for(auto color : {false, true}) {
+					rvg::DrawMode mode;
+					mode.stroke = width;
+					mode.aaStroke = aa;
+					mode.color.stroke = color;
+					if(color) {
+						mode.color.points = pointColors;
+					}
+
+					auto params = pc + "width=" +
+						std::to_string(unsigned(width)) + "," +
+						flags(aa, color);
+					runner.run("stroke", params, [&]{
+						clear(stroke);
+						rvg::tessellateStroke(points, mode, stroke);
+						keep(stroke.points.data());
+					});
+				}
+			}
+		}
+	}
+}
+
+void shapes(Runner& runner) {
+	// like RectShape::update and CircleShape::update, a new vector
+	// for every update
+	using Rounding = std::array<float, 4>;
+	auto roundings = {
+		std::pair{"none", Rounding{}},
+		std::pair{"one", Rounding{8.f, 0.f, 0.f, 0.f}},
+		std::pair{"all", Rounding{8.f, 8.f, 8.f, 8.f}},
+	};
+
+	for(auto& named : roundings) {
+		auto name = named.first;
+		auto rounding = named.second;
+		runner.run("rectOutline", std::string("rounding=") + name, [&]{
+			std::vector<Vec2f> points;
+			rvg::rectOutline(points, {10.f, 10.f}, {200.f, 100.f}, rounding);
+			keep(points.data());
+		});
+
+		// the complete update of an aa filled and stroked rect
+		rvg::DrawMode mode;
+		mode.fill = true;
+		mode.stroke = 2.f;
+		mode.aaFill = true;
+		mode.aaStroke = true;
+
+		rvg::Vertices fill, fillAA, stroke;
+		runner.run("rectUpdate", std::string("rounding=") + name, [&]{
+			std::vector<Vec2f> points;
+			rvg::rectOutline(points, {10.f, 10.f}, {200.f, 100.f}, rounding);
+			clear(fill);
+			clear(fillAA);
+			clear(stroke);
+			rvg::tessellateFill(points, mode, fill, fillAA);
+			rvg::tessellateStroke(points, mode, stroke);
+			keep(stroke.points.data());
+		});
+	}
+
+	for(auto count : {8u, 32u, 128u, 256u}) {
+		auto params = "points=" + std::to_string(count);
+		runner.run("circleOutline", params, [&]{
+			std::vector<Vec2f> points;
+			rvg::circleOutline(points, {100.f, 100.f}, {50.f, 40.f}, count);
+			keep(points.data());
+		});
+	}
+}
+
+// Uses a fontstash context directly since rvg's FontAtlas needs the
+// device, the layout and bounds are computed like Text and Font do.
+void text(Runner& runner, const Config& config) {
+	FONSparams params {};
+	params.flags = FONS_ZERO_TOPLEFT;
+	params.width = 1024;
+	params.height = 1024;
+
+	auto* stash = fonsCreateInternal(&params);
+	auto font = fonsAddFont(stash, "", config.font.c_str());
+	if(font == FONS_INVALID) {
+		std::cerr << "Can't load font " << config.font << ", skipping text\n";
+		fonsDeleteInternal(stash);
+		return;
+	}
+
+	std::vector<Vec2f> posCache, uvCache;
+	for(auto length : {8u, 64u, 512u}) {
+		auto string = loremText(length);
+		for(auto height : {14u, 48u}) {
+			auto p = "length=" + std::to_string(length) +
+				",height=" + std::to_string(height);
+
+			// like Text, keeps the capacity across layouts
+			runner.run("textLayout", p, [&]{
+				posCache.clear();
+				uvCache.clear();
+				rvg::layoutText(*stash, font, height, {}, string,
+					posCache, uvCache);
+				keep(posCache.data());
+			});
+
+			runner.run("fontBounds", p, [&]{
+				keep(rvg::textBounds(*stash, font, height, string));
+			});
+		}
+	}
+
+	fonsDeleteInternal(stash);
+}
+
+void color(Runner& runner) {
+	// cycle through different inputs to not measure a single branch
+	constexpr auto count = 256u;
+	std::vector<rvg::Color> inputs;
+	std::vector<nytl::Vec3f> norms;
+	for(auto i = 0u; i < count; ++i) {
+		auto c = rvg::Color(std::uint8_t(i), std::uint8_t(7 * i),
+			std::uint8_t(255 - 3 * i));
+		inputs.push_back(c);
+		norms.push_back(c.rgbNorm());
+	}
+
+	auto i = 0u;
+	auto input = [&]{ return inputs[i++ % count]; };
+	auto norm = [&]{ return norms[i++ % count]; };
+
+	runner.run("color", "rgbaNorm", [&]{ keep(input().rgbaNorm()); });
+	runner.run("color", "fromNorm", [&]{
+		auto n = norm();
+		keep(rvg::Color(rvg::norm, n[0], n[1], n[2]));
+	});
+	runner.run("color", "hslNorm", [&]{ keep(rvg::hslNorm(input())); });
+	runner.run("color", "hsvNorm", [&]{ keep(rvg::hsvNorm(input())); });
+	runner.run("color", "fromHslNorm", [&]{
+		auto n = norm();
+		keep(rvg::hslNorm(n[0], n[1], n[2]));
+	});
+	runner.run("color", "fromHsvNorm", [&]{
+		auto n = norm();
+		keep(rvg::hsvNorm(n[0], n[1], n[2]));
+	});
+	runner.run("color", "hsl2hsv", [&]{ keep(rvg::hsl2hsv(norm())); });
+	runner.run("color", "linearize", [&]{ keep(rvg::linearize(input())); });
+	runner.run("color", "srgb", [&]{
+		auto n = norm();
+		keep(rvg::srgb({n[0], n[1], n[2], 1.f}));
+	});
+	runner.run("color", "u32rgba", [&]{ keep(rvg::u32rgba(input())); });
+	runner.run("color", "mix", [&]{
+		keep(rvg::mix(input(), input(), 0.3f));
+	});
+}
+
+} // anon namespace
+
+int main(int argc, char** argv) {
+	Config config;
+	if(!parse(argc, argv, config)) {
+		return EXIT_FAILURE;
+	}
+
+	Runner runner(config);
+	tessellation(runner);
+	shapes(runner);
+	text(runner, config);
+	color(runner);
+
+	std::ofstream out(config.out);
+	if(!out) {
+		std::cerr << "Can't open " << config.out << "\n";
+		return EXIT_FAILURE;
+	}
+
+	out << "{\n"
+		<< "\t\"minTime_ms\": " << config.minTime * 1000.0 << ",\n"
+		<< "\t\"reps\": " << config.reps << ",\n"
+		<< "\t\"results\": [\n";
+
+	auto first = true;
+	for(auto& res : runner.results()) {
+		if(!first) {
+			out << ",\n";
+		}
+
+		first = false;
+		out << "\t\t{\"name\": \"" << res.name << "\", "
+			<< "\"params\": \"" << res.params << "\", "
+			<< "\"ns_per_op\": " << res.ns << ", "
+			<< "\"allocs_per_op\": " << res.allocs << ", "
+			<< "\"iterations\": " << res.iterations << "}";
+	}
+
+	out << "\n\t]\n}\n";
+	std::cout << "results written to " << config.out << "\n";
+}
@@ -2,6 +2,28 @@
 
 #include <rvg/context.hpp>
 #include <rvg/polygon.hpp>
+#include <rvg/shapes.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/drawBatch.hpp>
+#include <rvg/geometry.hpp>
+#include <rvg/layer.hpp>
+#include <rvg/cachedGroup.hpp>
+#include <rvg/damage.hpp>
+#include <rvg/state.hpp>
+#include <rvg/trace.hpp>
+#include <nytl/matOps.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "main.hpp"
 
 TEST(basicSetup) {
@@ -63,3 +85,728 @@ TEST(basicSetup) {
 
 	renderSubmit(ctx, cmdBuf);
 }
+
+TEST(deferredUpdate) {
+	rvg::ContextSettings settings;
+	settings.deferredUpdate = true;
+	auto pctx = createContext(settings);
+	auto& ctx = *pctx;
+	EXPECT(ctx.deferredUpdates(), true);
+
+	rvg::DrawMode mode {true, 2.f};
+	rvg::RectShape rect {ctx, {10.f, 10.f}, {100.f, 100.f}, mode};
+	std::vector<rvg::Polygon> polygons;
+	for(auto i = 0u; i < 64; ++i) {
+		auto x = float(i);
+		auto points = {nytl::Vec2f{x, 0.f}, nytl::Vec2f{x + 10.f, 5.f},
+			nytl::Vec2f{x, 10.f}};
+		polygons.emplace_back(ctx).update(points, mode);
+	}
+
+	// the shape is computed in its constructor
+	ctx.updateDevice();
+	EXPECT(ctx.frameStats().tessellations, 65u);
+
+	// multiple changes in one frame, baked once in updateDevice.
+	// moving polygons around must keep their registration
+	rect.change()->position = {20.f, 20.f};
+	rect.change()->size = {50.f, 50.f};
+	rect.change()->rounding = {5.f, 5.f, 5.f, 5.f};
+	polygons.erase(polygons.begin() + 3);
+	EXPECT(ctx.frameStats().tessellations, 65u);
+	ctx.updateDevice();
+	EXPECT(ctx.frameStats().tessellations, 1u);
+
+	auto points = {nytl::Vec2f{0.f, 0.f}, nytl::Vec2f{10.f, 5.f},
+		nytl::Vec2f{0.f, 10.f}};
+	polygons[7].update(points, mode);
+	polygons[7].disable(true, rvg::DrawType::fill);
+	polygons[7].update(points, mode);
+	ctx.updateDevice();
+	EXPECT(ctx.frameStats().tessellations, 1u);
+
+	rvg::Paint paint {ctx, rvg::colorPaint(rvg::Color::red)};
+	ctx.updateDevice();
+
+	auto cmdBuf = record(ctx, [&](auto& di){
+		paint.bind(di);
+		rect.fill(di);
+		for(auto& polygon : polygons) {
+			polygon.stroke(di);
+		}
+	});
+
+	renderSubmit(ctx, cmdBuf);
+}
+
+TEST(recorder) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	rvg::DrawMode mode {true, 0.f};
+	rvg::RectShape r1 {ctx, {10.f, 10.f}, {100.f, 100.f}, mode};
+	rvg::RectShape r2 {ctx, {50.f, 50.f}, {100.f, 100.f}, mode};
+	rvg::Paint paint {ctx, rvg::colorPaint(rvg::Color::red)};
+	ctx.updateDevice();
+
+	rvg::Recorder::Stats stats;
+	auto cmdBuf = record(ctx, [&](auto& cb){
+		rvg::Recorder rec(ctx, cb);
+		ctx.bindDefaults(rec);
+		paint.bind(rec);
+		r1.fill(rec);
+		paint.bind(rec);
+		r2.fill(rec);
+		stats = rec.stats();
+	});
+
+	EXPECT(stats.pipelineBinds, 1u);
+	EXPECT(stats.pipelineBindsElided, 1u);
+	EXPECT(stats.pushConstants, 1u);
+	EXPECT(stats.pushConstantsElided, 1u);
+	EXPECT(stats.descriptorBindsElided, 1u);
+	EXPECT(stats.draws, 2u);
+
+	renderSubmit(ctx, cmdBuf);
+}
+
+TEST(drawBatch) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	rvg::DrawBatch batch {ctx, rvg::DrawType::fill};
+	std::vector<rvg::Polygon> polygons;
+	polygons.reserve(16);
+	for(auto i = 0u; i < 16; ++i) {
+		auto x = 20.f * i;
+		auto points = {nytl::Vec2f{x, 0.f}, nytl::Vec2f{x + 10.f, 0.f},
+			nytl::Vec2f{x + 10.f, 10.f}};
+		polygons.emplace_back(ctx).update(points, {true});
+		batch.add(polygons.back());
+	}
+
+	EXPECT(batch.size(), 16u);
+	EXPECT(ctx.updateDevice(), true);
+
+	// disabling polygons must not require a rerecord
+	polygons[3].disable(true);
+	EXPECT(ctx.updateDevice(), false);
+
+	polygons.pop_back();
+	EXPECT(batch.size(), 15u);
+
+	// polygons without fill vertices (only stroked or not updated yet)
+	// are allowed and draw nothing
+	auto points = {nytl::Vec2f{0.f, 0.f}, nytl::Vec2f{1.f, 1.f}};
+	rvg::Polygon stroked(ctx);
+	stroked.update(points, {false, 1.f});
+	rvg::Polygon pending(ctx);
+	batch.add(stroked);
+	batch.add(pending);
+	EXPECT(batch.size(), 17u);
+
+	rvg::Paint paint {ctx, rvg::colorPaint(rvg::Color::green)};
+	ctx.updateDevice();
+
+	auto cmdBuf = record(ctx, [&](auto& di){
+		paint.bind(di);
+		batch.draw(di);
+	});
+
+	renderSubmit(ctx, cmdBuf);
+
+	// the commands of a replaced batch are kept alive for pending frames
+	batch = {ctx, rvg::DrawType::fill};
+	EXPECT(batch.size(), 0u);
+	EXPECT(stroked.valid(), true);
+	ctx.updateDevice();
+	ctx.stageUpload();
+}
+
+TEST(geometryArena) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+	auto& arena = ctx.geometryArena();
+
+	{
+		std::vector<rvg::Polygon> polygons;
+		for(auto i = 0u; i < 256; ++i) {
+			auto x = float(i);
+			auto points = {nytl::Vec2f{x, 0.f}, nytl::Vec2f{x + 10.f, 5.f},
+				nytl::Vec2f{x, 10.f}};
+			polygons.emplace_back(ctx).update(points, {true});
+		}
+
+		rvg::Paint paint {ctx, rvg::colorPaint(rvg::Color::green)};
+		ctx.updateDevice();
+
+		// one block for the indirect commands, one for the vertices
+		EXPECT(arena.used() > 0u, true);
+		EXPECT(arena.capacity(), rvg::GeometryArena::blockSize +
+			rvg::GeometryArena::smallBlockSize);
+
+		auto cmdBuf = record(ctx, [&](auto& di){
+			paint.bind(di);
+			for(auto& polygon : polygons) {
+				polygon.fill(di);
+			}
+		});
+
+		renderSubmit(ctx, cmdBuf);
+
+		// growing polygons move inside the block, no rerecord needed
+		for(auto i = 0u; i < polygons.size(); i += 16) {
+			std::vector<nytl::Vec2f> points;
+			for(auto j = 0u; j < 64 + i; ++j) {
+				points.push_back({float(j), float(j % 2)});
+			}
+
+			polygons[i].update(points, {true});
+		}
+
+		EXPECT(ctx.updateDevice(), false);
+		renderSubmit(ctx, cmdBuf);
+	}
+
+	EXPECT(arena.used(), 0u);
+}
+
+TEST(arenaResize) {
+	rvg::ContextSettings settings;
+	settings.framesInFlight = 2u;
+	auto pctx = createContext(settings);
+	auto& ctx = *pctx;
+	auto& arena = ctx.geometryArena();
+
+	auto triangle = {nytl::Vec2f{0.f, 0.f}, nytl::Vec2f{10.f, 5.f},
+		nytl::Vec2f{0.f, 10.f}};
+	rvg::Polygon polygon(ctx);
+	polygon.update(triangle, {true});
+	ctx.updateDevice();
+	ctx.stageUpload();
+	auto used = arena.used();
+
+	// growing moves the vertices, the old ones might still be read
+	// by the pending frame and are not reused until it completed
+	std::vector<nytl::Vec2f> points;
+	for(auto i = 0u; i < 256; ++i) {
+		points.push_back({float(i), float(i % 2)});
+	}
+
+	polygon.update(points, {true});
+	ctx.updateDevice();
+	auto grown = arena.used();
+	EXPECT(grown >= used + 256 * rvg::GeometryArena::stride(
+		rvg::VertexFormat::position), true);
+
+	for(auto i = 0u; i <= settings.framesInFlight; ++i) {
+		ctx.stageUpload();
+	}
+
+	EXPECT(arena.used() < grown, true);
+}
+
+TEST(stage) {
+	rvg::ContextSettings settings;
+	settings.framesInFlight = 1u;
+	auto pctx = createContext(settings);
+	auto& ctx = *pctx;
+	auto& stats = ctx.frameStats();
+	ctx.updateDevice();
+
+	// ranges are bump allocated from the persistently mapped arena,
+	// aligned for image copies
+	auto a = ctx.stage(3u);
+	auto b = ctx.stage(8u);
+	auto arena = a.span.buffer().vkHandle();
+	EXPECT(b.span.buffer().vkHandle() == arena, true);
+	EXPECT(b.span.offset(), a.span.offset() + 4u);
+	EXPECT(b.span.size(), 8u);
+	EXPECT(b.data - a.data, 4);
+
+	// a range that doesn't fit gets a new, larger arena.
+	// The whole range is mapped
+	constexpr auto large = vk::DeviceSize(1024u * 1024u);
+	auto c = ctx.stage(large);
+	EXPECT(c.span.buffer().vkHandle() != arena, true);
+	EXPECT(c.span.size(), large);
+	std::memset(c.data, 0xFF, large);
+
+	ctx.updateDevice();
+	EXPECT(stats.bytesStaged, 3u + 8u + large);
+	EXPECT(stats.stagingBuffers >= 1u, true);
+
+	// the larger arena is kept when the frame is reused
+	ctx.stageUpload();
+	auto d = ctx.stage(16u);
+	EXPECT(d.span.buffer().vkHandle() == c.span.buffer().vkHandle(), true);
+	EXPECT(d.span.offset(), c.span.offset());
+	EXPECT(d.data == c.data, true);
+
+	ctx.updateDevice();
+	EXPECT(stats.bytesStaged, 16u);
+	EXPECT(stats.stagingBuffers, 0u);
+}
+
+TEST(retire) {
+	rvg::ContextSettings settings;
+	settings.framesInFlight = 2u;
+	auto pctx = createContext(settings);
+	auto& ctx = *pctx;
+	auto& arena = ctx.geometryArena();
+
+	auto points = {nytl::Vec2f{0.f, 0.f}, nytl::Vec2f{10.f, 5.f},
+		nytl::Vec2f{0.f, 10.f}};
+	rvg::DrawMode mode {true, 2.f};
+	mode.aaStroke = true;
+	auto polygon = std::make_optional<rvg::Polygon>(ctx);
+	polygon->update(points, mode);
+	auto paint = std::make_optional<rvg::Paint>(ctx,
+		rvg::colorPaint(rvg::Color::red));
+	auto transform = std::make_optional<rvg::Transform>(ctx);
+	ctx.updateDevice();
+
+	auto cmdBuf = record(ctx, [&](auto& cb){
+		transform->bind(cb);
+		paint->bind(cb);
+		polygon->fill(cb);
+		polygon->stroke(cb);
+	});
+
+	// submit without waiting, the frame is still pending when the
+	// objects are destroyed
+	auto semaphore = ctx.stageUpload();
+	auto stage = vk::PipelineStageFlags(vk::PipelineStageBits::allGraphics);
+	vk::SubmitInfo submission;
+	submission.commandBufferCount = 1u;
+	submission.pCommandBuffers = &cmdBuf.vkHandle();
+	if(semaphore) {
+		submission.pWaitSemaphores = &semaphore;
+		submission.pWaitDstStageMask = &stage;
+		submission.waitSemaphoreCount = 1u;
+	}
+
+	auto& qs = ctx.device().queueSubmitter();
+	auto id = qs.add(submission);
+	qs.submit();
+
+	auto used = arena.used();
+	EXPECT(used > 0u, true);
+	polygon.reset();
+	paint.reset();
+	transform.reset();
+
+	// the ranges are not reused while the frame might be pending
+	rvg::Polygon other(ctx);
+	other.update(points, mode);
+	ctx.updateDevice();
+	EXPECT(arena.used() > used, true);
+	other = {};
+	qs.wait(id);
+
+	// released once the frame is reused, i.e. framesInFlight + 1
+	// stageUpload calls later. Validation layers report resources
+	// destroyed while in use as errors.
+	for(auto i = 0u; i < settings.framesInFlight; ++i) {
+		ctx.stageUpload();
+		EXPECT(arena.used() > 0u, true);
+	}
+
+	ctx.stageUpload();
+	EXPECT(arena.used(), 0u);
+}
+
+TEST(objectBookkeeping) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+	auto& stats = ctx.frameStats();
+	ctx.updateDevice();
+
+	// many registered objects that are moved (the vector grows without
+	// reserve) and destroyed. Each of them must be updated exactly once
+	constexpr auto count = 4096u;
+	std::vector<rvg::Transform> transforms;
+	for(auto i = 0u; i < count; ++i) {
+		auto mat = nytl::identity<4, float>();
+		mat[0][3] = float(i);
+		transforms.emplace_back(ctx, false).matrix(mat);
+	}
+
+	transforms.erase(transforms.begin(), transforms.begin() + count / 2);
+	EXPECT(transforms.front().matrix()[0][3], float(count / 2));
+	ctx.updateDevice();
+	EXPECT(stats.updatedCount<rvg::Transform>(), count / 2);
+
+	// registering twice, swapping and moving registered objects
+	for(auto& transform : transforms) {
+		transform.update();
+		transform.update();
+	}
+
+	std::swap(transforms.front(), transforms.back());
+	auto moved = std::move(transforms[1]);
+	EXPECT(transforms[1].valid(), false);
+	transforms[1] = std::move(moved);
+	EXPECT(moved.valid(), false);
+	ctx.updateDevice();
+	EXPECT(stats.updatedCount<rvg::Transform>(), count / 2);
+
+	// destroying registered objects
+	for(auto& transform : transforms) {
+		transform.update();
+	}
+
+	transforms.resize(count / 8);
+	ctx.updateDevice();
+	EXPECT(stats.updatedCount<rvg::Transform>(), count / 8);
+
+	ctx.updateDevice();
+	EXPECT(stats.updatedCount<rvg::Transform>(), 0u);
+}
+
+TEST(layer) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	auto points = {nytl::Vec2f{0.f, 0.f}, nytl::Vec2f{10.f, 5.f},
+		nytl::Vec2f{0.f, 10.f}};
+	rvg::Polygon p1(ctx);
+	rvg::Polygon p2(ctx);
+	p1.update(points, {true});
+	p2.update(points, {true});
+
+	rvg::Paint paint {ctx, rvg::colorPaint(rvg::Color::red)};
+	ctx.updateDevice();
+
+	rvg::Layer l1(ctx, [&](auto& rec) { paint.bind(rec); p1.fill(rec); });
+	rvg::Layer l2(ctx, [&](auto& rec) { paint.bind(rec); p2.fill(rec); });
+	EXPECT(ctx.invalidLayers().size(), 2u);
+	EXPECT(l1.record(), true);
+	EXPECT(l2.record(), true);
+	EXPECT(l1.record(), false);
+	EXPECT(ctx.invalidLayers().empty(), true);
+
+	// changing the draw mode only invalidates the layer using it
+	auto mode = rvg::DrawMode {true};
+	mode.aaFill = true;
+	p2.update(points, mode);
+	EXPECT(ctx.updateDevice(), true);
+	auto invalid = ctx.invalidLayers();
+	EXPECT(invalid.size(), 1u);
+	EXPECT(invalid[0] == &l2, true);
+	EXPECT(l2.record(), true);
+
+	// changing the paint color only changes the data both use, the
+	// descriptor set is only recreated when the texture changes
+	l1.clearChanged();
+	l2.clearChanged();
+	paint.paint(rvg::colorPaint(rvg::Color::blue));
+	EXPECT(ctx.updateDevice(), false);
+	EXPECT(l1.invalid(), false);
+	EXPECT(l2.invalid(), false);
+	EXPECT(l1.changed(), true);
+	EXPECT(l2.changed(), true);
+
+	// moving objects keeps the layer valid, destroying them not
+	l1.record();
+	l2.record();
+	{
+		auto moved = std::move(p1);
+		EXPECT(l1.invalid(), false);
+	}
+
+	EXPECT(l1.invalid(), true);
+	EXPECT(l2.invalid(), false);
+}
+
+TEST(cachedGroup) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	// the cached image has the size of the framebuffer and the edges
+	// are on pixel boundaries, drawing it must give the same pixels
+	// as drawing the polygon directly
+	auto points = {nytl::Vec2f{-0.5f, -0.5f}, nytl::Vec2f{0.5f, -0.5f},
+		nytl::Vec2f{0.5f, 0.5f}, nytl::Vec2f{-0.5f, 0.5f}};
+	rvg::Polygon polygon(ctx);
+	polygon.update(points, {true});
+	rvg::Paint paint {ctx, rvg::colorPaint(rvg::Color::red)};
+
+	auto area = nytl::Rect2f {{-1.f, -1.f}, {2.f, 2.f}};
+	rvg::CachedGroup group(ctx, area, {fbExtent.width, fbExtent.height},
+		globals.target->format(), [&](auto& rec) {
+			paint.bind(rec);
+			polygon.fill(rec);
+		});
+
+	ctx.updateDevice();
+	EXPECT(group.needsRender(), true);
+
+	auto read = [](const vpp::SubBuffer& img) {
+		auto map = img.memoryMap();
+		auto data = reinterpret_cast<const std::uint8_t*>(map.ptr());
+		return std::vector<std::uint8_t>(data, data + img.size());
+	};
+
+	auto direct = [&]{
+		vpp::SubBuffer img;
+		auto cmdBuf = record(ctx, [&](auto& cb) {
+			paint.bind(cb);
+			polygon.fill(cb);
+		}, [&](auto& cb) {
+			img = readImage(cb);
+		});
+
+		renderSubmit(ctx, cmdBuf);
+		return read(img);
+	};
+
+	auto same = [](const auto& a, const auto& b) {
+		return a.size() == b.size() && std::equal(a.begin(), a.end(),
+			b.begin(), [](auto x, auto y) {
+				return std::abs(int(x) - int(y)) <= 1;
+			});
+	};
+
+	auto center = [](const auto& pixels) {
+		return pixels.data() + 4 * (fbExtent.height / 2 * fbExtent.width +
+			fbExtent.width / 2);
+	};
+
+	// renders the group in stageUpload
+	vpp::SubBuffer img;
+	auto cmdBuf = record(ctx, [&](auto& cb) { group.draw(cb); },
+		[&](auto& cb) { img = readImage(cb); });
+	renderSubmit(ctx, cmdBuf);
+	EXPECT(group.needsRender(), false);
+
+	auto cached = read(img);
+	EXPECT(unsigned(center(cached)[0]), 255u);
+	EXPECT(unsigned(center(cached)[1]), 0u);
+	EXPECT(same(cached, direct()), true);
+
+	// only updates of the used objects render it again
+	rvg::Paint other {ctx, rvg::colorPaint(rvg::Color::blue)};
+	ctx.updateDevice();
+	EXPECT(group.needsRender(), false);
+
+	paint.paint(rvg::colorPaint(rvg::Color::green));
+	EXPECT(ctx.updateDevice(), false);
+	EXPECT(group.needsRender(), true);
+	renderSubmit(ctx, cmdBuf);
+	EXPECT(group.needsRender(), false);
+
+	cached = read(img);
+	EXPECT(unsigned(center(cached)[0]), 0u);
+	EXPECT(unsigned(center(cached)[1]), 255u);
+	EXPECT(same(cached, direct()), true);
+}
+
+TEST(damage) {
+	rvg::ContextSettings settings;
+	settings.damageTracking = true;
+	auto pctx = createContext(settings);
+	auto& ctx = *pctx;
+	auto& damage = *ctx.damageTracker();
+
+	// coordinates are in normalized device coordinates with identity
+	std::vector<nytl::Vec2f> points1 = {{-0.5f, -0.5f}, {0.f, -0.5f},
+		{0.f, 0.f}};
+	auto points2 = {nytl::Vec2f{0.5f, 0.5f}, nytl::Vec2f{1.f, 0.5f},
+		nytl::Vec2f{1.f, 1.f}};
+	rvg::Polygon p1(ctx);
+	rvg::Polygon p2(ctx);
+	p1.update(points1, {true});
+	p2.update(points2, {true});
+	rvg::Paint paint {ctx, rvg::colorPaint(rvg::Color::red)};
+	rvg::Transform transform {ctx};
+	ctx.updateDevice();
+	EXPECT(damage.idle(), true);
+
+	// new draws are damage
+	auto cmdBuf = record(ctx, [&](auto& cb) {
+		rvg::Recorder rec(ctx, cb);
+		ctx.bindDefaults(rec);
+		paint.bind(rec);
+		p1.fill(rec);
+		transform.bind(rec);
+		p2.fill(rec);
+	});
+
+	EXPECT(damage.rects().size(), 2u);
+	renderSubmit(ctx, cmdBuf);
+
+	// nothing changed
+	ctx.updateDevice();
+	EXPECT(damage.idle(), true);
+
+	// only the previous and new bounds of the updated polygon
+	points1 = {{-0.5f, -0.5f}, {-0.25f, -0.5f}, {-0.25f, -0.25f}};
+	p1.update(points1, {true});
+	ctx.updateDevice();
+	EXPECT(damage.rects().size(), 1u);
+	auto scissor = damage.scissor({200u, 200u});
+	EXPECT(scissor.offset.x, 50);
+	EXPECT(scissor.offset.y, 50);
+	EXPECT(scissor.extent.width, 50u);
+	EXPECT(scissor.extent.height, 50u);
+
+	// the draws using the transform, before and after
+	auto mat = nytl::identity<4, float>();
+	mat[0][3] = -0.25f;
+	transform.matrix(mat);
+	ctx.updateDevice();
+	EXPECT(damage.rects().size(), 1u);
+	auto bounds = damage.bounds();
+	EXPECT(bounds.position.x, 0.25f);
+	EXPECT(bounds.size.x, 0.75f);
+	renderSubmit(ctx, cmdBuf);
+
+	// destroyed objects are damage
+	ctx.updateDevice();
+	{
+		auto destroyed = std::move(p2);
+	}
+
+	EXPECT(damage.idle(), false);
+}
+
+TEST(frameStats) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+	auto& stats = ctx.frameStats();
+
+	auto causedBy = [&](const rvg::Polygon& obj, std::string_view cause) {
+		return std::any_of(stats.rerecords.begin(), stats.rerecords.end(),
+			[&](auto& r) { return r.object == &obj && r.cause == cause; });
+	};
+
+	auto points = {nytl::Vec2f{0.f, 0.f}, nytl::Vec2f{1.f, 0.f},
+		nytl::Vec2f{1.f, 1.f}};
+	rvg::DrawMode deviceLocal {true};
+	deviceLocal.deviceLocal = true;
+	rvg::Polygon p1(ctx);
+	rvg::Polygon p2(ctx);
+	p1.update(points, {true});
+	p2.update(points, deviceLocal);
+	ctx.updateDevice();
+	EXPECT(stats.updatedCount<rvg::Polygon>(), 2u);
+	EXPECT(stats.bytesWritten > 0u, true);
+	EXPECT(stats.bytesStaged > 0u, true);
+	EXPECT(causedBy(p1, "Polygon: command allocated"), true);
+
+	// nothing changed
+	EXPECT(ctx.updateDevice(), false);
+	EXPECT(stats.updatedCount<rvg::Polygon>(), 0u);
+	EXPECT(stats.bytesWritten, 0u);
+	EXPECT(stats.rerecords.empty(), true);
+
+	rvg::DrawMode aa {true};
+	aa.aaFill = true;
+	p1.update(points, aa);
+	EXPECT(ctx.updateDevice(), true);
+	EXPECT(stats.updatedCount<rvg::Polygon>(), 1u);
+	EXPECT(causedBy(p1, "Polygon: aaFill changed"), true);
+	EXPECT(causedBy(p2, "Polygon: aaFill changed"), false);
+}
+
+TEST(trace) {
+	constexpr auto file = "rvg_context_trace.json";
+	if(!rvg::traceAvailable()) {
+		EXPECT(rvg::startTrace(file), false);
+		return;
+	}
+
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+	auto& stats = ctx.frameStats();
+
+	auto points = {nytl::Vec2f{0.f, 0.f}, nytl::Vec2f{1.f, 0.f},
+		nytl::Vec2f{1.f, 1.f}};
+	rvg::DrawMode deviceLocal {true};
+	deviceLocal.deviceLocal = true;
+	rvg::Polygon p1(ctx);
+	rvg::Polygon p2(ctx);
+	p1.update(points, {true});
+	p2.update(points, deviceLocal);
+
+	EXPECT(rvg::startTrace(file), true);
+	EXPECT(ctx.updateDevice(), true);
+	rvg::stopTrace();
+
+	std::string trace;
+	{
+		std::ifstream ifs(file);
+		trace.assign(std::istreambuf_iterator<char>(ifs), {});
+	}
+	std::remove(file);
+
+	constexpr std::string_view header =
+		"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	constexpr std::string_view footer = "\n]}\n";
+	EXPECT(trace.compare(0, header.size(), header) == 0, true);
+	EXPECT(trace.size() > header.size() + footer.size(), true);
+	EXPECT(trace.compare(trace.size() - footer.size(), footer.size(),
+		footer) == 0, true);
+
+	// one event per line, all of them have the bytes argument
+	auto bytes = [](const std::string& event) {
+		auto pos = event.find("\"bytes\":");
+		if(pos == event.npos) {
+			return ~0ull;
+		}
+
+		return std::strtoull(event.c_str() + pos + 8, nullptr, 10);
+	};
+
+	std::istringstream events(trace);
+	std::string event;
+	unsigned long long uploaded {};
+	unsigned polygonUploads {};
+	std::optional<unsigned long long> frame;
+	while(std::getline(events, event)) {
+		if(event.find("\"name\":\"upload140\"") != event.npos) {
+			uploaded += bytes(event);
+			if(event.find("\"type\":\"Polygon\"") != event.npos) {
+				++polygonUploads;
+			}
+		} else if(event.find("\"name\":\"Context::updateDevice\"") !=
+				event.npos) {
+			EXPECT(frame.has_value(), false);
+			EXPECT(event.find("\"rerecord\":true") != event.npos, true);
+			frame = bytes(event);
+		}
+	}
+
+	// the updateDevice event contains the nested uploads, the
+	// bytes are counted exactly once
+	auto total = stats.bytesStaged + stats.bytesWritten;
+	EXPECT(total > 0u, true);
+	EXPECT(polygonUploads > 0u, true);
+	EXPECT(frame.has_value(), true);
+	EXPECT(frame.value_or(0u), total);
+	EXPECT(uploaded, total);
+}
+
+TEST(pipelineCacheFile) {
+	constexpr auto file = "rvg_context_cache.bin";
+	std::remove(file);
+
+	// pipelines are only created on first use and then saved
+	auto settings = globals.target->contextSettings();
+	settings.pipelineCacheFile = file;
+	{
+		rvg::Context ctx(*globals.device, settings);
+		EXPECT(bool(ctx.pipelineCache()), true);
+		EXPECT(std::ifstream(file).good(), false);
+		EXPECT(bool(ctx.fanPipe()), true);
+	}
+
+	EXPECT(std::ifstream(file).good(), true);
+
+	// loaded again
+	rvg::Context ctx(*globals.device, settings);
+	EXPECT(bool(ctx.pipelineCache()), true);
+	EXPECT(ctx.savePipelineCache(), true);
+	std::remove(file);
+}
@@ -2,8 +2,10 @@
 #include <bugged.hpp>
 
 #include <rvg/context.hpp>
+#include <rvg/headless.hpp>
 #include <vpp/vk.hpp>
 #include <vpp/memory.hpp>
+#include <vpp/memoryMap.hpp>
 #include <vpp/device.hpp>
 #include <vpp/submit.hpp>
 #include <vpp/queue.hpp>
@@ -17,8 +19,11 @@
 #include <vpp/debug.hpp>
 #include <vpp/physicalDevice.hpp>
 #include <dlg/dlg.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
 class CustomDebugCallback : public vpp::DebugCallback {
 public:
@@ -51,10 +56,10 @@ struct Globals {
 	vpp::Instance instance;
 	std::optional<CustomDebugCallback> debugCallback;
 	std::optional<vpp::Device> device;
+	const vpp::Queue* transferQueue {}; // of another family, if any
+	bool dynamicIndexing {}; // needed for bindless mode
 
-	vpp::RenderPass rp;
-	vpp::ViewableImage attachment;
-	vpp::Framebuffer fb;
+	std::optional<rvg::HeadlessTarget> target;
 
 	vpp::PipelineCache cache;
 };
@@ -79,53 +84,60 @@ void initGlobals() {
 
 	globals.instance = {instanceInfo};
 	globals.debugCallback.emplace(globals.instance);
-	globals.device.emplace(globals.instance);
+
+	// a graphics queue and, if available, one of another family
+	// for the transferQueue tests
+	auto phdevs = vk::enumeratePhysicalDevices(globals.instance);
+	auto phdev = vpp::choose(phdevs);
+	auto families = vk::getPhysicalDeviceQueueFamilyProperties(phdev);
+	std::optional<unsigned> gfam, tfam;
+	for(auto i = 0u; i < families.size(); ++i) {
+		if(families[i].queueFlags & vk::QueueBits::graphics) {
+			gfam = i;
+			break;
+		}
+	}
+
+	dlg_assert(gfam);
+	auto transferFlags = vk::QueueBits::transfer | vk::QueueBits::compute |
+		vk::QueueBits::graphics;
+	for(auto i = 0u; i < families.size(); ++i) {
+		if(i != *gfam && (families[i].queueFlags & transferFlags)) {
+			tfam = i;
+			break;
+		}
+	}
+
+	float priorities[1] = {0.0};
+	std::vector<vk::DeviceQueueCreateInfo> queueInfos;
+	queueInfos.push_back({{}, *gfam, 1u, priorities});
+	if(tfam) {
+		queueInfos.push_back({{}, *tfam, 1u, priorities});
+	}
+
+	// enable what the bindless tests need, when supported
+	auto supported = vk::getPhysicalDeviceFeatures(phdev);
+	auto features = vk::PhysicalDeviceFeatures {};
+	features.shaderSampledImageArrayDynamicIndexing =
+		supported.shaderSampledImageArrayDynamicIndexing;
+	globals.dynamicIndexing = supported.shaderSampledImageArrayDynamicIndexing;
+
+	vk::DeviceCreateInfo devInfo;
+	devInfo.pQueueCreateInfos = queueInfos.data();
+	devInfo.queueCreateInfoCount = queueInfos.size();
+	devInfo.pEnabledFeatures = &features;
+
+	globals.device.emplace(globals.instance, phdev, devInfo);
 	auto& dev = *globals.device;
+	if(tfam) {
+		globals.transferQueue = dev.queue(*tfam);
+	}
 
 	dlg_info("Physical device info:\n\t{}",
 		vpp::description(globals.device->vkPhysicalDevice(), "\n\t"));
 
-	auto usage = vk::ImageUsageBits::colorAttachment |
-		vk::ImageUsageBits::transferSrc;
-	globals.attachment = {dev, *vpp::ViewableImageCreateInfo::color(dev,
-		fbExtent, usage)};
-
-	vk::AttachmentDescription attachment;
-	attachment.format = vk::Format::r8g8b8a8Unorm;
-	attachment.samples = vk::SampleCountBits::e1;
-	attachment.loadOp = vk::AttachmentLoadOp::clear;
-	attachment.storeOp = vk::AttachmentStoreOp::store;
-	attachment.stencilLoadOp = vk::AttachmentLoadOp::dontCare;
-	attachment.stencilStoreOp = vk::AttachmentStoreOp::dontCare;
-	attachment.initialLayout = vk::ImageLayout::undefined;
-	attachment.finalLayout = vk::ImageLayout::transferSrcOptimal;
-
-	vk::AttachmentReference colorReference;
-	colorReference.attachment = 0;
-	colorReference.layout = vk::ImageLayout::colorAttachmentOptimal;
-
-	vk::SubpassDescription subpass;
-	subpass.pipelineBindPoint = vk::PipelineBindPoint::graphics;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorReference;
-
-	vk::RenderPassCreateInfo renderPassInfo;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &attachment;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-
-	globals.rp = {dev, renderPassInfo};
-
-	vk::FramebufferCreateInfo fbInfo;
-	fbInfo.renderPass = globals.rp;
-	fbInfo.attachmentCount = 1;
-	fbInfo.pAttachments = &globals.attachment.vkImageView();
-	fbInfo.width = fbExtent.width;
-	fbInfo.height = fbExtent.height;
-	fbInfo.layers = 1u;
-
-	globals.fb = {dev, fbInfo};
+	globals.target.emplace(dev, nytl::Vec2ui{fbExtent.width,
+		fbExtent.height});
 	globals.cache = {dev, pipeCacheFile};
 }
 
@@ -139,9 +151,7 @@ int main() {
 
 	// TODO: get this implicitly with RAII or at least a single "= {}"
 	// explicitly destroy resources for errors
-	globals.fb = {};
-	globals.rp = {};
-	globals.attachment = {};
+	globals.target.reset();
 	globals.cache = {};
 
 	globals.device.reset();
@@ -156,41 +166,26 @@ int main() {
 	return ret;
 }
 
-std::unique_ptr<rvg::Context> createContext() {
-	rvg::ContextSettings settings;
-	settings.renderPass = globals.rp;
-	settings.subpass = 0u;
+std::unique_ptr<rvg::Context> createContext(
+		rvg::ContextSettings settings = {}) {
+	auto target = globals.target->contextSettings();
+	settings.renderPass = target.renderPass;
+	settings.subpass = target.subpass;
 	settings.pipelineCache = globals.cache;
 	return std::make_unique<rvg::Context>(*globals.device, settings);
 }
 
 template<typename F1, typename F2 = bool>
 vpp::CommandBuffer record(rvg::Context& ctx, F1&& renderer, F2&& after = {}) {
-	const auto clearValue = vk::ClearValue {{0.f, 0.f, 0.f, 1.f }};
-	auto width = fbExtent.width;
-	auto height = fbExtent.height;
-
 	auto& dev = ctx.device();
 	auto qf = dev.queueSubmitter().queue().family();
 	auto cmdBuf = dev.commandAllocator().get(qf);
 
 	vk::beginCommandBuffer(cmdBuf, {});
-	vk::cmdBeginRenderPass(cmdBuf, {
-		globals.rp,
-		globals.fb,
-		{0u, 0u, width, height},
-		1,
-		&clearValue
-	}, {});
-
-	vk::Viewport vp {0.f, 0.f, (float) width, (float) height, 0.f, 1.f};
-	vk::cmdSetViewport(cmdBuf, 0, 1, vp);
-	vk::cmdSetScissor(cmdBuf, 0, 1, {0, 0, width, height});
-
+	globals.target->beginRenderPass(cmdBuf);
 	ctx.bindDefaults(cmdBuf);
 	renderer(cmdBuf);
-
-	vk::cmdEndRenderPass(cmdBuf);
+	globals.target->endRenderPass(cmdBuf);
 
 	if constexpr(!std::is_same_v<F2, bool>) {
 		after(cmdBuf);
@@ -220,11 +215,17 @@ void renderSubmit(rvg::Context& ctx, vk::CommandBuffer cmdBuf) {
 }
 
 vpp::SubBuffer readImage(vk::CommandBuffer cb) {
-	auto& a = globals.attachment;
-	auto range = vpp::retrieveStaging(cb, a.image(),
-		vk::Format::r8g8b8a8Unorm,
-		vk::ImageLayout::transferSrcOptimal, fbExtent,
-		{vk::ImageAspectBits::color, 0,  0});
+	return globals.target->read(cb);
+}
+
+/// Returns the rgba pixel at the given position of an image read back
+/// with readImage.
+const std::uint8_t* pixel(const std::byte* data, unsigned x, unsigned y) {
+	auto ptr = reinterpret_cast<const std::uint8_t*>(data);
+	return ptr + 4 * (y * fbExtent.width + x);
+}
 
-	return range;
+const std::uint8_t* pixel(const vpp::MemoryMapView& map,
+		unsigned x, unsigned y) {
+	return pixel(map.ptr(), x, y);
 }
@@ -1,6 +1,15 @@
 #include <rvg/context.hpp>
 #include <rvg/polygon.hpp>
 #include <rvg/shapes.hpp>
+#include <rvg/sdf.hpp>
+#include <rvg/shapeBatch.hpp>
+#include <rvg/textureAtlas.hpp>
+#include <rvg/spriteBatch.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/timer.hpp>
+#include <nytl/matOps.hpp>
+#include <vector>
+#include <cmath>
 #include "main.hpp"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -30,3 +39,619 @@ TEST(rect) {
 	stbi_write_png("1.png", fbExtent.width, fbExtent.height, 4u,
 		map.ptr(), fbExtent.width * 4u);
 }
+
+TEST(gpuTimer) {
+	rvg::ContextSettings settings {};
+	settings.gpuTiming = true;
+	auto pctx = createContext(settings);
+	auto& ctx = *pctx;
+
+	auto* timer = ctx.gpuTimer();
+	EXPECT(timer != nullptr, true);
+	if(!timer->supported()) {
+		return;
+	}
+
+	auto paint = rvg::Paint(ctx, rvg::colorPaint(rvg::Color::red));
+	auto shape = rvg::RectShape(ctx, {-1.f, -1.f}, {2.f, 2.f}, {true, 0.f});
+
+	ctx.updateDevice();
+	auto cmdBuf = record(ctx, [&](auto& cb){
+		rvg::Recorder rec(ctx, cb);
+		rvg::GpuTimer::Scope scope(rec, "rect");
+		ctx.bindDefaults(rec);
+		paint.bind(rec);
+		shape.fill(rec);
+	});
+
+	// the results of a frame are resolved two stageUpload calls later,
+	// the first frame after recording is dropped
+	for(auto i = 0u; i < 4u; ++i) {
+		ctx.updateDevice();
+		renderSubmit(ctx, cmdBuf);
+	}
+
+	auto& times = timer->times();
+	EXPECT(times.frame > 0u, true);
+	EXPECT(times.scopes.size(), 1u);
+	if(times.scopes.size() == 1u) {
+		auto& scope = times.scopes[0];
+		auto fill = scope.categories[unsigned(rvg::DrawCategory::fill)];
+		EXPECT(scope.name, std::string("rect"));
+		EXPECT(scope.ns >= fill, true);
+	}
+}
+
+TEST(pipelineVariants) {
+	// specialized pipelines must render the same as the generic ones
+	auto render = [](bool variants) {
+		rvg::ContextSettings settings {};
+		settings.pipelineVariants = variants;
+		auto pctx = createContext(settings);
+		auto& ctx = *pctx;
+
+		auto grad = rvg::Paint(ctx, rvg::linearGradient({-1.f, -1.f},
+			{1.f, 1.f}, rvg::Color::red, rvg::Color::blue));
+		auto color = rvg::Paint(ctx, rvg::colorPaint(rvg::Color::green));
+		auto left = rvg::RectShape(ctx, {-1.f, -1.f}, {1.f, 2.f},
+			{true, 0.f});
+		auto right = rvg::RectShape(ctx, {0.f, -1.f}, {1.f, 2.f},
+			{true, 0.05f, false, {}, false, true});
+
+		vpp::SubBuffer img;
+		ctx.updateDevice();
+		auto cmdBuf = record(ctx, [&](auto& cb){
+			rvg::Recorder rec(ctx, cb);
+			ctx.bindDefaults(rec);
+			grad.bind(rec);
+			left.fill(rec);
+			color.bind(rec);
+			right.fill(rec);
+			right.stroke(rec);
+		}, [&](auto& cb) {
+			img = readImage(cb);
+		});
+
+		renderSubmit(ctx, cmdBuf);
+
+		auto map = img.memoryMap();
+		auto ptr = reinterpret_cast<const std::byte*>(map.ptr());
+		return std::vector<std::byte>(ptr, ptr + img.size());
+	};
+
+	auto generic = render(false);
+	auto specialized = render(true);
+	EXPECT(generic == specialized, true);
+}
+
+TEST(bindless) {
+	if(!globals.dynamicIndexing) {
+		dlg_info("bindless: shaderSampledImageArrayDynamicIndexing "
+			"not supported, skipped");
+		return;
+	}
+
+	// bindless state must render the same as descriptor sets, also
+	// after changing it (in place without rerecord)
+	auto render = [](bool bindless) {
+		rvg::ContextSettings settings {};
+		settings.bindless = bindless;
+		auto pctx = createContext(settings);
+		auto& ctx = *pctx;
+
+		auto grad = rvg::Paint(ctx, rvg::linearGradient({-1.f, -1.f},
+			{1.f, 1.f}, rvg::Color::red, rvg::Color::blue));
+		auto color = rvg::Paint(ctx, rvg::colorPaint(rvg::Color::green));
+		auto transform = rvg::Transform(ctx);
+		auto left = rvg::RectShape(ctx, {-1.f, -1.f}, {1.f, 1.f},
+			{true, 0.f});
+		auto right = rvg::RectShape(ctx, {0.f, -1.f}, {1.f, 1.f},
+			{true, 0.05f, false, {}, false, true});
+
+		// the atlas texture is used via its slot
+		auto atlas = rvg::TextureAtlas(ctx, {16u, 16u});
+		std::vector<std::uint8_t> red(4 * 4 * 4, 255u);
+		for(auto i = 0u; i < 4 * 4; ++i) {
+			red[4 * i + 1] = red[4 * i + 2] = 0u;
+		}
+
+		auto ptr = reinterpret_cast<const std::byte*>(red.data());
+		rvg::Sprite sprite;
+		sprite.region = atlas.add({4u, 4u}, {ptr, red.size()});
+		sprite.position = {-1.f, 0.f};
+		sprite.size = {2.f, 1.f};
+		auto batch = rvg::SpriteBatch(ctx, atlas);
+		batch.add(sprite);
+
+		vpp::SubBuffer img;
+		ctx.updateDevice();
+		auto cmdBuf = record(ctx, [&](auto& cb){
+			rvg::Recorder rec(ctx, cb);
+			ctx.bindDefaults(rec);
+			grad.bind(rec);
+			left.fill(rec);
+			transform.bind(rec);
+			color.bind(rec);
+			right.fill(rec);
+			right.stroke(rec);
+			ctx.pointColorPaint().bind(rec);
+			batch.draw(rec);
+		}, [&](auto& cb) {
+			img = readImage(cb);
+		});
+
+		renderSubmit(ctx, cmdBuf);
+
+		auto mat = nytl::identity<4, float>();
+		mat[1][3] = 0.25f;
+		transform.matrix(mat);
+		color.paint(rvg::colorPaint(rvg::Color::blue));
+		ctx.updateDevice();
+		renderSubmit(ctx, cmdBuf);
+
+		auto map = img.memoryMap();
+		auto data = reinterpret_cast<const std::byte*>(map.ptr());
+		return std::vector<std::byte>(data, data + img.size());
+	};
+
+	auto sets = render(false);
+	auto bindless = render(true);
+	EXPECT(sets == bindless, true);
+}
+
+TEST(updateHostParallel) {
+	// tessellating on multiple threads must upload the same bytes
+	// and render the same as on the calling thread alone
+	struct Result {
+		std::vector<std::byte> pixels;
+		vk::DeviceSize written;
+		vk::DeviceSize staged;
+	};
+
+	auto render = [](unsigned threads) {
+		rvg::ContextSettings settings {};
+		settings.updateThreads = threads;
+		settings.antiAliasing = true;
+		auto pctx = createContext(settings);
+		auto& ctx = *pctx;
+
+		// a grid of circles with different point counts and modes
+		constexpr auto side = 16u;
+		auto circle = [&](unsigned i, float radius) {
+			auto center = nytl::Vec2f {
+				-1.f + (2.f * (i % side) + 1.f) / side,
+				-1.f + (2.f * (i / side) + 1.f) / side};
+			auto count = 8u + 3u * (i % 13u);
+			std::vector<nytl::Vec2f> points;
+			for(auto j = 0u; j < count; ++j) {
+				auto a = 2 * 3.14159f * j / count;
+				points.push_back(center + radius * nytl::Vec2f {
+					std::cos(a), std::sin(a)});
+			}
+			return points;
+		};
+
+		auto mode = [](unsigned i) {
+			rvg::DrawMode mode {true, 0.005f * (i % 3u), true};
+			mode.aaStroke = (i % 2u);
+			mode.deviceLocal = (i % 5u == 0u);
+			return mode;
+		};
+
+		auto paint = rvg::Paint(ctx, rvg::colorPaint(rvg::Color::red));
+		std::vector<rvg::Polygon> polygons;
+		polygons.reserve(side * side);
+		for(auto i = 0u; i < side * side; ++i) {
+			auto& polygon = polygons.emplace_back(ctx);
+			polygon.update(circle(i, 0.5f / side), mode(i));
+		}
+
+		vpp::SubBuffer img;
+		ctx.updateDevice();
+		auto cmdBuf = record(ctx, [&](auto& cb){
+			rvg::Recorder rec(ctx, cb);
+			ctx.bindDefaults(rec);
+			paint.bind(rec);
+			for(auto i = 0u; i < polygons.size(); ++i) {
+				polygons[i].fill(rec);
+				if(mode(i).stroke > 0.f) {
+					polygons[i].stroke(rec);
+				}
+			}
+		}, [&](auto& cb) {
+			img = readImage(cb);
+		});
+
+		renderSubmit(ctx, cmdBuf);
+
+		// change every other one, without rerecord
+		for(auto i = 0u; i < polygons.size(); i += 2) {
+			polygons[i].update(circle(i, 0.8f / side), mode(i));
+		}
+
+		Result ret;
+		ctx.updateDevice();
+		ret.written = ctx.frameStats().bytesWritten;
+		ret.staged = ctx.frameStats().bytesStaged;
+		renderSubmit(ctx, cmdBuf);
+
+		auto map = img.memoryMap();
+		auto data = reinterpret_cast<const std::byte*>(map.ptr());
+		ret.pixels = {data, data + img.size()};
+		return ret;
+	};
+
+	auto single = render(0u);
+	auto parallel = render(3u);
+	EXPECT(single.written > 0u, true);
+	EXPECT(single.staged > 0u, true);
+	EXPECT(parallel.written, single.written);
+	EXPECT(parallel.staged, single.staged);
+	EXPECT(parallel.pixels == single.pixels, true);
+}
+
+TEST(sdfShape) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	auto paint = rvg::Paint(ctx, rvg::colorPaint(rvg::Color::red));
+	auto prim = rvg::sdfCircle({0.f, 0.f}, 0.5f, 0.1f);
+	prim.aa = true;
+	auto circle = rvg::SdfShape(ctx, prim);
+
+	vpp::SubBuffer img;
+	ctx.updateDevice();
+	auto cmdBuf = record(ctx, [&](auto& cb){
+		rvg::Recorder rec(ctx, cb);
+		ctx.bindDefaults(rec);
+		paint.bind(rec);
+		circle.fill(rec);
+		circle.stroke(rec);
+	}, [&](auto& cb) {
+		img = readImage(cb);
+	});
+
+	renderSubmit(ctx, cmdBuf);
+
+	// rgba8, the center is inside, the corners outside of the circle
+	auto map = img.memoryMap();
+	auto center = pixel(map, fbExtent.width / 2, fbExtent.height / 2);
+	EXPECT(unsigned(center[0]), 255u);
+	EXPECT(unsigned(center[1]), 0u);
+	EXPECT(unsigned(pixel(map, 0, 0)[0]), 0u);
+
+	// changing it only rewrites its instance, no rerecord
+	circle.change()->size *= 1.5f;
+	circle.disable(true, rvg::DrawType::stroke);
+	EXPECT(ctx.updateDevice(), false);
+}
+
+TEST(shapeBatch) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	// left half red, right half blue, drawn with the instance colors
+	auto batch = rvg::RectBatch(ctx);
+	batch.add({-1.f, -1.f}, {1.f, 2.f}, {255u, 0u, 0u, 255u});
+	batch.add({0.f, -1.f}, {1.f, 2.f}, {0u, 0u, 255u, 255u});
+	EXPECT(batch.size(), 2u);
+
+	vpp::SubBuffer img;
+	ctx.updateDevice();
+	auto cmdBuf = record(ctx, [&](auto& cb){
+		rvg::Recorder rec(ctx, cb);
+		ctx.bindDefaults(rec);
+		ctx.pointColorPaint().bind(rec);
+		batch.fill(rec);
+	}, [&](auto& cb) {
+		img = readImage(cb);
+	});
+
+	renderSubmit(ctx, cmdBuf);
+
+	auto map = img.memoryMap();
+	auto left = pixel(map, fbExtent.width / 4, fbExtent.height / 2);
+	auto right = pixel(map, 3 * fbExtent.width / 4, fbExtent.height / 2);
+	EXPECT(unsigned(left[0]), 255u);
+	EXPECT(unsigned(right[2]), 255u);
+
+	// changing, disabling and adding instances within the
+	// capacity of the buffer needs no rerecord
+	batch.disable(0u, true);
+	EXPECT(batch.disabled(0u), true);
+	EXPECT(batch.disabled(1u), false);
+	batch.set(1u, rvg::sdfRect({0.f, 0.f}, {0.5f, 0.5f}));
+	auto circle = rvg::sdfCircle({-0.5f, -0.5f}, 0.2f);
+	circle.color = {0u, 255u, 0u, 255u};
+	batch.add(circle);
+	EXPECT(ctx.updateDevice(), false);
+	EXPECT(batch.primitive(1u).size, (nytl::Vec2f{0.5f, 0.5f}));
+
+	// instance 0 is hidden, instance 1 only covers the lower right
+	// quarter of the right half (white), the circle is drawn
+	renderSubmit(ctx, cmdBuf);
+	map = {};
+	map = img.memoryMap();
+	left = pixel(map, fbExtent.width / 8, fbExtent.height / 2);
+	right = pixel(map, 7 * fbExtent.width / 8, fbExtent.height / 8);
+	auto resized = pixel(map, 5 * fbExtent.width / 8,
+		5 * fbExtent.height / 8);
+	auto added = pixel(map, fbExtent.width / 4, fbExtent.height / 4);
+	EXPECT(unsigned(left[0]), 0u);
+	EXPECT(unsigned(right[2]), 0u);
+	EXPECT(unsigned(resized[0]), 255u);
+	EXPECT(unsigned(resized[1]), 255u);
+	EXPECT(unsigned(resized[2]), 255u);
+	EXPECT(unsigned(added[0]), 0u);
+	EXPECT(unsigned(added[1]), 255u);
+}
+
+TEST(spriteBatch) {
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	// a red and a blue image in the atlas
+	auto atlas = rvg::TextureAtlas(ctx, {16u, 16u});
+	std::vector<std::uint8_t> red(4 * 4 * 4, 255u);
+	std::vector<std::uint8_t> blue = red;
+	for(auto i = 0u; i < 4 * 4; ++i) {
+		red[4 * i + 1] = red[4 * i + 2] = 0u;
+		blue[4 * i + 0] = blue[4 * i + 1] = 0u;
+	}
+
+	auto bytes = [](auto& vec) {
+		auto ptr = reinterpret_cast<const std::byte*>(vec.data());
+		return nytl::Span<const std::byte>(ptr, vec.size());
+	};
+
+	auto redRegion = atlas.add({4u, 4u}, bytes(red));
+	auto blueRegion = atlas.add({4u, 4u}, bytes(blue));
+	EXPECT(redRegion.size, (nytl::Vec2f{4.f, 4.f}));
+	EXPECT(redRegion.position != blueRegion.position, true);
+
+	// left half red, right half blue
+	auto batch = rvg::SpriteBatch(ctx, atlas);
+	rvg::Sprite sprite;
+	sprite.region = redRegion;
+	sprite.position = {-1.f, -1.f};
+	sprite.size = {1.f, 2.f};
+	batch.add(sprite);
+
+	sprite.region = blueRegion;
+	sprite.position = {0.f, -1.f};
+	batch.add(sprite);
+	EXPECT(batch.size(), 2u);
+
+	vpp::SubBuffer img;
+	ctx.updateDevice();
+	auto cmdBuf = record(ctx, [&](auto& cb){
+		rvg::Recorder rec(ctx, cb);
+		ctx.bindDefaults(rec);
+		ctx.pointColorPaint().bind(rec);
+		batch.draw(rec);
+	}, [&](auto& cb) {
+		img = readImage(cb);
+	});
+
+	renderSubmit(ctx, cmdBuf);
+
+	auto map = img.memoryMap();
+	auto left = pixel(map, fbExtent.width / 4, fbExtent.height / 2);
+	auto right = pixel(map, 3 * fbExtent.width / 4, fbExtent.height / 2);
+	EXPECT(unsigned(left[0]), 255u);
+	EXPECT(unsigned(left[2]), 0u);
+	EXPECT(unsigned(right[2]), 255u);
+
+	// adding, disabling and removing sprites (and images that still
+	// fit into the atlas) needs no rerecord
+	sprite.rotation = 1.f;
+	sprite.region = atlas.add({4u, 4u}, bytes(red));
+	batch.add(sprite);
+	batch.disable(1u, true);
+	EXPECT(batch.disabled(1u), true);
+	batch.remove(0u);
+	EXPECT(batch.size(), 2u);
+	EXPECT(batch.disabled(0u), false);
+	EXPECT(batch.sprite(0u).rotation, 1.f);
+	EXPECT(ctx.updateDevice(), false);
+
+	// the image added later was uploaded as part of the atlas
+	renderSubmit(ctx, cmdBuf);
+	map = {};
+	map = img.memoryMap();
+	right = pixel(map, 3 * fbExtent.width / 4, fbExtent.height / 2);
+	EXPECT(unsigned(right[0]), 255u);
+	EXPECT(unsigned(right[2]), 0u);
+
+	// growing the atlas keeps the regions
+	auto green = std::vector<std::uint8_t>(16 * 16 * 4, 255u);
+	for(auto i = 0u; i < 16 * 16; ++i) {
+		green[4 * i + 0] = green[4 * i + 2] = 0u;
+	}
+
+	auto greenRegion = atlas.add({16u, 16u}, bytes(green));
+	EXPECT(atlas.size(), (nytl::Vec2ui{32u, 32u}));
+
+	batch.clear();
+	sprite.rotation = 0.f;
+	sprite.region = redRegion;
+	sprite.position = {-1.f, -1.f};
+	batch.add(sprite);
+	sprite.region = greenRegion;
+	sprite.position = {0.f, -1.f};
+	batch.add(sprite);
+	EXPECT(ctx.updateDevice(), true);
+
+	map = {};
+	cmdBuf = record(ctx, [&](auto& cb){
+		rvg::Recorder rec(ctx, cb);
+		ctx.bindDefaults(rec);
+		ctx.pointColorPaint().bind(rec);
+		batch.draw(rec);
+	}, [&](auto& cb) {
+		img = readImage(cb);
+	});
+
+	renderSubmit(ctx, cmdBuf);
+	map = img.memoryMap();
+	left = pixel(map, fbExtent.width / 4, fbExtent.height / 2);
+	right = pixel(map, 3 * fbExtent.width / 4, fbExtent.height / 2);
+	EXPECT(unsigned(left[0]), 255u);
+	EXPECT(unsigned(left[1]), 0u);
+	EXPECT(unsigned(right[0]), 0u);
+	EXPECT(unsigned(right[1]), 255u);
+}
+
+TEST(transferQueue) {
+	// needs a queue of another family than the graphics queue
+	if(!globals.transferQueue) {
+		dlg_info("transferQueue: no queue of another family, skipped");
+		return;
+	}
+
+	// uploads on the transfer queue must render the same as
+	// the ones on the graphics queue
+	auto render = [](const vpp::Queue* transferQueue) {
+		rvg::ContextSettings settings {};
+		settings.transferQueue = transferQueue;
+		settings.framesInFlight = 2u;
+		auto pctx = createContext(settings);
+		auto& ctx = *pctx;
+
+		auto paint = rvg::Paint(ctx, rvg::colorPaint(rvg::Color::red));
+		auto rect = rvg::RectShape(ctx, {-1.f, -1.f}, {1.f, 2.f},
+			{true, 0.f});
+
+		auto atlas = rvg::TextureAtlas(ctx, {16u, 16u});
+		std::vector<std::uint8_t> red(4 * 4 * 4, 255u);
+		std::vector<std::uint8_t> blue = red;
+		for(auto i = 0u; i < 4 * 4; ++i) {
+			red[4 * i + 1] = red[4 * i + 2] = 0u;
+			blue[4 * i + 0] = blue[4 * i + 1] = 0u;
+		}
+
+		auto bytes = [](auto& vec) {
+			auto ptr = reinterpret_cast<const std::byte*>(vec.data());
+			return nytl::Span<const std::byte>(ptr, vec.size());
+		};
+
+		rvg::Sprite sprite;
+		sprite.region = atlas.add({4u, 4u}, bytes(red));
+		sprite.position = {0.f, -1.f};
+		sprite.size = {1.f, 2.f};
+		auto batch = rvg::SpriteBatch(ctx, atlas);
+		batch.add(sprite);
+
+		vpp::SubBuffer img;
+		ctx.updateDevice();
+		auto cmdBuf = record(ctx, [&](auto& cb){
+			rvg::Recorder rec(ctx, cb);
+			ctx.bindDefaults(rec);
+			paint.bind(rec);
+			rect.fill(rec);
+			ctx.pointColorPaint().bind(rec);
+			batch.draw(rec);
+		}, [&](auto& cb) {
+			img = readImage(cb);
+		});
+
+		renderSubmit(ctx, cmdBuf);
+
+		// rewrites a part of the existing buffers and of the atlas,
+		// the rest of their content has to be kept
+		paint.paint(rvg::colorPaint(rvg::Color::green));
+		sprite.region = atlas.add({4u, 4u}, bytes(blue));
+		batch.set(0u, sprite);
+		EXPECT(ctx.updateDevice(), false);
+		renderSubmit(ctx, cmdBuf);
+
+		auto map = img.memoryMap();
+		auto ptr = reinterpret_cast<const std::byte*>(map.ptr());
+		return std::vector<std::byte>(ptr, ptr + img.size());
+	};
+
+	auto graphics = render(nullptr);
+	auto transfer = render(globals.transferQueue);
+	EXPECT(graphics == transfer, true);
+
+	// left half green, right half blue
+	auto data = transfer.data();
+	auto left = pixel(data, fbExtent.width / 4, fbExtent.height / 2);
+	auto right = pixel(data, 3 * fbExtent.width / 4, fbExtent.height / 2);
+	EXPECT(unsigned(left[0]), 0u);
+	EXPECT(unsigned(left[1]), 255u);
+	EXPECT(unsigned(right[0]), 0u);
+	EXPECT(unsigned(right[2]), 255u);
+}
+
+TEST(uploadBatching) {
+	// all uploads of a frame are recorded into one command buffer,
+	// copies into the same buffer (here the geometry arena and the
+	// transform buffers) are merged into one command
+	auto pctx = createContext();
+	auto& ctx = *pctx;
+
+	rvg::DrawMode mode {true};
+	mode.deviceLocal = true;
+
+	// 32 strips covering the top half
+	constexpr auto count = 32u;
+	std::vector<rvg::Polygon> strips;
+	for(auto i = 0u; i < count; ++i) {
+		auto x = -1.f + 2.f * i / count;
+		auto w = 2.f / count;
+		auto points = {nytl::Vec2f{x, -1.f}, nytl::Vec2f{x + w, -1.f},
+			nytl::Vec2f{x + w, 0.f}, nytl::Vec2f{x, 0.f}};
+		strips.emplace_back(ctx).update(points, mode);
+	}
+
+	// a square in the bottom left, moved by its transform
+	auto points = {nytl::Vec2f{-1.f, 0.f}, nytl::Vec2f{-0.5f, 0.f},
+		nytl::Vec2f{-0.5f, 1.f}, nytl::Vec2f{-1.f, 1.f}};
+	rvg::Polygon square(ctx);
+	square.update(points, mode);
+	auto transform = rvg::Transform(ctx);
+	auto paint = rvg::Paint(ctx, rvg::colorPaint(rvg::Color::red));
+
+	vpp::SubBuffer img;
+	ctx.updateDevice();
+	auto cmdBuf = record(ctx, [&](auto& cb){
+		rvg::Recorder rec(ctx, cb);
+		ctx.bindDefaults(rec);
+		paint.bind(rec);
+		for(auto& strip : strips) {
+			strip.fill(rec);
+		}
+
+		transform.bind(rec);
+		square.fill(rec);
+	}, [&](auto& cb) {
+		img = readImage(cb);
+	});
+
+	// the transform is uploaded twice before the frame is submitted,
+	// the copies write the same range and the later one must win
+	auto mat = nytl::identity<4, float>();
+	mat[0][3] = 0.75f;
+	transform.matrix(mat);
+	ctx.updateDevice();
+
+	mat[0][3] = 1.5f;
+	transform.matrix(mat);
+	ctx.updateDevice();
+	renderSubmit(ctx, cmdBuf);
+
+	auto map = img.memoryMap();
+	for(auto i = 0u; i < count; ++i) {
+		auto strip = pixel(map, (2 * i + 1) * fbExtent.width / (2 * count),
+			fbExtent.height / 4);
+		EXPECT(unsigned(strip[0]), 255u);
+	}
+
+	auto before = pixel(map, fbExtent.width / 8, 3 * fbExtent.height / 4);
+	auto between = pixel(map, fbExtent.width / 2, 3 * fbExtent.height / 4);
+	auto after = pixel(map, 7 * fbExtent.width / 8, 3 * fbExtent.height / 4);
+	EXPECT(unsigned(before[0]), 0u);
+	EXPECT(unsigned(between[0]), 0u);
+	EXPECT(unsigned(after[0]), 255u);
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/deviceObject.hpp>
+
+#include <vpp/sharedBuffer.hpp>
+#include <nytl/nonCopyable.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace rvg {
+
+/// Table of the Context in bindless mode from which objects
+/// allocate their slot. See ContextSettings::bindless.
+class BindlessTable {
+public:
+	virtual ~BindlessTable() = default;
+	virtual void release(std::uint32_t slot) = 0;
+};
+
+/// Owned slot in a BindlessTable, releases it on destruction.
+/// Only valid in bindless mode.
+class BindlessSlot : public nytl::NonCopyable {
+public:
+	BindlessSlot() = default;
+	BindlessSlot(BindlessTable& table, std::uint32_t slot) :
+		table_(&table), slot_(slot) {}
+	~BindlessSlot() { reset(); }
+
+	BindlessSlot(BindlessSlot&& rhs) noexcept :
+			table_(rhs.table_), slot_(rhs.slot_) {
+		rhs.table_ = {};
+	}
+
+	BindlessSlot& operator=(BindlessSlot&& rhs) noexcept {
+		reset();
+		table_ = rhs.table_;
+		slot_ = rhs.slot_;
+		rhs.table_ = {};
+		return *this;
+	}
+
+	void reset() {
+		if(table_) {
+			table_->release(slot_);
+			table_ = {};
+		}
+	}
+
+	bool valid() const { return table_; }
+	std::uint32_t slot() const { return slot_; }
+
+protected:
+	BindlessTable* table_ {};
+	std::uint32_t slot_ {};
+};
+
+/// Storage buffer holding one fixed size entry per object (e.g. the
+/// matrices of all Transforms). Entries are written into a host copy
+/// and the changed ones are uploaded in Context::updateDevice.
+class BindlessBuffer : public BindlessTable, public DeviceObject {
+public:
+	BindlessBuffer(Context&, vk::DeviceSize entrySize);
+
+	BindlessSlot allocate();
+	void release(std::uint32_t) override;
+
+	/// Returns the host copy of the given entry and marks it for upload.
+	std::byte* write(std::uint32_t slot);
+
+	/// Uploads all written entries. Returns whether the device buffer
+	/// was recreated.
+	bool updateDevice();
+
+	const auto& buffer() const { return buffer_; }
+	auto entrySize() const { return entrySize_; }
+
+protected:
+	vk::DeviceSize entrySize_ {};
+	std::vector<std::byte> data_;
+	std::vector<std::uint32_t> free_;
+	std::vector<std::uint32_t> dirty_;
+	std::vector<bool> isDirty_;
+	vpp::SubBuffer buffer_;
+};
+
+/// Fixed size array of the sampled image views of all Paints and
+/// FontAtlases. Slots are reference counted per image view.
+/// Unused slots reference the empty image of the Context.
+class BindlessTextures : public BindlessTable {
+public:
+	BindlessTextures(unsigned count, vk::ImageView empty);
+
+	/// Throws std::runtime_error if there is no free slot.
+	BindlessSlot allocate(vk::ImageView);
+	void release(std::uint32_t) override;
+
+	/// Returns whether a slot changed since the last call.
+	bool updateDevice();
+	const auto& views() const { return views_; }
+
+protected:
+	vk::ImageView empty_;
+	std::vector<vk::ImageView> views_;
+	std::vector<unsigned> refs_;
+	bool dirty_ {};
+};
+
+} // namespace rvg
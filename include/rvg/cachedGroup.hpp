@@ -0,0 +1,83 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/layer.hpp>
+#include <rvg/state.hpp>
+#include <rvg/paint.hpp>
+#include <rvg/shapes.hpp>
+
+#include <vpp/image.hpp>
+#include <vpp/renderPass.hpp>
+#include <nytl/nonCopyable.hpp>
+#include <nytl/rect.hpp>
+
+namespace rvg {
+
+/// Renders a group of draws into an offscreen image and draws that
+/// image as one textured rectangle (using a texturePaintRGBA paint).
+/// The group is rendered again (in Context::stageUpload, before the
+/// frame that composites it) only when an object it uses was updated,
+/// so static content with many shapes costs a single quad per frame.
+/// The draws are tracked like the draws of a Layer.
+/// Since the offscreen render pass must be compatible with the render
+/// pass of the Context, that one must have a single color attachment
+/// with the given format and ContextSettings::samples must be e1.
+/// Semi-transparent content (e.g. anti aliased edges) is blended twice
+/// and may therefore look slightly different than drawn directly.
+/// Must not be destroyed while a frame using it is pending.
+class CachedGroup : public nytl::NonMovable {
+public:
+	/// The rectangle area of the coordinate space of the draws is
+	/// rendered into an image with the given size and format.
+	/// The recording starts with a transform bound that maps the area
+	/// onto the image (see transform) and viewport and scissor set.
+	/// It must stay valid.
+	CachedGroup(Context&, const Rect2f& area, Vec2ui size, vk::Format,
+		Layer::Recording);
+	~CachedGroup();
+
+	/// Draws the cached image at its area, with the bound transform and
+	/// scissor. Binds its own paint.
+	void draw(vk::CommandBuffer) const;
+	void draw(Recorder&) const;
+
+	/// Makes sure the group is rendered again in the next stageUpload.
+	void invalidate() { rendered_ = false; }
+
+	const auto& area() const { return area_; }
+	const auto& size() const { return size_; }
+	const auto& image() const { return image_; }
+	const auto& transform() const { return transform_; }
+	const auto& shape() const { return rect_; }
+	const auto& layer() const { return layer_; }
+	Context& context() const { return *context_; }
+
+	// - internal, called by the Context -
+	bool needsRender() const;
+	void render(vk::CommandBuffer);
+
+protected:
+	void record(Recorder&);
+
+protected:
+	Context* context_ {};
+	Rect2f area_;
+	Vec2ui size_;
+	Layer::Recording recording_;
+
+	vpp::RenderPass rp_;
+	vpp::ViewableImage image_;
+	vpp::Framebuffer fb_;
+
+	Transform transform_;
+	Paint paint_;
+	RectShape rect_;
+	Layer layer_;
+	bool rendered_ {};
+};
+
+} // namespace rvg
@@ -10,16 +10,31 @@
 
 #include <vpp/trackedDescriptor.hpp>
 #include <vpp/pipeline.hpp>
+#include <vpp/shader.hpp>
 #include <vpp/commandBuffer.hpp>
 #include <vpp/image.hpp>
 #include <vpp/sync.hpp>
+#include <vpp/sharedBuffer.hpp>
+#include <vpp/memoryMap.hpp>
+#include <vpp/submit.hpp>
 #include <nytl/nonCopyable.hpp>
 
+#include <array>
+#include <cstddef>
+#include <type_traits>
 #include <variant>
-#include <unordered_set>
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <atomic>
 
 namespace rvg {
 
+class ThreadPool;
+
 /// Control various aspects of a context.
 /// You have to set those members that have no default value to valid
 /// values.
@@ -44,10 +59,137 @@ struct ContextSettings {
 	/// Will use no cache if left empty.
 	vk::PipelineCache pipelineCache {};
 
+	/// Path of a file from which the Context loads its own pipeline
+	/// cache, used when no pipelineCache is given. Pipelines are then
+	/// compiled only once across runs as long as device and driver
+	/// don't change (the driver ignores data from others).
+	/// The cache is written back by Context::savePipelineCache and
+	/// the destructor of the Context when pipelines were created.
+	std::string pipelineCacheFile {};
+
 	/// The multisample bits to use for the pipelines.
 	vk::SampleCountBits samples {};
+
+	/// How many frames rendering objects of this context may be pending
+	/// on the device at the same time. Must be at least 1.
+	/// With 1, updateDevice and stageUpload must only be called when
+	/// no command buffer referencing objects of this context is executing.
+	/// With n > 1, they can be called while up to n - 1 previous
+	/// frames are still executing: all writes are then staged and ordered
+	/// after those frames on the device and resources replaced
+	/// by an update are kept alive until the frames using them have
+	/// completed. The application must still make sure that at most
+	/// n frames are pending, i.e. that rendering of the frame that
+	/// called stageUpload n calls ago has completed.
+	unsigned framesInFlight {1};
+
+	/// Optional queue to submit the staging copies to.
+	/// If this is set and has a different queue family than the queue
+	/// of the devices QueueSubmitter, uploads are executed on it and
+	/// can therefore overlap with rendering. Ownership of the written
+	/// resources is transferred between the queue families and the
+	/// semaphore returned by stageUpload is then signaled by a small
+	/// submission on the graphics queue that acquires them.
+	/// The release of the resources on the graphics queue is submitted
+	/// directly in stageUpload (the application's batches queued on
+	/// the QueueSubmitter stay untouched), the submissions of earlier
+	/// frames must therefore have been submitted before.
+	/// The queue must support transfer operations and be valid for
+	/// the lifetime of the Context.
+	const vpp::Queue* transferQueue {};
+
+	/// Number of worker threads used in updateDevice.
+	/// If this is not 0, the expensive host side part of object updates
+	/// (polygon tessellation and text layout) is deferred from the update
+	/// calls to updateDevice where it runs in parallel on these threads
+	/// and the calling thread. The results don't depend on the
+	/// scheduling. Texts are laid out per FontAtlas on one thread.
+	/// Note that Text::charAt only reflects a deferred change after
+	/// updateDevice was called.
+	unsigned updateThreads {0};
+
+	/// Whether to defer the expensive host side part of object updates
+	/// (polygon tessellation and text layout) to updateDevice even
+	/// without updateThreads. Changing an object multiple times per frame
+	/// then only tessellates it once. Always enabled with updateThreads.
+	bool deferredUpdate {false};
+
+	/// Whether the device has the multiDrawIndirect feature enabled.
+	/// Allows DrawBatch to draw multiple polygons with one command.
+	bool multiDrawIndirect {false};
+
+	/// Whether to use bindless state.
+	/// All transforms, scissors and paints are then stored in one storage
+	/// buffer table each, all textures (of paints and font atlases) in
+	/// one array of bindlessTextures sampled images. All of it is bound
+	/// as a single descriptor set and objects are selected per draw with
+	/// push constant indices, so binding state does not bind any
+	/// descriptor sets and their number does not grow with the number
+	/// of objects. When a table has to grow or a texture is added,
+	/// updateDevice signals a rerecord.
+	/// The device must have the shaderSampledImageArrayDynamicIndexing
+	/// feature enabled.
+	bool bindless {false};
+
+	/// Number of texture slots in bindless mode. Every distinct image
+	/// view used by a Paint and every FontAtlas texture needs one.
+	/// Must not exceed the devices maxPerStageDescriptorSampledImages limit.
+	unsigned bindlessTextures {64};
+
+	/// Whether to track which regions of the output change, see
+	/// DamageTracker. Adds some overhead to recording and updates.
+	bool damageTracking {false};
+
+	/// Whether to measure the gpu time of draw scopes, see GpuTimer.
+	/// Adds an additional submission to every stageUpload call.
+	bool gpuTiming {false};
+
+	/// The maximum number of distinct GpuTimer scopes.
+	unsigned gpuTimingScopes {32};
+
+	/// Whether to use pipelines specialized for the draw type and the
+	/// type of the bound paint instead of branching on them in the
+	/// fragment shader. The variants are created on first use while
+	/// recording. Draws only use a paint specialized variant when the
+	/// paint was bound with the same Recorder. Changing the type of a
+	/// paint then triggers a rerecord.
+	bool pipelineVariants {false};
+};
+
+/// Range of the per-frame staging arena of a Context.
+/// Only valid until the upload of the frame it was allocated in completes.
+struct StageRange {
+	vpp::BufferSpan span; // the range in the staging buffer
+	std::byte* data {}; // persistently mapped pointer to the range
+};
+
+/// The shader programs of a Context, see Context::pipeline.
+enum class ShaderProgram : unsigned {
+	fill, // polygons and texts (fill.vert, fill.frag)
+	sdf, // analytic shapes, see SdfShape and ShapeBatch (SDF defined)
+	sprite, // atlas images, see SpriteBatch (SPRITE defined)
 };
 
+constexpr auto shaderProgramCount = 3u;
+
+namespace detail {
+
+/// Returns the index of the alternative T in the variant, the number
+/// of alternatives if it is none of them.
+template<typename T, typename... Ts>
+constexpr std::size_t variantIndex(const std::variant<Ts...>*) {
+	constexpr bool same[] = {std::is_same_v<T, Ts>...};
+	for(auto i = 0u; i < sizeof...(Ts); ++i) {
+		if(same[i]) {
+			return i;
+		}
+	}
+
+	return sizeof...(Ts);
+}
+
+} // namespace detail
+
 /// Drawing context. Manages all pipelines and layouts needed to
 /// draw any shapes. There is usually no need for multiple Contexts
 /// for a single device.
@@ -62,7 +204,64 @@ public:
 		Texture*,
 		Transform*,
 		Scissor*,
-		FontAtlas*>;
+		FontAtlas*,
+		DrawBatch*,
+		SdfShape*,
+		ShapeBatch*,
+		TextureAtlas*,
+		SpriteBatch*>;
+
+	/// Statistics about the updates of one frame, meant to find the
+	/// objects that cause rerecords or expensive uploads.
+	/// See frameStats.
+	struct FrameStats {
+		/// A rerecord signaled in the frame.
+		struct Rerecord {
+			/// The object that caused it, nullptr if it was not caused by
+			/// a single object. Only meant for identification, it might
+			/// have been destroyed since.
+			const DeviceObject* object {};
+			const char* cause {}; // static description
+		};
+
+		/// Number of updateDevice calls per object type,
+		/// indexed like the alternatives of DevRes, see updatedCount.
+		std::array<unsigned, std::variant_size_v<DevRes>> updated {};
+
+		/// Returns the number of updateDevice calls of objects of
+		/// the given type, e.g. updatedCount<Polygon>().
+		template<typename T>
+		unsigned updatedCount() const { return updated[devResIndex<T>()]; }
+
+		/// Bytes written directly into mapped host visible buffers.
+		vk::DeviceSize bytesWritten {};
+
+		/// Bytes copied into the staging arena, i.e. uploads to device
+		/// local buffers and images and, with multiple frames in flight,
+		/// all uploads.
+		vk::DeviceSize bytesStaged {};
+
+		/// Number of staging buffers created because the staging arena
+		/// of the frame was too small.
+		unsigned stagingBuffers {};
+
+		/// Number of polygon tessellations since the previous
+		/// updateDevice call. With deferred updates at most one
+		/// per polygon, no matter how often it was changed.
+		unsigned tessellations {};
+
+		std::vector<Rerecord> rerecords;
+	};
+
+	/// Returns the index of the given object type in DevRes.
+	template<typename T>
+	static constexpr std::size_t devResIndex() {
+		constexpr auto ret = detail::variantIndex<T*>(
+			static_cast<const DevRes*>(nullptr));
+		static_assert(ret < std::variant_size_v<DevRes>,
+			"Not a DeviceObject type updated by the Context");
+		return ret;
+	}
 
 	/// Descriptor set bindings.
 	static constexpr auto transformBindSet = 0u;
@@ -71,6 +270,29 @@ public:
 	static constexpr auto scissorBindSet = 3u;
 	static constexpr auto aaStrokeBindSet = 4u;
 
+	/// The only descriptor set in bindless mode.
+	static constexpr auto bindlessBindSet = 0u;
+
+	/// Push constant slots (4 bytes each).
+	/// Without bindless mode, only the type is used.
+	static constexpr auto typePushSlot = 0u;
+	static constexpr auto transformPushSlot = 1u;
+	static constexpr auto paintPushSlot = 2u;
+	static constexpr auto scissorPushSlot = 3u;
+	static constexpr auto fontPushSlot = 4u;
+	static constexpr auto strokeMultPushSlot = 5u;
+	static constexpr auto pushSlotCount = 6u;
+
+	/// Draw types, pushed to typePushSlot. See fill.frag.
+	/// For analytic shapes, drawTypeDefault fills and drawTypeStroke
+	/// strokes them.
+	static constexpr auto drawTypeDefault = 0u; // fills, strokes without aa
+	static constexpr auto drawTypeText = 1u;
+	static constexpr auto drawTypeStroke = 2u; // anti aliased strokes
+
+	/// Draw or paint type of a pipeline that is not specialized for it.
+	static constexpr auto anyType = 0xFFFFFFFFu;
+
 	/// Specifies the thickness of the anti aliasing area.
 	/// A greater fringe may result in smoother but also
 	/// more blurry edges.
@@ -83,12 +305,14 @@ public:
 	/// device since a context creates and manages expensive resources
 	/// like pipelines.
 	Context(vpp::Device&, const ContextSettings&);
+	~Context();
 
 	/// Binds default state on the given command buffer (which must be
 	/// in recording state). Can then be used for rendering without
 	/// the need for binding a custom scissor or transform.
 	/// Does NOT bind a paint. [TODO(v0.2)]
 	void bindDefaults(vk::CommandBuffer);
+	void bindDefaults(Recorder&);
 
 	/// Calls stageUpload and updateDevice.
 	/// Returns whether a rerecord is needed (from updateDevice) and
@@ -97,36 +321,81 @@ public:
 	std::pair<bool, vk::Semaphore> upload();
 
 	/// Queues all pending upload operations and returns the semaphore to wait
-	/// upon for the next render call.
+	/// upon for the next render call. Also renders the CachedGroups
+	/// that changed.
 	/// Must be waited upon with the indirectDraw stage bit.
 	/// Used to make sure that new data was uploaded to deviceLocal
 	/// vulkan resources.
-	/// Must not be called again until rendering this frame completes.
+	/// Must not be called again until rendering of the frame that
+	/// called it ContextSettings::framesInFlight calls ago completes.
 	vk::Semaphore stageUpload();
 
-	/// Must be called once per frame when there is no command buffer
-	/// executing that references objects associated with this context.
+	/// Must be called once per frame. When ContextSettings::framesInFlight
+	/// is 1, there must be no command buffer executing that references
+	/// objects associated with this context.
 	/// Will update device objects (like buffers).
 	/// Returns whether a rerecord is needed. Submitting a previously
 	/// recorded command buffer referencing objects associated with this
 	/// Context when this returns true results in undefined behaviour.
+	/// Layers that have to be recorded again are returned by
+	/// invalidLayers afterwards.
 	bool updateDevice();
 
 	/// Signal that a rerecord is needed.
-	void rerecord() { rerecord_ = true; }
-
+	/// Can be called from multiple threads.
+	/// Invalidates all layers. The cause is listed in the FrameStats,
+	/// it must be a string with static storage duration or nullptr.
+	void rerecord(const char* cause = nullptr);
+
+	/// Signal that a rerecord of the commands using the given object
+	/// is needed. Only invalidates the layers that use it.
+	/// Can be called from multiple threads.
+	void rerecord(const DeviceObject&, const char* cause = nullptr);
+
+	/// Returns all layers that must be recorded again (Layer::record)
+	/// before they can be executed.
+	std::vector<Layer*> invalidLayers() const;
+
+	/// The regions of the output that changed in this frame, i.e. by
+	/// the last updateDevice call and the draws recorded since then.
+	/// Only available with ContextSettings::damageTracking, nullptr otherwise.
+	DamageTracker* damageTracker() const { return damage_.get(); }
+
+	/// Measures the gpu time of recorded scopes and the uploads.
+	/// Only available with ContextSettings::gpuTiming, nullptr otherwise.
+	GpuTimer* gpuTimer() const { return gpuTimer_.get(); }
+
+	/// Statistics of the last frame, i.e. of everything done between
+	/// the previous and the last updateDevice call, including it.
+	/// Must not be called during updateDevice.
+	const FrameStats& frameStats() const { return lastStats_; }
 
 	// internal resources, mainly used by other rvg classes for rendering
 	const auto& device() const { return device_; };
 	const auto& pipeLayout() const { return pipeLayout_; }
-	const auto& fanPipe() const { return fanPipe_; }
-	const auto& stripPipe() const { return stripPipe_; }
+	vk::Pipeline fanPipe();
+	vk::Pipeline stripPipe();
+
+	/// Returns the fan or strip pipeline specialized for the given draw
+	/// type and PaintType (or anyType). Pipelines are only created
+	/// on first use, i.e. usually when recording.
+	/// Returns the generic fan or strip pipeline without
+	/// ContextSettings::pipelineVariants. Can be called from
+	/// multiple threads.
+	vk::Pipeline pipeline(vk::PrimitiveTopology, std::uint32_t drawType,
+		std::uint32_t paintType);
+
+	/// Like above but for the given shader program. Analytic shapes
+	/// are drawn as triangle strips.
+	vk::Pipeline pipeline(ShaderProgram, vk::PrimitiveTopology,
+		std::uint32_t drawType, std::uint32_t paintType);
 
 	const auto& dsLayoutTransform() const { return dsLayoutTransform_; }
 	const auto& dsLayoutScissor() const { return dsLayoutScissor_; }
 	const auto& dsLayoutPaint() const { return dsLayoutPaint_; }
 	const auto& dsLayoutFontAtlas() const { return dsLayoutFontAtlas_; }
 	const auto& dsLayoutStrokeAA() const { return dsLayoutStrokeAA_; }
+	const auto& dsLayoutBindless() const { return dsLayoutBindless_; }
 
 	vpp::DescriptorAllocator& dsAllocator() const;
 	vpp::BufferAllocator& bufferAllocator() const;
@@ -138,41 +407,248 @@ public:
 	const auto& identityTransform() const { return identityTransform_; }
 	const auto& defaultScissor() const { return defaultScissor_; }
 	const auto& defaultStrokeAA() const { return defaultStrokeAA_; }
-	const auto& defaultAtlas() const { return *defaultAtlas_; }
-	auto& defaultAtlas() { return *defaultAtlas_; }
+
+	/// The atlas of fonts created without one, created on first use.
+	/// Must not be called from multiple threads at the same time.
+	FontAtlas& defaultAtlas();
 
 	const auto& settings() const { return settings_; }
 	bool antiAliasing() const { return settings().antiAliasing; }
+	bool bindless() const { return settings().bindless; }
+
+	/// The pipeline cache used to create pipelines, either the one
+	/// from the settings or the one loaded from the pipelineCacheFile.
+	vk::PipelineCache pipelineCache() const;
+
+	/// Writes the pipeline cache to ContextSettings::pipelineCacheFile
+	/// if pipelines were created since it was loaded or saved.
+	/// Returns false if it could not be written, true otherwise.
+	/// Can be called from multiple threads.
+	bool savePipelineCache();
+
+	/// Stages that access the push constants.
+	vk::ShaderStageFlags pushConstantStages() const;
+
+	/// The tables of the bindless mode. Only valid if it is enabled.
+	auto& bindlessTransforms() { return *bindlessTransforms_; }
+	auto& bindlessScissors() { return *bindlessScissors_; }
+	auto& bindlessPaints() { return *bindlessPaints_; }
+	auto& bindlessTextures() { return *bindlessTextures_; }
+	const auto& bindlessDs() const { return bindlessDs_; }
+
+	/// The arena all polygon and text geometry is allocated from.
+	auto& geometryArena() { return *geometryArena_; }
+	const auto& geometryArena() const { return *geometryArena_; }
+
+	/// Whether host visible buffers are written directly via their
+	/// memory map. Otherwise all writes are staged so they are
+	/// ordered with pending frames, hostVisible buffers must then
+	/// also be created with the transferDst usage.
+	bool directWrites() const { return settings().framesInFlight <= 1; }
+
+	/// Whether objects should defer expensive host side work from their
+	/// update to their updateDevice call. See ContextSettings::deferredUpdate.
+	bool deferredUpdates() const {
+		return settings().deferredUpdate || settings().updateThreads > 0;
+	}
 
 	// internal DeviceObject communication
-	vpp::CommandBuffer uploadCmdBuf();
-	void addCommandBuffer(DevRes, vpp::CommandBuffer&&);
-	void addStage(vpp::SubBuffer&& buf);
-
+	/// Bump-allocates the given number of bytes from the staging arena
+	/// of the current frame. The returned range can be used as source
+	/// for the copies added below.
+	StageRange stage(vk::DeviceSize size);
+
+	/// Adds a buffer copy to the upload of the current frame.
+	/// Copies are merged per source/destination buffer when recorded
+	/// in stageUpload, while preserving the order of copies
+	/// writing the same range. The copy is dropped if the
+	/// owning object is destroyed before.
+	void addCopy(DeviceObject& owner, vk::Buffer src, vk::Buffer dst,
+		const vk::BufferCopy&);
+
+	/// Adds a copy from a buffer to the given image to the upload of
+	/// the current frame. The image will be transitioned from the given
+	/// layout to transferDstOptimal for the copy and to shaderReadOnlyOptimal
+	/// afterwards. The layout must be undefined if the copy writes the
+	/// whole image, its previous content is then discarded.
+	/// Copies to the same image are executed in order, only the layout
+	/// given with the first one in a frame is used.
+	void addCopy(DeviceObject& owner, vk::Buffer src, vk::Image dst,
+		vk::ImageLayout, const vk::BufferImageCopy&);
+
+	/// Lists the cause of a rerecord that an object signals by returning
+	/// true from its updateDevice in the FrameStats. Objects without a
+	/// listed cause are listed as a generic updateDevice cause.
+	/// Can be called from multiple threads.
+	void rerecordCause(const DeviceObject&, const char* cause);
+
+	/// Counts bytes written directly into mapped buffers for the
+	/// FrameStats. Can be called from multiple threads.
+	void countWrite(vk::DeviceSize size) { bytesWritten_ += size; }
+
+	/// Counts a polygon tessellation for the FrameStats.
+	/// Can be called from multiple threads.
+	void countTessellation() { ++tessellations_; }
+
+	/// Keeps the given resource alive until all frames that might
+	/// currently use it have completed. Should be used for resources
+	/// that are replaced during an update.
+	void keepAlive(vpp::SubBuffer&&);
+	void keepAlive(vpp::TrDs&&);
+	void keepAlive(Texture&&);
+	void keepAlive(vpp::CommandBuffer&&);
+	void keepAlive(BindlessSlot&&);
+
+	/// Returns the given range of a geometry arena block to the arena
+	/// once all frames that might currently use it have completed.
+	/// Called by the arena for every range freed by its owner.
+	void retireRange(unsigned block, vk::DeviceSize offset,
+		vk::DeviceSize size);
+
+	/// Bookkeeping of the objects used by layers, called by Layer.
+	void addLayer(Layer&);
+	void removeLayer(Layer&);
+	void layerRecorded(Layer&, const std::vector<const DeviceObject*>& old);
+
+	/// Registers the CachedGroups rendered in stageUpload.
+	void addCachedGroup(CachedGroup&);
+	void removeCachedGroup(CachedGroup&);
+
+	/// Registers the given object for the next updateDevice call.
+	/// Can be called from multiple threads.
 	void registerUpdateDevice(DevRes);
 	bool deviceObjectDestroyed(::rvg::DeviceObject&) noexcept;
 	void deviceObjectMoved(::rvg::DeviceObject&, ::rvg::DeviceObject&) noexcept;
 
 private:
+	// Persistently mapped host visible buffer from which all staging
+	// memory of a frame is allocated. Reset when the frame is reused.
+	struct StagingArena {
+		vpp::SubBuffer buffer;
+		vpp::MemoryMapView map;
+		vk::DeviceSize offset {};
+	};
+
+	// owner is the index into Temporaries::owners
+	struct BufferUpload {
+		std::uint32_t owner;
+		vk::Buffer src;
+		vk::Buffer dst;
+		vk::BufferCopy copy;
+	};
+
+	struct ImageUpload {
+		std::uint32_t owner;
+		vk::Buffer src;
+		vk::Image dst;
+		vk::ImageLayout layout;
+		vk::BufferImageCopy copy;
+	};
+
+	// Range of a GeometryArena block, in units of the block
+	struct RetiredRange {
+		unsigned block;
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+	};
+
 	// Per-frame objects mainly used to efficiently upload data
 	struct Temporaries {
-		std::vector<std::pair<DevRes, vpp::CommandBuffer>> cmdBufs;
-		std::vector<vpp::SubBuffer> stages;
+		std::vector<BufferUpload> bufferUploads;
+		std::vector<ImageUpload> imageUploads;
+		std::vector<DeviceObject*> owners; // nullptr when destroyed
+		StagingArena arena;
+
+		// resources that might still be used by this frame, retired
+		// by replaced and destroyed objects. Released when the frame
+		// is reused, see keepAlive and retireRange.
+		std::vector<vpp::SubBuffer> buffers; // also retired arenas
+		std::vector<vpp::TrDs> descriptors;
+		std::vector<vpp::ViewableImage> images;
+		std::vector<vpp::CommandBuffer> commandBuffers;
+		std::vector<RetiredRange> ranges; // of the geometry arena
+		std::vector<BindlessSlot> slots; // cleared in ~Context
+
+		vpp::CommandBuffer cmdBuf;
+		vpp::Semaphore semaphore;
+		std::uint64_t submission {};
+
+		// only used with CachedGroups, created on demand
+		vpp::CommandBuffer renderCmdBuf;
+		vpp::Semaphore renderSemaphore;
+
+		// only used with a dedicated transfer queue
+		vpp::CommandBuffer releaseCmdBuf;
+		vpp::Semaphore releaseSemaphore;
+		vpp::CommandBuffer transferCmdBuf;
+		vpp::Semaphore transferSemaphore;
 	};
 
+	Temporaries& currentFrame() { return frames_[frame_]; }
+	std::uint32_t uploadOwner(DeviceObject&);
+	void updateHostParallel();
+	void unreferenceLayer(Layer&, const std::vector<const DeviceObject*>&);
+	void invalidate(const DeviceObject*);
+	std::size_t rerecordCauses();
+	bool updateBindless();
+	void createShaders(ShaderProgram);
+	vpp::Pipeline createPipeline(ShaderProgram, vk::PrimitiveTopology,
+		std::uint32_t drawType, std::uint32_t paintType);
+	static std::uint32_t pipelineKey(ShaderProgram, vk::PrimitiveTopology,
+		std::uint32_t drawType, std::uint32_t paintType);
+	void writeBindlessDs();
+	void recordUploads(vk::CommandBuffer, bool transferQueue);
+	void submitTransferUploads();
+	vk::Semaphore renderCachedGroups(vk::Semaphore wait);
+	std::vector<vk::BufferMemoryBarrier> ownershipBarriers(
+		unsigned srcFamily, unsigned dstFamily);
+	std::vector<vk::ImageMemoryBarrier> imageBarriers();
+
 	// NOTE: order here is rather important since some of them depend
 	// on each other. Don't change unless you know what you
 	// are doing (so probably: don't change period).
 	const vpp::Device& device_;
 	const ContextSettings settings_;
-	std::unordered_set<DevRes> updateDevice_;
 
-	Temporaries currentFrame_;
-	Temporaries oldFrame_;
+	// Objects registered for the next updateDevice call, in registration
+	// order. Destroyed objects leave a default constructed (nullptr)
+	// entry behind. Each object knows its index (updateSlot_).
+	std::vector<DevRes> updateDevice_;
+	std::mutex updateMutex_; // guards updateDevice_
+	std::unique_ptr<ThreadPool> threadPool_;
+
+	// Ring of framesInFlight + 1 frames: the one currently being
+	// filled and those that might still be pending.
+	std::vector<Temporaries> frames_;
+	unsigned frame_ {};
+	std::uint64_t frameCount_ {1}; // incremented every stageUpload
+	std::optional<vpp::QueueSubmitter> transferSubmitter_;
+
+	// wait stage of our submissions, which are only added to the
+	// QueueSubmitter and must therefore outlive stageUpload
+	const vk::PipelineStageFlags waitStage_ {
+		vk::PipelineStageBits::allCommands};
+
+	// statistics of the current and the last frame
+	FrameStats stats_;
+	FrameStats lastStats_;
+	std::mutex statsMutex_; // guards stats_.rerecords
+	std::atomic<unsigned> tessellations_ {}; // for stats_
+	std::atomic<vk::DeviceSize> bytesWritten_ {}; // for stats_
+	std::atomic<vk::DeviceSize> bytesStaged_ {}; // for stats_
+
+	// created on first use, see pipeline()
+	struct Shaders {
+		vpp::ShaderModule vertex;
+		vpp::ShaderModule fragment;
+	};
 
-	vpp::Pipeline fanPipe_;
-	vpp::Pipeline stripPipe_;
+	std::array<Shaders, shaderProgramCount> shaders_; // by ShaderProgram
 	vpp::PipelineLayout pipeLayout_;
+	std::unordered_map<std::uint32_t, vpp::Pipeline> pipelines_;
+	vpp::PipelineCache pipelineCache_; // with pipelineCacheFile
+	bool pipelineCacheChanged_ {};
+	std::mutex pipelineMutex_; // guards all of the above except the layout
 
 	vpp::TrDsLayout dsLayoutTransform_;
 	vpp::TrDsLayout dsLayoutScissor_;
@@ -180,11 +656,24 @@ private:
 	vpp::TrDsLayout dsLayoutFontAtlas_;
 	vpp::TrDsLayout dsLayoutStrokeAA_;
 
+	vpp::TrDsLayout dsLayoutBindless_;
+
 	vpp::Sampler texSampler_;
 
 	Texture emptyImage_;
 	vpp::TrDs dummyTex_;
 
+	// bindless mode, must outlive all objects having slots in them
+	std::unique_ptr<BindlessBuffer> bindlessTransforms_;
+	std::unique_ptr<BindlessBuffer> bindlessScissors_;
+	std::unique_ptr<BindlessBuffer> bindlessPaints_;
+	std::unique_ptr<BindlessTextures> bindlessTextures_;
+	vpp::TrDs bindlessDs_;
+
+	std::unique_ptr<GeometryArena> geometryArena_;
+	std::unique_ptr<DamageTracker> damage_;
+	std::unique_ptr<GpuTimer> gpuTimer_;
+
 	Scissor defaultScissor_;
 	Transform identityTransform_;
 	Paint pointColorPaint_;
@@ -193,10 +682,14 @@ private:
 	vpp::SubBuffer defaultStrokeAABuf_;
 	vpp::TrDs defaultStrokeAA_;
 
-	bool rerecord_ {};
+	std::atomic<bool> rerecord_ {};
+
+	// All layers and the layers using an object
+	std::vector<Layer*> layers_;
+	std::unordered_map<const DeviceObject*, std::vector<Layer*>> layerRefs_;
+	mutable std::mutex layerMutex_; // guards layers_, layerRefs_
 
-	vpp::Semaphore uploadSemaphore_;
-	vpp::CommandBuffer uploadCmdBuf_;
+	std::vector<CachedGroup*> cachedGroups_;
 };
 
 } // namespace rvg
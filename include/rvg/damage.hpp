@@ -0,0 +1,144 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+
+#include <vpp/fwd.hpp>
+#include <nytl/nonCopyable.hpp>
+#include <nytl/rect.hpp>
+#include <nytl/mat.hpp>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rvg {
+
+/// Accumulates the regions of the output that changed since the last frame,
+/// so that only those have to be rendered again (e.g. by setting the
+/// damage as scissor and presenting it with VK_KHR_incremental_present).
+/// Knows where objects are drawn from the Recorder: every Polygon, Text,
+/// SdfShape, ShapeBatch and SpriteBatch draw is stored with the Transform,
+/// Scissor and Paint bound at that time. Damage is added for:
+/// - updated polygons, texts, shapes and sprites (their previous and
+///   new bounds)
+/// - updated transforms, scissors and paints (all draws using them)
+/// - draws that were not recorded before and draws of destroyed objects
+/// - updated textures (the whole output, their users are not known)
+/// Draws the application no longer records are not detected, their
+/// region must be added manually (see add).
+/// All rects are in normalized device coordinates of the render pass
+/// of the Context. Only created with ContextSettings::damageTracking.
+class DamageTracker : public nytl::NonMovable {
+public:
+	/// The state bound for a draw, nullptr if none was bound.
+	/// No transform is handled like the identity, no scissor like
+	/// Scissor::reset.
+	struct Draw {
+		const Transform* transform {};
+		const Scissor* scissor {};
+		const Paint* paint {};
+
+		friend bool operator==(const Draw& a, const Draw& b) {
+			return a.transform == b.transform && a.scissor == b.scissor &&
+				a.paint == b.paint;
+		}
+	};
+
+	/// The maximum number of separate rects. When exceeded, all
+	/// rects are merged into their bounds.
+	static constexpr auto maxRects = 8u;
+
+public:
+	DamageTracker(Context&);
+	~DamageTracker();
+
+	/// The rects damaged since the last reset. Overlapping rects are merged.
+	const auto& rects() const { return rects_; }
+
+	/// Whether the whole output is damaged.
+	bool full() const { return full_; }
+
+	/// Whether nothing changed, i.e. the previously rendered frame is
+	/// still valid and rendering (and presenting) can be skipped.
+	bool idle() const { return !full_ && rects_.empty(); }
+
+	/// The bounds of all damage.
+	Rect2f bounds() const;
+
+	/// Returns the bounds or the rects of the damage in pixels of a
+	/// framebuffer with the given extent, e.g. to be used as scissor
+	/// or present regions. Rounded outwards, clamped to the framebuffer.
+	vk::Rect2D scissor(vk::Extent2D) const;
+	std::vector<vk::Rect2D> regions(vk::Extent2D) const;
+
+	/// Adds the given rect or the whole output to the damage.
+	void add(const Rect2f&);
+	void addFull();
+
+	/// Clears the damage. Called at the start of Context::updateDevice.
+	void reset();
+
+	Context& context() const { return *context_; }
+
+	// - internal, called by Recorder, Context and CachedGroup -
+	void drawn(const Polygon&, const Draw&);
+	void drawn(const Text&, const Draw&);
+	void drawn(const SdfShape&, const Draw&);
+	void drawn(const ShapeBatch&, const Draw&);
+	void drawn(const SpriteBatch&, const Draw&);
+
+	void updated(const Polygon&);
+	void updated(const Text&);
+	void updated(const SdfShape&);
+	void updated(const ShapeBatch&);
+	void updated(const SpriteBatch&);
+	void updated(const Transform&);
+	void updated(const Scissor&);
+	void updated(const Paint&);
+	void updated(const Texture&);
+	void updated(const FontAtlas&) {}
+	void updated(const TextureAtlas&) {} // only writes unused regions
+	void updated(const DrawBatch&) {}
+
+	/// Damages all draws of the given object with its current bounds.
+	void redrawn(const DeviceObject&);
+
+	void destroyed(const DeviceObject&);
+	void moved(const DeviceObject&, const DeviceObject&);
+
+protected:
+	// A drawn polygon or text
+	struct Object {
+		Rect2f bounds; // local bounds as of the last update
+		std::vector<Draw> draws;
+	};
+
+	// A transform, scissor or paint used by draws
+	struct State {
+		Mat4f matrix; // transform as of the last update
+		Rect2f rect; // scissor as of the last update
+		std::vector<const DeviceObject*> users; // objects drawn with it
+	};
+
+	void drawn(const DeviceObject&, const Rect2f& bounds, const Draw&);
+	void updated(const DeviceObject&, const Rect2f& bounds);
+	void updatedState(const DeviceObject&, const Mat4f*, const Rect2f*);
+	void removeUser(const DeviceObject* state, const DeviceObject& user);
+	void damage(const Rect2f& bounds, const Draw&);
+	void merge(Rect2f);
+
+protected:
+	Context* context_ {};
+	std::vector<Rect2f> rects_;
+	bool full_ {};
+
+	std::unordered_map<const DeviceObject*, Object> objects_;
+	std::unordered_map<const DeviceObject*, State> states_;
+	std::mutex mutex_;
+};
+
+} // namespace rvg
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <rvg/fwd.hpp>
+#include <cstdint>
 
 namespace rvg {
 
@@ -30,7 +31,16 @@ public:
 	Context& context() const { return *context_; }
 
 private:
+	friend class Context;
+	static constexpr auto noSlot = std::uint32_t(0xFFFFFFFFu);
+
 	Context* context_ {};
+
+	// Intrusive bookkeeping of the Context, makes registering,
+	// moving and destroying objects constant time.
+	std::uint32_t updateSlot_ {noSlot}; // index in the list of dirty objects
+	std::uint32_t uploadSlot_ {}; // index in the owners of uploadFrame_
+	std::uint64_t uploadFrame_ {}; // frame of the last upload
 };
 
 } // namespace rvg
@@ -0,0 +1,84 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/deviceObject.hpp>
+#include <rvg/polygon.hpp>
+
+#include <vpp/sharedBuffer.hpp>
+#include <utility>
+#include <vector>
+
+namespace rvg {
+
+/// Draws many polygons that share the same bound state (paint, transform,
+/// scissor) with as few commands as possible.
+/// Polygons are drawn in the order they were added. The indirect draw
+/// commands of all polygons are packed into one buffer and consecutive
+/// polygons whose vertices live in the same arena block are drawn
+/// with one multi draw (if ContextSettings::multiDrawIndirect is set,
+/// otherwise with one indirect draw per polygon but without any
+/// state changes in between). Since polygon geometry is sub-allocated
+/// from the GeometryArena of the Context, most polygons share a block.
+/// Only supports polygons that are filled (or stroked, depending on
+/// the DrawType of the batch) without anti aliasing and per-point colors.
+/// Polygons without vertices for the DrawType of the batch (e.g. ones
+/// that were not updated yet) can be added as well, they draw nothing.
+/// Updating or disabling a polygon in a batch only updates its
+/// command in the batch and does not trigger a rerecord, as long as
+/// its vertices stay in the same block.
+/// A polygon can only be part of one batch at a time.
+class DrawBatch : public DeviceObject {
+public:
+	DrawBatch() = default;
+	DrawBatch(Context&, DrawType = DrawType::fill, bool deviceLocal = true);
+	~DrawBatch();
+
+	DrawBatch(DrawBatch&&) noexcept;
+	DrawBatch& operator=(DrawBatch&&) noexcept;
+
+	/// Adds/removes a polygon to/from this batch.
+	/// Adding a polygon that is already part of a batch is not allowed.
+	/// Changes the recorded commands, i.e. will trigger a rerecord.
+	void add(Polygon&);
+	void remove(Polygon&);
+
+	/// Records the commands to draw all polygons in this batch.
+	void draw(vk::CommandBuffer) const;
+	void draw(Recorder&) const;
+
+	DrawType type() const { return type_; }
+	std::size_t size() const { return polygons_.size(); }
+
+	bool updateDevice();
+
+	// - internal, called by Polygon -
+	void updated(const Polygon&);
+	void moved(const Polygon&, Polygon&) noexcept;
+
+protected:
+	// Polygons with vertices in the same block, consecutive in polygons_
+	struct Run {
+		std::pair<vk::Buffer, vk::DeviceSize> binding;
+		unsigned first;
+		unsigned count;
+	};
+
+	void invalidate();
+	vk::DrawIndirectCommand command(const Polygon&) const;
+	const VertexRange& vertices(const Polygon&) const;
+	std::pair<vk::Buffer, vk::DeviceSize> binding(const Polygon&) const;
+
+protected:
+	DrawType type_ {};
+	bool deviceLocal_ {};
+	bool dirty_ {}; // whether runs must be rebuilt
+	std::vector<Polygon*> polygons_;
+	std::vector<Run> runs_;
+	vpp::SubBuffer commands_;
+};
+
+} // namespace rvg
@@ -7,6 +7,7 @@
 #include <rvg/fwd.hpp>
 #include <rvg/paint.hpp>
 #include <rvg/deviceObject.hpp>
+#include <rvg/bindless.hpp>
 
 #include <vpp/trackedDescriptor.hpp>
 #include <vpp/sharedBuffer.hpp>
@@ -31,6 +32,7 @@ public:
 
 	auto& ds() const { return ds_; }
 	auto& texture() const { return texture_; }
+	auto& bindlessSlot() const { return texSlot_; } // only in bindless mode
 	auto* stash() const { return ctx_; }
 
 	// - usually not needed -
@@ -48,6 +50,7 @@ protected:
 	std::vector<Text*> texts_;
 	vpp::TrDs ds_;
 	Texture texture_;
+	BindlessSlot texSlot_;
 	bool invalid_ {};
 	std::vector<std::vector<std::byte>> blobs_;
 };
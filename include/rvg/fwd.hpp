@@ -18,13 +18,31 @@ struct DrawMode;
 
 class DeviceObject;
 class Context;
+class Recorder;
+class BindlessSlot;
+class BindlessBuffer;
+class BindlessTextures;
+class GeometryArena;
+class GeometryRange;
+class VertexRange;
+class InstanceBuffer;
+class Layer;
+class CachedGroup;
+class DamageTracker;
+class GpuTimer;
+class HeadlessTarget;
 
 class Polygon;
+class DrawBatch;
 class RectShape;
 class CircleShape;
 class Shape;
+class SdfShape;
+class ShapeBatch;
+class SpriteBatch;
 
 class Texture;
+class TextureAtlas;
 class Paint;
 class Transform;
 class Scissor;
@@ -33,4 +51,6 @@ class FontAtlas;
 class Font;
 class Text;
 
+enum class ShaderProgram : unsigned;
+
 } // namespace rvg
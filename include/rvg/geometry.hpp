@@ -0,0 +1,254 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+
+#include <vpp/sharedBuffer.hpp>
+#include <nytl/nonCopyable.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace rvg {
+
+/// Vertex attribute streams, in the order of the vertex input
+/// bindings of the context pipelines.
+enum class VertexStream : unsigned {
+	position, // vec2
+	aux, // vec2, uv coords (text) or anti aliasing values (strokes)
+	color, // u8vec4
+};
+
+/// Which streams (apart from the always present position stream)
+/// are stored for a VertexRange.
+enum class VertexFormat : unsigned {
+	position = 0u,
+	aux = 1u,
+	color = 2u,
+	auxColor = 3u,
+};
+
+/// Returns the format storing the given optional streams.
+inline VertexFormat vertexFormat(bool aux, bool color) {
+	return VertexFormat(unsigned(aux) | (unsigned(color) << 1u));
+}
+
+/// Range of bytes in a GeometryArena. Frees it on destruction.
+/// Can be used like a vpp::SubBuffer.
+class GeometryRange : public nytl::NonCopyable {
+public:
+	GeometryRange() = default;
+	~GeometryRange() { reset(); }
+
+	GeometryRange(GeometryRange&& rhs) noexcept { swap(*this, rhs); }
+	GeometryRange& operator=(GeometryRange rhs) noexcept {
+		swap(*this, rhs);
+		return *this;
+	}
+
+	void reset();
+
+	const auto& span() const { return span_; }
+	auto& buffer() const { return span_.buffer(); }
+	auto offset() const { return span_.offset(); }
+	auto size() const { return span_.size(); }
+
+	friend void swap(GeometryRange& a, GeometryRange& b) noexcept;
+
+protected:
+	friend class GeometryArena;
+	GeometryArena* arena_ {};
+	unsigned block_ {};
+	vpp::BufferSpan span_ {};
+};
+
+/// Range of vertices in a GeometryArena. Frees it on destruction.
+/// Every attribute is stored in its own stream of the block and all
+/// streams are addressed with the same vertex index. The streams
+/// are therefore bound once per block (see streamOffset) and a range
+/// is selected with the firstVertex of a draw command. Ranges that
+/// move inside their block don't invalidate recorded commands.
+class VertexRange : public nytl::NonCopyable {
+public:
+	VertexRange() = default;
+	~VertexRange() { reset(); }
+
+	VertexRange(VertexRange&& rhs) noexcept { swap(*this, rhs); }
+	VertexRange& operator=(VertexRange rhs) noexcept {
+		swap(*this, rhs);
+		return *this;
+	}
+
+	void reset();
+
+	/// Whether vertices were allocated for this range.
+	bool valid() const { return arena_; }
+
+	/// The buffer and offsets to bind the streams at.
+	/// Streams not stored in the format of this range return the
+	/// offset of the position stream so they can be bound as dummies.
+	vk::Buffer buffer() const;
+	vk::DeviceSize streamOffset(VertexStream) const;
+
+	/// The part of the given stream that belongs to this range.
+	/// Must only be called for streams stored in this range.
+	vpp::BufferSpan stream(VertexStream) const;
+
+	/// The first vertex and the number of vertices in this range.
+	unsigned first() const { return first_; }
+	unsigned size() const { return size_; }
+
+	friend void swap(VertexRange& a, VertexRange& b) noexcept;
+
+protected:
+	friend class GeometryArena;
+	GeometryArena* arena_ {};
+	unsigned block_ {};
+	unsigned first_ {};
+	unsigned size_ {};
+};
+
+/// Instance data and indirect draw command of an instanced batch
+/// (see ShapeBatch and SpriteBatch), allocated from the geometry arena.
+/// The buffer is bound at the offset of its range and the indirect
+/// command always uses a firstInstance of 0, so the
+/// drawIndirectFirstInstance feature is not needed. Only changed
+/// instances are uploaded, a changed number of instances only rewrites
+/// the command. A rerecord is only needed when the buffer has to grow
+/// into a new range.
+class InstanceBuffer {
+public:
+	InstanceBuffer() = default;
+	InstanceBuffer(Context&, vk::DeviceSize instanceSize, bool deviceLocal);
+
+	/// Marks the given instances for upload.
+	void changed(unsigned first, unsigned count);
+
+	/// The number of instances changed from old to count.
+	/// Marks new instances for upload.
+	void resized(unsigned old, unsigned count);
+
+	/// Makes sure the buffer has space for count instances and marks
+	/// all of them for upload if it had to grow. The old range is retired.
+	/// Returns whether the range changed, i.e. whether commands
+	/// drawing it must be rerecorded.
+	bool reserve(unsigned count);
+
+	/// The range of instances marked for upload.
+	unsigned dirtyBegin() const { return dirtyBegin_; }
+	unsigned dirtyEnd() const { return dirtyEnd_; }
+
+	/// Uploads the given data of the marked instances and, if the
+	/// number of instances changed, the draw command. Clears the marks.
+	void upload(DeviceObject& owner, unsigned count,
+		Span<const std::byte> instances);
+
+	/// Binds the buffer to all vertex bindings and draws the instances
+	/// as quads, i.e. 4 vertices each as triangle strip.
+	void draw(Recorder&) const;
+
+	bool valid() const { return cmd_.size(); }
+
+protected:
+	GeometryArena* arena_ {};
+	vk::DeviceSize instanceSize_ {};
+	bool deviceLocal_ {};
+	unsigned dirtyBegin_ {};
+	unsigned dirtyEnd_ {};
+	bool countChanged_ {};
+
+	GeometryRange buffer_; // instances
+	GeometryRange cmd_; // vk::DrawIndirectCommand
+};
+
+/// Context-wide sub-allocator for the vertex and indirect command data
+/// of Polygons and Texts. Allocates few large buffers and sub-allocates
+/// from them so that memory stays dense and draws of different objects
+/// share vertex buffers. Freed ranges might still be read by pending
+/// frames, they are retired by the Context and only returned to their
+/// block once those completed (see Context::retireRange). There they
+/// are merged with their neighbors and reused, allocations prefer the
+/// lowest free address so that blocks at the end drain and are
+/// released in trim.
+/// Growing vertex ranges move inside their block if they have to,
+/// which does not require a rerecord (see VertexRange).
+class GeometryArena : public nytl::NonMovable {
+public:
+	/// Default size of a block, larger allocations get their own block.
+	static constexpr vk::DeviceSize blockSize = 1024 * 1024;
+
+	/// Default size of a block for byte ranges (mainly indirect commands,
+	/// also uniform buffers and instance data).
+	static constexpr vk::DeviceSize smallBlockSize = 64 * 1024;
+
+	/// Returns the size of a vertex in the given stream/format.
+	static vk::DeviceSize stride(VertexStream);
+	static vk::DeviceSize stride(VertexFormat);
+
+public:
+	GeometryArena(Context&);
+	~GeometryArena();
+
+	/// Allocates a new range of the given size.
+	/// The memory is device local or host visible depending on deviceLocal.
+	GeometryRange allocate(vk::DeviceSize, bool deviceLocal,
+		vk::DeviceSize align);
+
+	/// Makes sure the given range has space for at least the given
+	/// number of vertices in the given format and memory.
+	/// Grows the range in place if possible, otherwise moves it, trying
+	/// its own block first. Returns whether the streams of the range
+	/// have to be bound differently, i.e. whether command buffers
+	/// referencing it must be rerecorded. Moving inside a block only
+	/// changes first() which is passed in the indirect draw command.
+	bool resize(VertexRange&, unsigned count, VertexFormat, bool deviceLocal);
+
+	/// Releases all blocks without allocations (except one per kind of
+	/// block). Their buffers are kept alive until pending frames
+	/// completed.
+	void trim();
+
+	/// Returns the given range (in units of the block) to its block.
+	/// Usually only called by the Context for ranges retired
+	/// by the arena, when the frames that might use them completed.
+	void release(unsigned block, vk::DeviceSize offset, vk::DeviceSize size);
+
+	/// Returns the number of allocated bytes and the size of all blocks.
+	/// Retired ranges count as allocated until they are released.
+	vk::DeviceSize used() const;
+	vk::DeviceSize capacity() const;
+
+	Context& context() const { return *context_; }
+
+protected:
+	friend class GeometryRange;
+	friend class VertexRange;
+
+	// Units are bytes for byte blocks and vertices for vertex blocks
+	struct Block {
+		vpp::SubBuffer buffer;
+		bool deviceLocal;
+		bool vertices; // whether this is a vertex block
+		VertexFormat format; // only for vertex blocks
+		vk::DeviceSize capacity; // in units
+		std::map<vk::DeviceSize, vk::DeviceSize> free; // offset, size
+		vk::DeviceSize used {};
+	};
+
+	unsigned createBlock(vk::DeviceSize capacity, bool deviceLocal,
+		bool vertices, VertexFormat);
+	vk::DeviceSize streamOffset(const Block&, VertexStream) const;
+	void free(unsigned block, vk::DeviceSize offset, vk::DeviceSize size);
+	bool allocate(unsigned block, vk::DeviceSize size, vk::DeviceSize align,
+		vk::DeviceSize& offset);
+
+protected:
+	Context* context_ {};
+	std::vector<std::unique_ptr<Block>> blocks_; // nullptr when released
+};
+
+} // namespace rvg
@@ -0,0 +1,63 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/context.hpp>
+
+#include <vpp/image.hpp>
+#include <vpp/renderPass.hpp>
+#include <vpp/sharedBuffer.hpp>
+#include <nytl/nonCopyable.hpp>
+#include <nytl/vec.hpp>
+
+namespace rvg {
+
+/// Offscreen render target for rendering without a window or swapchain,
+/// e.g. for tests, benchmarks or server side rendering.
+/// Owns a color image, a render pass with a single subpass rendering
+/// into it and a framebuffer. The render pass leaves the image in
+/// transferSrcOptimal layout so it can be read back after rendering.
+class HeadlessTarget : public nytl::NonMovable {
+public:
+	/// The device must stay valid for the lifetime of this object.
+	/// The format must support color attachment and transfer src usage.
+	HeadlessTarget(const vpp::Device&, Vec2ui size,
+		vk::Format = vk::Format::r8g8b8a8Unorm);
+	~HeadlessTarget();
+
+	/// Returns default settings for a Context rendering into
+	/// this target, i.e. with its render pass and subpass set.
+	ContextSettings contextSettings() const;
+
+	/// Begins the render pass in the given command buffer and clears
+	/// the image with the given color. With inline contents, also sets
+	/// viewport and scissor to the full target.
+	void beginRenderPass(vk::CommandBuffer, const Vec4f& clear = {0, 0, 0, 1},
+		vk::SubpassContents = {}) const;
+	void endRenderPass(vk::CommandBuffer) const;
+
+	/// Records a copy of the image into a new host visible buffer.
+	/// Must be recorded after the render pass. The buffer contains the
+	/// tightly packed rows of the image when the command buffer completed.
+	vpp::SubBuffer read(vk::CommandBuffer) const;
+
+	const vpp::Device& device() const { return *device_; }
+	const auto& renderPass() const { return rp_; }
+	const auto& framebuffer() const { return fb_; }
+	const auto& image() const { return image_; }
+	const auto& size() const { return size_; }
+	auto format() const { return format_; }
+
+protected:
+	const vpp::Device* device_ {};
+	Vec2ui size_;
+	vk::Format format_;
+	vpp::RenderPass rp_;
+	vpp::ViewableImage image_;
+	vpp::Framebuffer fb_;
+};
+
+} // namespace rvg
@@ -0,0 +1,91 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+
+#include <vpp/commandBuffer.hpp>
+#include <nytl/nonCopyable.hpp>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace rvg {
+
+/// Group of draws recorded into its own secondary command buffer.
+/// The Context tracks which objects were used while recording
+/// a layer. When one of them signals a rerecord (or is destroyed), only
+/// the layers using it become invalid, see Context::invalidLayers.
+/// A rerecord that can't be attributed to an object (e.g. Context::rerecord
+/// or a growing bindless table) invalidates all layers.
+/// Re-recording a layer invalidates the primary command buffers executing
+/// it, so Context::updateDevice still returns true in that case. But the
+/// primary command buffer only executes the layers, which is cheap
+/// compared to recording all their draws again.
+/// Must not be destroyed while a frame executing it is pending.
+class Layer : public nytl::NonMovable {
+public:
+	/// Records the draws of the layer. Every draw and bind must go through
+	/// the given Recorder, otherwise the used objects are not tracked.
+	/// The Recorder starts with the default state of the Context bound.
+	/// Dynamic state (viewport, scissor) is not inherited by secondary
+	/// command buffers and must be set on Recorder::cmdBuf here.
+	using Recording = std::function<void(Recorder&)>;
+
+public:
+	/// The recording function is called from record and must stay valid.
+	/// The layer can be executed in the given render pass and subpass
+	/// which must be compatible with the one of the Context. Uses the
+	/// render pass of the Context if none is given.
+	Layer(Context&, Recording, vk::RenderPass = {}, unsigned subpass = 0u);
+	~Layer();
+
+	/// Records the secondary command buffer again if the layer is invalid.
+	/// Returns whether it did. The previous command buffer is kept alive
+	/// until the frames that might use it have completed.
+	bool record();
+
+	/// Executes the recorded commands in the given primary command buffer.
+	/// Must be called inside the renderpass/subpass of the Context, the
+	/// subpass must use secondary command buffer contents.
+	void execute(vk::CommandBuffer) const;
+
+	/// Marks this layer as invalid, i.e. the next record call rerecords it.
+	/// Must not be called during Context::updateDevice.
+	void invalidate();
+	bool invalid() const { return invalid_; }
+
+	/// Whether an object used by this layer was updated (i.e. its data
+	/// on the device changed) since the last record or clearChanged call.
+	/// Used by CachedGroup to detect when it has to render again.
+	bool changed() const { return changed_; }
+	void clearChanged() { changed_ = false; }
+
+	vk::CommandBuffer commandBuffer() const { return cmdBuf_; }
+	Context& context() const { return *context_; }
+
+	// - internal, used by Recorder and Context -
+	void use(const DeviceObject&);
+	void moved(const DeviceObject&, const DeviceObject&);
+	const auto& references() const { return refs_; }
+
+protected:
+	friend class Context;
+
+	Context* context_ {};
+	Recording recording_;
+	vk::RenderPass renderPass_ {};
+	unsigned subpass_ {};
+	vpp::CommandBuffer cmdBuf_;
+	std::vector<const DeviceObject*> refs_; // objects used while recording
+
+	// set by the Context while holding its layer mutex, atomic
+	// since the layer reads and resets them without it
+	std::atomic<bool> invalid_ {true};
+	std::atomic<bool> changed_ {};
+};
+
+} // namespace rvg
@@ -7,6 +7,7 @@
 #include <rvg/fwd.hpp>
 #include <rvg/deviceObject.hpp>
 #include <rvg/stateChange.hpp>
+#include <rvg/bindless.hpp>
 
 #include <nytl/vec.hpp>
 #include <nytl/mat.hpp>
@@ -126,10 +127,10 @@ public:
 
 public:
 	Texture() = default;
-	~Texture() = default;
+	~Texture();
 
 	Texture(Texture&&) noexcept = default;
-	Texture& operator=(Texture&&) noexcept = default;
+	Texture& operator=(Texture&&) noexcept;
 
 	/// Attempts to load the texture from the given file.
 	/// Throws std::runtime_error if the file cannot be loaded.
@@ -146,6 +147,12 @@ public:
 	/// where formatSize(Type::a8) = 1 and formatSize(Type::rgba32) = 4.
 	void update(std::vector<std::byte> data);
 
+	/// Uploads only the given region of the texture in the next
+	/// stageUpload call. data must reference the whole image as above,
+	/// only the rows and columns of the region are read (and copied
+	/// immediately). The region must lie inside the texture.
+	void update(Vec2ui offset, Vec2ui size, nytl::Span<const std::byte> data);
+
 	const auto& viewableImage() const { return image_; }
 	const auto& size() const { return size_; }
 	auto vkImage() const { return viewableImage().vkImage(); }
@@ -155,6 +162,7 @@ public:
 	bool updateDevice();
 
 protected:
+	friend class Context; // keepAlive
 	void create();
 	void upload(nytl::Span<const std::byte> data, vk::ImageLayout);
 
@@ -205,35 +213,49 @@ PaintData pointColorPaint();
 
 /// Defines how shapes are drawn.
 /// For a more fine-grained control see PaintBinding and PaintBuffer.
+/// In bindless mode (see ContextSettings::bindless) the paint is stored
+/// in a table of the Context instead and deviceLocal has no effect.
 class Paint : public DeviceObject {
 public:
 	Paint() = default;
 	Paint(Context&, const PaintData& data, bool deviceLocal = true);
+	~Paint();
+
+	Paint(Paint&&) noexcept = default;
+	Paint& operator=(Paint&&) noexcept;
 
 	/// Binds the Paint object in the given DrawInstance.
 	/// Following calls to fill/stroke of a polygon-based shape
 	/// or Text::draw will use this bound paint until another
 	/// Paint is bound.
 	void bind(vk::CommandBuffer cb) const;
+	void bind(Recorder&) const;
 
+	/// Changes the paint. With ContextSettings::pipelineVariants,
+	/// changing the type of the paint triggers a rerecord.
 	auto change() { return StateChange {*this, paint_}; }
 	void paint(const PaintData& data) { *change() = data; }
 	const auto& paint() const { return paint_; }
 
 	const auto& ubo() const { return ubo_; }
 	const auto& ds() const { return ds_; }
+	const auto& bindlessSlot() const { return slot_; }
 
 	void update();
 	bool updateDevice();
 
 protected:
 	void upload();
+	void writeDs();
 
 protected:
 	PaintData paint_ {};
 	vpp::SubBuffer ubo_;
 	vpp::TrDs ds_;
 	vk::ImageView oldView_ {};
+	PaintType oldType_ {}; // recorded in specialized pipelines
+	BindlessSlot slot_;
+	BindlessSlot texSlot_;
 };
 
 } // namespace rvg
@@ -6,11 +6,16 @@
 
 #include <rvg/fwd.hpp>
 #include <rvg/deviceObject.hpp>
+#include <rvg/geometry.hpp>
 
 #include <nytl/vec.hpp>
+#include <nytl/rect.hpp>
 #include <vpp/trackedDescriptor.hpp>
 #include <vpp/sharedBuffer.hpp>
 
+#include <functional>
+#include <vector>
+
 namespace rvg {
 
 /// Specifies in which way a polygon can be drawn.
@@ -66,6 +71,27 @@ struct DrawMode {
 	bool deviceLocal {};
 };
 
+/// Host side vertex data of a tessellated polygon draw.
+/// The aa and color values are only generated if enabled in
+/// the DrawMode, otherwise they stay empty.
+struct Vertices {
+	std::vector<Vec2f> points;
+	std::vector<Vec2f> aa;
+	std::vector<Vec4u8> color;
+};
+
+/// Tessellates the given points for filling as Polygon does, does not
+/// need a device. With DrawMode::aaFill, generates the inset fill
+/// and the anti aliased fringe stroke (fillAA), otherwise just
+/// copies the points. Appends to the given vertices.
+void tessellateFill(Span<const Vec2f> points, const DrawMode&,
+	Vertices& fill, Vertices& fillAA);
+
+/// Tessellates the given points for stroking as Polygon does, does
+/// not need a device. Appends to the given vertices.
+void tessellateStroke(Span<const Vec2f> points, const DrawMode&,
+	Vertices& stroke);
+
 enum class DrawType {
 	stroke,
 	fill,
@@ -74,16 +100,32 @@ enum class DrawType {
 
 /// A shape defined by points that can be stroked or filled.
 class Polygon : public DeviceObject {
+public:
+	/// Appends the points of a polygon to the given (empty) vector.
+	using Outline = std::function<void(std::vector<Vec2f>&)>;
+
 public:
 	Polygon() = default;
 	Polygon(Context&);
+	~Polygon();
+
+	Polygon(Polygon&&) noexcept;
+	Polygon& operator=(Polygon&&) noexcept;
 
 	/// Can be called at any time, computes the polygon from the given
 	/// points and draw mode. The DrawMode specifies whether this polygon
 	/// can be used for filling or stroking and their properties.
 	/// Automatically registers this object for the next updateDevice call.
+	/// If the context defers updates, only stores points and mode,
+	/// the polygon is then computed only once in updateDevice.
 	void update(Span<const Vec2f> points, const DrawMode&);
 
+	/// Like the update above but the points are only generated by the
+	/// given function when the polygon is computed. If the context defers
+	/// updates, it is called once in updateDevice, no matter how often
+	/// the polygon was changed before. Used by the shapes.
+	void update(Outline, const DrawMode&);
+
 	/// Changes the disable state of this polygon.
 	/// Cheap way to hide/unhide the polygon, can be called at any
 	/// time and will never trigger a rerecord.
@@ -91,15 +133,25 @@ public:
 	void disable(bool, DrawType = DrawType::strokeFill);
 	bool disabled(DrawType = DrawType::strokeFill) const;
 
+	/// Returns the bounds of the geometry drawn by fill and stroke in
+	/// local coordinates, including stroke width and anti aliasing.
+	/// Disabled draws are not included. With deferred updates, only
+	/// reflects the last update after the following updateDevice call.
+	Rect2f drawBounds() const;
+
 	/// Records commands to fill this polygon into the given DrawInstance.
 	/// Undefined behaviour if it was updated without fill support in
 	/// the DrawMode.
+	/// The Recorder overload skips binds of already bound state.
 	void fill(vk::CommandBuffer) const;
+	void fill(Recorder&) const;
 
 	/// Records commands to stroke this polygon into the given DrawInstance.
 	/// Undefined behaviour if it was updates without stroke support in
 	/// the DrawMode.
+	/// The Recorder overload skips binds of already bound state.
 	void stroke(vk::CommandBuffer) const;
+	void stroke(Recorder&) const;
 
 	/// Usually only automatically called from context when needed.
 	/// Uploads data to the device. Must not be called while a command
@@ -107,31 +159,33 @@ public:
 	/// Returns whether a command buffer rerecord is needed.
 	bool updateDevice();
 
-protected:
-	struct Draw {
-		std::vector<Vec2f> points;
-		std::vector<Vec4u8> color;
-		vpp::SubBuffer pBuf;
-		vpp::SubBuffer cBuf;
-	};
+	/// Usually only automatically called from context when needed.
+	/// Tessellates the points of the last update if this was deferred
+	/// (see Context::deferredUpdates). Does not access the device and
+	/// may be called for different polygons from multiple threads.
+	void updateHost();
 
-	struct Stroke : public Draw {
-		std::vector<Vec2f> aa;
-		vpp::SubBuffer aaBuf;
+protected:
+	friend class DrawBatch;
+
+	// The buffers are allocated from the geometry arena of the context.
+	// The indirect command has a fixed place, so moving the vertices
+	// inside their block only changes the command, see VertexRange.
+	struct Draw : Vertices {
+		GeometryRange cmd;
+		VertexRange vertices;
 	};
 
 	// - internal utility -
-	bool upload(Draw&, bool disable, bool color);
-	bool upload(Stroke&, bool disable, bool color, bool aa, float* mult);
+	bool upload(Draw&, bool disable, bool aa, bool color);
+	void updateMode(const DrawMode&);
 
+	void bake(Span<const Vec2f>, const DrawMode&);
 	void updateStroke(Span<const Vec2f>, const DrawMode&);
 	void updateFill(Span<const Vec2f>, const DrawMode&);
 
-	void stroke(vk::CommandBuffer, const Stroke&, bool aa, bool color,
-		vk::DescriptorSet, unsigned aaOff) const;
-
-	bool checkResize(vpp::SubBuffer&, vk::DeviceSize needed,
-		vk::BufferUsageFlags);
+	void stroke(Recorder&, const Draw&, bool aa, vk::DescriptorSet,
+		float mult) const;
 
 protected:
 	struct {
@@ -147,10 +201,22 @@ protected:
 	} flags_ {};
 
 	Draw fill_;
-	Stroke fillAA_;
-	Stroke stroke_;
+	Draw fillAA_;
+	Draw stroke_;
+	GeometryRange strokeMultBuf_; // uniform buffer for strokeDs_
 	vpp::TrDs strokeDs_;
 	float strokeMult_ {};
+
+	// last update, if its tessellation was deferred
+	struct {
+		std::vector<Vec2f> points;
+		Outline outline; // generates points, if set
+		DrawMode mode;
+		bool valid {};
+	} pending_;
+
+	DrawBatch* batch_ {};
+	unsigned batchIndex_ {};
 };
 
 } // namespace rvg
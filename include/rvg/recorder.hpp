@@ -0,0 +1,130 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/damage.hpp>
+#include <rvg/timer.hpp>
+#include <vpp/vk.hpp>
+#include <array>
+#include <cstdint>
+
+namespace rvg {
+
+/// Wraps a command buffer in recording state and tracks the state bound
+/// by rvg objects (pipeline, push constants, vertex buffers and descriptor
+/// sets) so that binds that would not change anything are skipped.
+/// All rvg draw and bind functions have an overload taking a Recorder.
+/// If state is bound directly on the command buffer while a Recorder
+/// is used, reset must be called afterwards.
+/// When recording a Layer, the Recorder also collects the objects
+/// used by the layer. With damage tracking, it reports the drawn
+/// polygons, texts and shapes with the bound state to the DamageTracker.
+/// With gpu timing, it writes the timestamps of GpuTimer scopes.
+class Recorder {
+public:
+	/// How many commands were recorded and how many were elided.
+	struct Stats {
+		unsigned pipelineBinds {};
+		unsigned pipelineBindsElided {};
+		unsigned pushConstants {};
+		unsigned pushConstantsElided {};
+		unsigned vertexBufferBinds {};
+		unsigned vertexBufferBindsElided {};
+		unsigned descriptorBinds {};
+		unsigned descriptorBindsElided {};
+		unsigned draws {};
+	};
+
+	static constexpr auto vertexBindingCount = 3u;
+	static constexpr auto maxDescriptorSets = 8u;
+	static constexpr auto maxPushSlots = 8u;
+
+public:
+	Recorder(Context&, vk::CommandBuffer, Layer* = nullptr);
+
+	void bindPipeline(vk::Pipeline);
+	void pushType(std::uint32_t type);
+
+	/// Binds the pipeline for the given topology, specialized for the
+	/// given draw type (see Context::drawTypeDefault) and the type of the
+	/// paint bound with this Recorder, and pushes the draw type.
+	void bindPipeline(vk::PrimitiveTopology, std::uint32_t drawType);
+
+	/// Like above but for the pipelines of the given program.
+	void bindPipeline(ShaderProgram, vk::PrimitiveTopology,
+		std::uint32_t drawType);
+
+	/// Pushes the given value to the push constant slot with
+	/// the given index, see Context::typePushSlot.
+	void push(unsigned slot, std::uint32_t value);
+	void push(unsigned slot, float value);
+	void bindDescriptorSet(unsigned set, vk::DescriptorSet);
+
+	/// Binds the given buffers (with offsets) to the vertex bindings
+	/// 0 to 2. Only the range of bindings that changed is rebound.
+	void bindVertexBuffers(
+		const std::array<vk::Buffer, vertexBindingCount>& buffers,
+		const std::array<vk::DeviceSize, vertexBindingCount>& offsets);
+
+	void drawIndirect(vk::Buffer, vk::DeviceSize offset, unsigned count,
+		unsigned stride);
+	void draw(unsigned vertexCount, unsigned instanceCount,
+		unsigned firstVertex, unsigned firstInstance);
+
+	/// Forgets all tracked state, i.e. the next binds will not be elided.
+	void reset();
+
+	/// Signals that the recorded commands depend on the given object.
+	/// Called by all rvg draw and bind functions.
+	void use(const DeviceObject&);
+	void use(const Transform&);
+	void use(const Scissor&);
+	void use(const Paint&);
+	void use(const Polygon&);
+	void use(const Text&);
+	void use(const SdfShape&);
+	void use(const ShapeBatch&);
+	void use(const SpriteBatch&);
+
+	/// Whether draws are reported to the DamageTracker of the Context.
+	/// Should be disabled for recordings that don't render into the
+	/// output of the Context (e.g. offscreen). Enabled by default.
+	void trackDamage(bool track) { trackDamage_ = track; }
+
+	/// Sets the category of the following draws, used by the GpuTimer.
+	/// Called by all rvg draw functions.
+	void category(DrawCategory);
+	DrawCategory category() const { return category_; }
+
+	/// The GpuTimer scope currently recorded, see GpuTimer::Scope.
+	void timingScope(unsigned scope) { timingScope_ = scope; }
+	unsigned timingScope() const { return timingScope_; }
+
+	Context& context() const { return *context_; }
+	vk::CommandBuffer cmdBuf() const { return cmdBuf_; }
+	const Stats& stats() const { return stats_; }
+	Layer* layer() const { return layer_; }
+
+protected:
+	Context* context_ {};
+	vk::CommandBuffer cmdBuf_ {};
+	Layer* layer_ {};
+	Stats stats_ {};
+	bool trackDamage_ {true};
+	DamageTracker::Draw bound_ {}; // the bound state, for damage tracking
+	DrawCategory category_ {DrawCategory::none};
+	unsigned timingScope_ {GpuTimer::noScope};
+
+	vk::Pipeline pipeline_ {};
+	std::uint32_t paintType_ {0xFFFFFFFFu}; // Context::anyType if unknown
+	std::array<std::uint32_t, maxPushSlots> push_ {};
+	std::uint32_t pushValid_ {}; // bitmask of slots in push_
+	std::array<vk::Buffer, vertexBindingCount> vertexBuffers_ {};
+	std::array<vk::DeviceSize, vertexBindingCount> vertexOffsets_ {};
+	std::array<vk::DescriptorSet, maxDescriptorSets> descriptors_ {};
+};
+
+} // namespace rvg
@@ -0,0 +1,125 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/deviceObject.hpp>
+#include <rvg/geometry.hpp>
+#include <rvg/polygon.hpp>
+#include <rvg/stateChange.hpp>
+
+#include <nytl/vec.hpp>
+#include <nytl/rect.hpp>
+
+#include <array>
+#include <cstdint>
+
+namespace rvg {
+
+/// Rect with optionally rounded corners or ellipse that is evaluated
+/// analytically on the device: it is drawn as a single quad and the
+/// fragment shader computes the coverage of fill, stroke and anti
+/// aliasing from the signed distance to its outline.
+/// In contrast to RectShape and CircleShape nothing is tessellated
+/// and anti aliasing needs no fringe geometry.
+struct SdfPrimitive {
+	Vec2f position {}; // top left corner of the bounds
+	Vec2f size {};
+
+	/// The corner radii (topLeft, topRight, bottomRight, bottomLeft)
+	/// like the rounding of RectShape. Clamped to half the size,
+	/// ignored for ellipses.
+	std::array<float, 4> rounding {};
+
+	/// The width of the stroke, centered on the outline.
+	float stroke {};
+
+	/// The color used when drawn with a pointColorPaint.
+	Vec4u8 color {255u, 255u, 255u, 255u};
+
+	bool ellipse {}; // whether it is the ellipse inscribed in the bounds
+	bool aa {}; // whether the edges of fill and stroke are anti aliased
+};
+
+/// Returns the primitive of a (rounded) rect.
+SdfPrimitive sdfRect(Vec2f position, Vec2f size,
+	const std::array<float, 4>& rounding = {}, float stroke = 0.f);
+
+/// Returns the primitive of an ellipse or circle with the given center
+/// and radius.
+SdfPrimitive sdfCircle(Vec2f center, Vec2f radius, float stroke = 0.f);
+SdfPrimitive sdfCircle(Vec2f center, float radius, float stroke = 0.f);
+
+/// Returns the bounds of the area drawn for the given primitive, i.e.
+/// including the stroke (if stroke is true) and anti aliasing.
+Rect2f sdfBounds(const SdfPrimitive&, bool stroke);
+
+/// Instance data of an analytic shape as read by the sdf shaders,
+/// see fill.vert. Stored in vertex buffers with an instance input rate.
+struct SdfInstance {
+	static constexpr auto flagEllipse = 1u;
+	static constexpr auto flagAA = 2u;
+	static constexpr auto flagDisableFill = 4u;
+	static constexpr auto flagDisableStroke = 8u;
+
+	Vec2f position;
+	Vec2f size;
+	std::array<float, 4> radii;
+	Vec4u8 color;
+	float stroke;
+	std::uint32_t flags;
+	std::uint32_t pad {};
+};
+
+static_assert(sizeof(SdfInstance) == 48u);
+
+/// Returns the instance data of the given primitive.
+SdfInstance sdfInstance(const SdfPrimitive&, bool disableFill = false,
+	bool disableStroke = false);
+
+/// Analytic shape (see SdfPrimitive) drawn as one instanced quad.
+/// Updating it only rewrites its instance data, it never triggers
+/// a rerecord. Works independent from ContextSettings::antiAliasing.
+/// Fill and stroke are drawn with the bound paint (the color of the
+/// primitive is used with a pointColorPaint) and state, like polygons.
+class SdfShape : public DeviceObject {
+public:
+	SdfShape() = default;
+	SdfShape(Context&, const SdfPrimitive& = {}, bool deviceLocal = false);
+
+	auto change() { return StateChange {*this, primitive_}; }
+	const auto& primitive() const { return primitive_; }
+
+	/// Records the commands to fill or stroke this shape.
+	/// The Recorder overload skips binds of already bound state.
+	void fill(vk::CommandBuffer) const;
+	void fill(Recorder&) const;
+	void stroke(vk::CommandBuffer) const;
+	void stroke(Recorder&) const;
+
+	/// Cheap way to hide/unhide the fill or stroke, can be called at
+	/// any time and will never trigger a rerecord.
+	void disable(bool, DrawType = DrawType::strokeFill);
+	bool disabled(DrawType = DrawType::strokeFill) const;
+
+	/// Returns the bounds of the drawn area in local coordinates,
+	/// including stroke and anti aliasing. Disabled draws are not included.
+	Rect2f drawBounds() const;
+
+	void update();
+	bool updateDevice();
+
+protected:
+	void draw(Recorder&, std::uint32_t drawType) const;
+
+protected:
+	SdfPrimitive primitive_ {};
+	bool deviceLocal_ {};
+	bool disableFill_ {};
+	bool disableStroke_ {};
+	GeometryRange instance_;
+};
+
+} // namespace rvg
@@ -0,0 +1,91 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/deviceObject.hpp>
+#include <rvg/geometry.hpp>
+#include <rvg/sdf.hpp>
+
+#include <vector>
+
+namespace rvg {
+
+/// Many analytic shapes (see SdfPrimitive) drawn with a single instanced
+/// draw. All instances are stored in one InstanceBuffer, so adding,
+/// changing and disabling instances only uploads the changed range and
+/// does not trigger a rerecord, unless the buffer has to grow.
+/// Fill and stroke use the bound paint and state for all instances,
+/// their colors are used with a pointColorPaint.
+/// Instances are identified by their index.
+class ShapeBatch : public DeviceObject {
+public:
+	ShapeBatch() = default;
+	ShapeBatch(Context&, bool deviceLocal = false);
+
+	/// Appends the given instances, returns the index of the first one.
+	unsigned add(const SdfPrimitive&);
+	unsigned add(Span<const SdfPrimitive>);
+
+	/// Changes the instances starting at the given index.
+	/// Keeps their disable state.
+	void set(unsigned first, const SdfPrimitive&);
+	void set(unsigned first, Span<const SdfPrimitive>);
+
+	/// Changes the number of instances, new ones are empty.
+	void resize(unsigned count);
+	void clear() { resize(0u); }
+
+	/// Cheap way to hide/unhide the fill or stroke of an instance.
+	void disable(unsigned i, bool, DrawType = DrawType::strokeFill);
+	bool disabled(unsigned i, DrawType = DrawType::strokeFill) const;
+
+	SdfPrimitive primitive(unsigned i) const;
+	std::size_t size() const { return instances_.size(); }
+
+	/// Records the commands to fill or stroke all instances.
+	void fill(vk::CommandBuffer) const;
+	void fill(Recorder&) const;
+	void stroke(vk::CommandBuffer) const;
+	void stroke(Recorder&) const;
+
+	/// Returns the bounds of all drawn instances in local coordinates.
+	/// Linear in the number of instances.
+	Rect2f drawBounds() const;
+
+	bool updateDevice();
+
+protected:
+	void changed(unsigned first, unsigned count);
+	void draw(Recorder&, std::uint32_t drawType) const;
+
+protected:
+	std::vector<SdfInstance> instances_;
+	InstanceBuffer buffer_;
+};
+
+/// ShapeBatch of (rounded) rects.
+class RectBatch : public ShapeBatch {
+public:
+	using ShapeBatch::ShapeBatch;
+	using ShapeBatch::add;
+
+	unsigned add(Vec2f position, Vec2f size, Vec4u8 color,
+		float stroke = 0.f, const std::array<float, 4>& rounding = {});
+};
+
+/// ShapeBatch of circles or ellipses.
+class CircleBatch : public ShapeBatch {
+public:
+	using ShapeBatch::ShapeBatch;
+	using ShapeBatch::add;
+
+	unsigned add(Vec2f center, Vec2f radius, Vec4u8 color,
+		float stroke = 0.f);
+	unsigned add(Vec2f center, float radius, Vec4u8 color,
+		float stroke = 0.f);
+};
+
+} // namespace rvg
@@ -14,8 +14,22 @@
 #include <vpp/descriptor.hpp>
 #include <vpp/sharedBuffer.hpp>
 
+#include <array>
+#include <vector>
+
 namespace rvg {
 
+/// Appends the closed outline of a rect with the given corner rounding
+/// (topLeft, topRight, bottomRight, bottomLeft radius) to points as
+/// used by RectShape. Does not need a device.
+void rectOutline(std::vector<Vec2f>& points, Vec2f position, Vec2f size,
+	const std::array<float, 4>& rounding = {});
+
+/// Appends the closed outline of an ellipse with the given number of
+/// points to points as used by CircleShape. Does not need a device.
+void circleOutline(std::vector<Vec2f>& points, Vec2f center, Vec2f radius,
+	unsigned count, float startAngle = 0.f);
+
 /// Shape manually specified by its outlining points.
 /// Can only fill convex shapes correctly.
 class Shape {
@@ -28,6 +42,8 @@ public:
 
 	void fill(vk::CommandBuffer cb) const { polygon_.fill(cb); }
 	void stroke(vk::CommandBuffer cb) const { polygon_.stroke(cb); }
+	void fill(Recorder& rec) const { polygon_.fill(rec); }
+	void stroke(Recorder& rec) const { polygon_.stroke(rec); }
 
 	auto& context() const { return polygon_.context(); }
 	void disable(bool d, DrawType t = DrawType::strokeFill);
@@ -59,6 +75,8 @@ public:
 
 	void fill(vk::CommandBuffer cb) const { polygon_.fill(cb); }
 	void stroke(vk::CommandBuffer cb) const { polygon_.stroke(cb); }
+	void fill(Recorder& rec) const { polygon_.fill(rec); }
+	void stroke(Recorder& rec) const { polygon_.stroke(rec); }
 
 	auto& context() const { return polygon_.context(); }
 	void disable(bool d, DrawType t = DrawType::strokeFill);
@@ -101,6 +119,8 @@ public:
 
 	void fill(vk::CommandBuffer cb) const { polygon_.fill(cb); }
 	void stroke(vk::CommandBuffer cb) const { polygon_.stroke(cb); }
+	void fill(Recorder& rec) const { polygon_.fill(rec); }
+	void stroke(Recorder& rec) const { polygon_.stroke(rec); }
 
 	auto& context() const { return polygon_.context(); }
 	void disable(bool d, DrawType t = DrawType::strokeFill);
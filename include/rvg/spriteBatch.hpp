@@ -0,0 +1,115 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/deviceObject.hpp>
+#include <rvg/geometry.hpp>
+
+#include <nytl/vec.hpp>
+#include <nytl/rect.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace rvg {
+
+/// An image of a TextureAtlas drawn as (rotated) quad.
+struct Sprite {
+	/// The region of the image in the atlas in pixels, as returned
+	/// by TextureAtlas::add. Can also be a part of it.
+	Rect2f region {};
+
+	Vec2f position {}; // top left corner, before rotation
+	Vec2f size {}; // usually the size of the region
+	float rotation {}; // in radians, around the center
+
+	/// Multiplied with the atlas image when drawn with a pointColorPaint.
+	Vec4u8 tint {255u, 255u, 255u, 255u};
+};
+
+/// Returns the bounds of the rotated quad of the given sprite.
+Rect2f spriteBounds(const Sprite&);
+
+/// Instance data of a sprite as read by the sprite shaders,
+/// see fill.vert. Stored in vertex buffers with an instance input rate.
+struct SpriteInstance {
+	static constexpr auto flagDisabled = 1u;
+
+	Vec2f axisX; // the edge from the top left to the top right corner
+	Vec2f axisY; // the edge from the top left to the bottom left corner
+	Vec2f origin; // the top left corner
+	Vec4u8 tint;
+	std::uint32_t flags;
+	Vec2f regionPosition; // in atlas pixels
+	Vec2f regionSize;
+};
+
+static_assert(sizeof(SpriteInstance) == 48u);
+
+/// Returns the instance data of the given sprite.
+SpriteInstance spriteInstance(const Sprite&, bool disabled = false);
+
+/// Many images of one TextureAtlas drawn with a single instanced draw,
+/// e.g. the icons of a user interface. Like ShapeBatch, all instances
+/// are stored in one InstanceBuffer, so adding, changing, disabling and
+/// removing sprites only uploads the changed range and does not trigger
+/// a rerecord, unless the buffer or the atlas has to grow.
+/// Sprites are drawn with the bound paint, transform and scissor, their
+/// tints are used with a pointColorPaint. They are identified by their index.
+/// The atlas must stay valid as long as the batch is used.
+class SpriteBatch : public DeviceObject {
+public:
+	SpriteBatch() = default;
+	SpriteBatch(Context&, const TextureAtlas&, bool deviceLocal = false);
+
+	/// Appends the given sprites, returns the index of the first one.
+	unsigned add(const Sprite&);
+	unsigned add(Span<const Sprite>);
+
+	/// Changes the sprites starting at the given index.
+	/// Keeps their disable state.
+	void set(unsigned first, const Sprite&);
+	void set(unsigned first, Span<const Sprite>);
+
+	/// Removes the sprite with the given index. The last sprite is
+	/// moved into its place (and gets its index), the order in which
+	/// sprites are drawn changes therefore.
+	void remove(unsigned i);
+
+	/// Changes the number of sprites, new ones are empty.
+	void resize(unsigned count);
+	void clear() { resize(0u); }
+
+	/// Cheap way to hide/unhide a sprite.
+	void disable(unsigned i, bool);
+	bool disabled(unsigned i) const;
+
+	const Sprite& sprite(unsigned i) const;
+	std::size_t size() const { return sprites_.size(); }
+	const auto& atlas() const { return *atlas_; }
+
+	/// Records the commands to draw all sprites.
+	/// The Recorder overload skips binds of already bound state.
+	void draw(vk::CommandBuffer) const;
+	void draw(Recorder&) const;
+
+	/// Returns the bounds of all drawn sprites in local coordinates.
+	/// Linear in the number of sprites.
+	Rect2f drawBounds() const;
+
+	bool updateDevice();
+
+protected:
+	void changed(unsigned first, unsigned count);
+
+protected:
+	const TextureAtlas* atlas_ {};
+	std::vector<Sprite> sprites_;
+	std::vector<bool> disabled_;
+	InstanceBuffer buffer_;
+};
+
+} // namespace rvg
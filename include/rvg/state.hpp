@@ -7,6 +7,7 @@
 #include <rvg/fwd.hpp>
 #include <rvg/deviceObject.hpp>
 #include <rvg/stateChange.hpp>
+#include <rvg/bindless.hpp>
 
 #include <nytl/rect.hpp>
 #include <nytl/mat.hpp>
@@ -22,16 +23,23 @@ namespace rvg {
 /// stored on deviceLocal device memory - which is usually faster to use
 /// but more expensive to update - or otherwise on hostVisibile memory which
 /// should be used for frequently updating transforms.
+/// In bindless mode (see ContextSettings::bindless) the matrix is stored
+/// in a table of the Context instead and deviceLocal has no effect.
 class Transform : public DeviceObject {
 public:
 	Transform() = default;
 	Transform(Context& ctx, bool deviceLocal = true); // uses identity matrix
 	Transform(Context& ctx, const Mat4f&, bool deviceLocal = true);
+	~Transform();
+
+	Transform(Transform&&) noexcept = default;
+	Transform& operator=(Transform&&) noexcept;
 
 	/// Binds the transform in the given command buffer.
 	/// All following stroke/fill calls are affected by this transform object,
 	/// until another transform is bound.
 	void bind(vk::CommandBuffer) const;
+	void bind(Recorder&) const;
 
 	auto change() { return StateChange {*this, matrix_}; }
 	auto& matrix() const { return matrix_; }
@@ -39,6 +47,7 @@ public:
 
 	auto& ubo() const { return ubo_; }
 	auto& ds() const { return ds_; }
+	auto& bindlessSlot() const { return slot_; }
 
 	void update();
 	bool updateDevice();
@@ -47,6 +56,7 @@ protected:
 	Mat4f matrix_;
 	vpp::SubBuffer ubo_;
 	vpp::TrDs ds_;
+	BindlessSlot slot_;
 };
 
 /// Limits the area in which can be drawn.
@@ -55,6 +65,8 @@ protected:
 /// stored on deviceLocal device memory - which is usually faster to use
 /// but more expensive to update - or otherwise on hostVisibile memory which
 /// should be used for frequently updating transforms.
+/// In bindless mode (see ContextSettings::bindless) the rect is stored
+/// in a table of the Context instead and deviceLocal has no effect.
 class Scissor : public DeviceObject {
 public:
 	static constexpr Rect2f reset = {-1e6, -1e6, 2e6, 2e6};
@@ -62,11 +74,16 @@ public:
 public:
 	Scissor() = default;
 	Scissor(Context&, const Rect2f& = reset, bool deviceLocal = true);
+	~Scissor();
+
+	Scissor(Scissor&&) noexcept = default;
+	Scissor& operator=(Scissor&&) noexcept;
 
 	/// Binds the scissor in the given DrawInstance.
 	/// All following stroke/fill calls are affected by this scissor object,
 	/// until another scissor is bound.
 	void bind(vk::CommandBuffer) const;
+	void bind(Recorder&) const;
 
 	auto change() { return StateChange {*this, rect_}; }
 	void rect(const Rect2f& rect) { *change() = rect; }
@@ -74,6 +91,8 @@ public:
 
 	auto& ubo() const { return ubo_; }
 	auto& ds() const { return ds_; }
+	auto& bindlessSlot() const { return slot_; }
+
 	void update();
 	bool updateDevice();
 
@@ -81,6 +100,7 @@ protected:
 	Rect2f rect_ = reset;
 	vpp::SubBuffer ubo_;
 	vpp::TrDs ds_;
+	BindlessSlot slot_;
 };
 
 } // namespace rvg
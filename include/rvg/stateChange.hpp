@@ -32,6 +32,12 @@ namespace detail {
 /// redundant work.
 /// If you only want to change one parameter, you can still
 /// use it inline like this: ```rect.change()->position.x = 0.f```.
+///
+/// When the Context was created with ContextSettings::deferredUpdate,
+/// the update function only records the new state and marks the object
+/// for the next Context::updateDevice call, where the baking is done.
+/// Multiple (even separate) changes of an object in one frame then
+/// only bake it once.
 template<typename T, typename S>
 class StateChange {
 public:
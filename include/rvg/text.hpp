@@ -8,6 +8,7 @@
 #include <rvg/deviceObject.hpp>
 #include <rvg/font.hpp>
 #include <rvg/stateChange.hpp>
+#include <rvg/geometry.hpp>
 
 #include <nytl/vec.hpp>
 #include <nytl/rect.hpp>
@@ -15,11 +16,28 @@
 #include <vpp/descriptor.hpp>
 #include <vpp/sharedBuffer.hpp>
 
+#include <functional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace rvg {
 
+/// Lays out the given text with the given font of the fontstash context
+/// as Text does: appends the 6 triangle strip vertices of every glyph quad
+/// (positions and atlas uv coordinates) to the given vectors.
+/// Does not need a device. When a glyph doesn't fit into the atlas of
+/// the fontstash context, expand is called to make space and the glyph
+/// is tried again. Without expand, such glyphs are skipped.
+void layoutText(FONScontext&, int font, unsigned height, Vec2f position,
+	std::string_view text, std::vector<Vec2f>& positions,
+	std::vector<Vec2f>& uvs, const std::function<void()>& expand = {});
+
+/// Returns the bounds of the given text with the given font of the
+/// fontstash context as Font::bounds does. Does not need a device.
+Rect2f textBounds(FONScontext&, int font, unsigned height,
+	std::string_view text);
+
 /// Represents text to be drawn.
 /// Also offers some utility for bounds querying.
 class Text : public DeviceObject {
@@ -33,15 +51,17 @@ public:
 
 	/// Draws this text with the bound draw resources (transform,
 	/// scissor, paint).
+	/// The Recorder overload skips binds of already bound state.
 	void draw(vk::CommandBuffer) const;
+	void draw(Recorder&) const;
 
 	auto change() { return StateChange {*this, state_}; }
 	bool disable(bool);
 	bool disabled() const { return disable_; }
 
 	/// Changes the device local state for this text.
-	/// If unequal the previous value, will always recreate the buffer and
-	/// trigger a rerecord.
+	/// If unequal the previous value, will always move the geometry to
+	/// the other kind of memory and trigger a rerecord.
 	void deviceLocal(bool set);
 	bool deviceLocal() const { return deviceLocal_; }
 
@@ -56,6 +76,11 @@ public:
 	/// Must not be called during a state change.
 	Rect2f bounds() const;
 
+	/// Returns the bounds of the drawn glyph quads in local coordinates.
+	/// Empty if the text is disabled. With deferred updates, only
+	/// reflects the last change after the following updateDevice call.
+	Rect2f drawBounds() const;
+
 	/// Returns the bounds of the ith char in local coordinates.
 	/// Must not be called during a state change.
 	Rect2f ithBounds(unsigned n) const;
@@ -69,6 +94,16 @@ public:
 	void update();
 	bool updateDevice();
 
+	/// Usually only automatically called from context when needed.
+	/// Lays out the text if this was deferred in the last update (see
+	/// Context::deferredUpdates). Must not be called for multiple texts
+	/// using the same FontAtlas at the same time.
+	void updateHost();
+
+protected:
+	friend class FontAtlas;
+	void layout();
+
 protected:
 	struct State {
 		std::string text {};
@@ -82,9 +117,10 @@ protected:
 
 	std::vector<Vec2f> posCache_;
 	std::vector<Vec2f> uvCache_;
-	vpp::SubBuffer posBuf_;
-	vpp::SubBuffer uvBuf_;
+	GeometryRange cmd_; // indirect command, fixed place
+	VertexRange vertices_; // positions and uv coords
 	FontAtlas* oldAtlas_ {};
+	bool pendingLayout_ {};
 };
 
 } // namespace rvg
@@ -0,0 +1,74 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+#include <rvg/paint.hpp>
+#include <rvg/deviceObject.hpp>
+#include <rvg/bindless.hpp>
+
+#include <vpp/trackedDescriptor.hpp>
+#include <nytl/stringParam.hpp>
+#include <nytl/rect.hpp>
+
+#include <vector>
+
+namespace rvg {
+
+/// Rgba texture on the device into which many small images (e.g. icons)
+/// are packed, so they can all be drawn with one binding, see SpriteBatch.
+/// Images are packed into rows (shelves) and separated by a transparent
+/// pixel. When an image doesn't fit, the atlas doubles its size (which
+/// triggers a rerecord), the regions of added images stay valid.
+/// Otherwise only the region covering the images added since the last
+/// update is uploaded.
+/// Images cannot be removed again, only the whole atlas can be destroyed.
+class TextureAtlas : public DeviceObject, public nytl::NonMovable {
+public:
+	/// The atlas starts with the given size and never grows beyond maxSize
+	/// in any dimension.
+	TextureAtlas(Context&, Vec2ui size = {256u, 256u},
+		unsigned maxSize = 4096u);
+
+	/// Packs the given image into the atlas and returns its region in
+	/// pixels. data must reference size.x * size.y * 4 bytes of rgba data.
+	/// Throws std::runtime_error if it doesn't fit, even at maxSize.
+	Rect2f add(Vec2ui size, nytl::Span<const std::byte> data);
+
+	/// Loads the image from the given file and adds it.
+	/// Throws std::runtime_error if the file cannot be loaded.
+	Rect2f add(nytl::StringParam filename);
+
+	const auto& size() const { return size_; }
+	auto& ds() const { return ds_; }
+	auto& texture() const { return texture_; }
+	auto& bindlessSlot() const { return texSlot_; } // only in bindless mode
+
+	bool updateDevice();
+
+protected:
+	struct Shelf {
+		unsigned y;
+		unsigned height;
+		unsigned width; // used width
+	};
+
+	bool pack(Vec2ui size, Vec2ui& pos);
+	void grow();
+
+protected:
+	Vec2ui size_ {};
+	unsigned maxSize_ {};
+	std::vector<std::byte> data_; // rgba, size_.x * size_.y * 4
+	std::vector<Shelf> shelves_;
+	Vec2ui dirtyMin_ {}; // region changed since the last update
+	Vec2ui dirtyMax_ {}; // empty if not larger than dirtyMin_
+
+	vpp::TrDs ds_;
+	Texture texture_;
+	BindlessSlot texSlot_;
+};
+
+} // namespace rvg
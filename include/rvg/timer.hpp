@@ -0,0 +1,154 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <rvg/fwd.hpp>
+
+#include <vpp/commandBuffer.hpp>
+#include <vpp/sharedBuffer.hpp>
+#include <nytl/nonCopyable.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rvg {
+
+/// The kind of work a draw does, used for gpu timing.
+enum class DrawCategory : std::uint8_t {
+	fill, // polygon fills without anti aliasing
+	aaFill, // anti aliased polygon fills, including their fringe
+	stroke, // polygon strokes, with or without anti aliasing
+	text,
+	upload, // the staged copies of Context::stageUpload
+	none, // no draw (e.g. only state binds) or mixed
+};
+
+constexpr auto drawCategoryCount = 5u; // without none
+
+/// Measures the gpu time of recorded groups of draw calls (scopes) and
+/// of the draw categories inside them with timestamp queries.
+/// Scopes are recorded with the Scope guard into the normal command
+/// buffers. Their queries are read back by a copy in the following
+/// stageUpload call and resolved on the host when that copy has completed,
+/// i.e. results never stall and lag framesInFlight + 1 frames behind.
+/// Every recorded scope must be executed at most once between two
+/// stageUpload calls and scopes can't be nested. The results of the
+/// frame before a scope was (re)recorded are dropped.
+/// Since the gpu overlaps subsequent draws, the category times are the
+/// durations between the completion of draws and therefore approximate.
+/// Categories are only tracked for draws recorded through the Recorder
+/// of the scope. Draws recorded with the vk::CommandBuffer overloads
+/// inside a scope are part of its duration but counted for the category
+/// of the previous draw on the Recorder.
+/// Only created with ContextSettings::gpuTiming.
+class GpuTimer : public nytl::NonMovable {
+public:
+	/// Number of timestamps available per scope. When a scope switches
+	/// categories more often, its remaining draws count as none.
+	static constexpr auto queriesPerScope = 64u;
+	static constexpr auto noScope = ~0u;
+
+	/// Records timestamps at its construction and destruction.
+	/// Does nothing if the Context has no GpuTimer.
+	class Scope : public nytl::NonMovable {
+	public:
+		Scope(Recorder&, std::string_view name);
+		~Scope();
+
+	protected:
+		Recorder& recorder_;
+	};
+
+	struct ScopeTime {
+		std::string name;
+		double ns; // whole duration of the scope
+		std::array<double, drawCategoryCount> categories; // ns
+	};
+
+	/// The times of one rendered frame.
+	struct FrameTimes {
+		/// Number of the stageUpload call after which the frame was
+		/// rendered, 0 if there are no results yet.
+		std::uint64_t frame {};
+
+		/// All scopes executed in the frame.
+		std::vector<ScopeTime> scopes;
+
+		/// Sums of all scopes, the upload time of the frame
+		/// (not available with a dedicated transfer queue).
+		std::array<double, drawCategoryCount> categories {};
+	};
+
+public:
+	GpuTimer(Context&);
+	~GpuTimer();
+
+	/// The times of the last frame with resolved results.
+	const FrameTimes& times() const { return times_; }
+
+	/// Whether the queue supports timestamps. Otherwise no
+	/// timestamps are recorded and there are no results.
+	bool supported() const { return bool(pool_); }
+
+	Context& context() const { return *context_; }
+
+	// - internal, called by Recorder and Context -
+	unsigned beginScope(Recorder&, std::string_view name);
+	void endScope(Recorder&, unsigned scope);
+	void categoryChanged(Recorder&, unsigned scope);
+
+	/// Resolves completed results and reads back the queries of the
+	/// frame rendered since the last call. Called by stageUpload.
+	void frame();
+
+	/// Writes the timestamps around the upload commands.
+	void beginUpload(vk::CommandBuffer);
+	void endUpload(vk::CommandBuffer);
+
+protected:
+	static constexpr auto uploadQueries = 2u;
+
+	struct ScopeEntry {
+		std::string name;
+		unsigned first {}; // first query
+		unsigned used {}; // number of written queries
+		DrawCategory current {DrawCategory::none};
+		std::vector<DrawCategory> intervals; // between queries i and i + 1
+		bool recorded {}; // since the last read back
+	};
+
+	// a read back of all queries, the scopes as of the copy
+	struct Readback {
+		vpp::CommandBuffer cmdBuf;
+		vpp::SubBuffer buffer;
+		std::uint64_t submission {};
+		std::uint64_t frame {};
+		bool upload {};
+		std::vector<ScopeEntry> scopes;
+	};
+
+	void resolve(Readback&);
+	void write(vk::CommandBuffer, unsigned query);
+
+protected:
+	Context* context_ {};
+	vk::QueryPool pool_ {};
+	unsigned queryCount_ {};
+	std::uint64_t validMask_ {};
+	float period_ {}; // ns per tick
+
+	std::vector<ScopeEntry> scopes_;
+	std::vector<Readback> readbacks_; // ring of framesInFlight + 1
+	unsigned readback_ {};
+	std::uint64_t frame_ {};
+	bool upload_ {}; // whether upload timestamps were written
+
+	FrameTimes times_;
+};
+
+} // namespace rvg
@@ -0,0 +1,33 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+namespace rvg {
+
+/// Whether rvg was built with the 'trace' meson option, i.e. whether
+/// the trace events are compiled in. Otherwise startTrace always fails
+/// and the (disabled) trace points have no cost at all.
+bool traceAvailable();
+
+/// Starts writing cpu trace events of the expensive rvg operations to
+/// the given file, in the chrome trace event json format that can be
+/// loaded by chrome://tracing and the perfetto ui.
+/// Traced are Polygon::update, Text::update, FontAtlas::expand,
+/// FontAtlas::updateDevice, Context::updateDevice, Context::stageUpload
+/// and the upload of every device object buffer. Every event has the type
+/// of its object, the number of bytes written into mapped buffers or
+/// copied into staging memory during it (i.e. the uploaded bytes as
+/// counted by the FrameStats, including nested events on the same
+/// thread) and whether it caused a rerecord as arguments.
+/// Ends a previously started trace. Returns false if tracing is not
+/// available or the file could not be opened. Threadsafe.
+bool startTrace(const char* file);
+
+/// Ends the current trace and closes its file, if there is one.
+/// The file is only complete (valid json) after this was called.
+/// Threadsafe.
+void stopTrace();
+
+} // namespace rvg
@@ -0,0 +1,135 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/bindless.hpp>
+#include <rvg/context.hpp>
+#include <rvg/util.hpp>
+#include <vpp/vk.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace rvg {
+
+// BindlessBuffer
+BindlessBuffer::BindlessBuffer(Context& ctx, vk::DeviceSize entrySize) :
+	DeviceObject(ctx), entrySize_(entrySize) {
+}
+
+BindlessSlot BindlessBuffer::allocate() {
+	std::uint32_t slot;
+	if(!free_.empty()) {
+		slot = free_.back();
+		free_.pop_back();
+	} else {
+		slot = std::uint32_t(data_.size() / entrySize_);
+		data_.resize(data_.size() + entrySize_);
+		isDirty_.push_back(false);
+	}
+
+	return {*this, slot};
+}
+
+void BindlessBuffer::release(std::uint32_t slot) {
+	dlg_assert(slot < isDirty_.size());
+	free_.push_back(slot);
+}
+
+std::byte* BindlessBuffer::write(std::uint32_t slot) {
+	dlg_assert(slot < isDirty_.size());
+	if(!isDirty_[slot]) {
+		isDirty_[slot] = true;
+		dirty_.push_back(slot);
+	}
+
+	return data_.data() + slot * entrySize_;
+}
+
+bool BindlessBuffer::updateDevice() {
+	auto rerecord = false;
+	auto needed = std::max<vk::DeviceSize>(data_.size(), entrySize_);
+	if(buffer_.size() < needed) {
+		// the old buffer might still be read by pending frames.
+		// Everything is uploaded to the new one below
+		auto& dev = context().device();
+		auto align = dev.properties().limits.minStorageBufferOffsetAlignment;
+		auto usage = vk::BufferUsageBits::storageBuffer |
+			vk::BufferUsageBits::transferDst;
+		context().keepAlive(std::move(buffer_));
+		buffer_ = {context().bufferAllocator(), 2 * needed, usage,
+			unsigned(align), dev.deviceMemoryTypes()};
+		context().rerecordCause(*this, "BindlessBuffer: buffer grew");
+		rerecord = true;
+
+		dirty_.clear();
+		for(auto i = 0u; i < isDirty_.size(); ++i) {
+			isDirty_[i] = true;
+			dirty_.push_back(i);
+		}
+	}
+
+	// upload contiguous ranges of written entries
+	std::sort(dirty_.begin(), dirty_.end());
+	for(auto it = dirty_.begin(); it != dirty_.end();) {
+		auto first = *it;
+		auto last = first;
+		for(; it != dirty_.end() && *it == last; ++it, ++last) {
+			isDirty_[*it] = false;
+		}
+
+		auto off = first * entrySize_;
+		auto size = (last - first) * entrySize_;
+		auto span = vpp::BufferSpan(buffer_.buffer(),
+			{buffer_.offset() + off, size});
+		upload140(*this, span, raw(*(data_.data() + off), size));
+	}
+
+	dirty_.clear();
+	return rerecord;
+}
+
+// BindlessTextures
+BindlessTextures::BindlessTextures(unsigned count, vk::ImageView empty) :
+		empty_(empty), views_(count, empty), refs_(count, 0u) {
+	dlg_assert(count > 0);
+	refs_[0] = 1u; // the empty image, never released
+}
+
+BindlessSlot BindlessTextures::allocate(vk::ImageView view) {
+	auto it = std::find(views_.begin(), views_.end(), view);
+	if(it != views_.end() && (view == empty_ || refs_[it - views_.begin()])) {
+		auto slot = std::uint32_t(it - views_.begin());
+		++refs_[slot];
+		return {*this, slot};
+	}
+
+	auto free = std::find(refs_.begin(), refs_.end(), 0u);
+	if(free == refs_.end()) {
+		throw std::runtime_error("rvg: bindless texture table is full, "
+			"see ContextSettings::bindlessTextures");
+	}
+
+	auto slot = std::uint32_t(free - refs_.begin());
+	refs_[slot] = 1u;
+	views_[slot] = view;
+	dirty_ = true;
+	return {*this, slot};
+}
+
+void BindlessTextures::release(std::uint32_t slot) {
+	dlg_assert(slot < refs_.size() && refs_[slot] > 0);
+	if(--refs_[slot] == 0) {
+		// the view might get destroyed
+		views_[slot] = empty_;
+		dirty_ = true;
+	}
+}
+
+bool BindlessTextures::updateDevice() {
+	auto ret = dirty_;
+	dirty_ = false;
+	return ret;
+}
+
+} // namespace rvg
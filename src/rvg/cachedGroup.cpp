@@ -0,0 +1,172 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/cachedGroup.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <vpp/vk.hpp>
+#include <vpp/formats.hpp>
+#include <dlg/dlg.hpp>
+#include <array>
+
+namespace rvg {
+namespace {
+
+vpp::RenderPass createRenderPass(const vpp::Device& dev, vk::Format format) {
+	vk::AttachmentDescription attachment;
+	attachment.format = format;
+	attachment.samples = vk::SampleCountBits::e1;
+	attachment.loadOp = vk::AttachmentLoadOp::clear;
+	attachment.storeOp = vk::AttachmentStoreOp::store;
+	attachment.stencilLoadOp = vk::AttachmentLoadOp::dontCare;
+	attachment.stencilStoreOp = vk::AttachmentStoreOp::dontCare;
+	attachment.initialLayout = vk::ImageLayout::undefined;
+	attachment.finalLayout = vk::ImageLayout::shaderReadOnlyOptimal;
+
+	vk::AttachmentReference colorReference;
+	colorReference.attachment = 0;
+	colorReference.layout = vk::ImageLayout::colorAttachmentOptimal;
+
+	vk::SubpassDescription subpass;
+	subpass.pipelineBindPoint = vk::PipelineBindPoint::graphics;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorReference;
+
+	// pending frames might still sample the image (write-after-read),
+	// the frames after this one sample it
+	std::array<vk::SubpassDependency, 2> dependencies;
+	dependencies[0].srcSubpass = vk::subpassExternal;
+	dependencies[0].dstSubpass = 0u;
+	dependencies[0].srcStageMask = vk::PipelineStageBits::fragmentShader;
+	dependencies[0].dstStageMask =
+		vk::PipelineStageBits::colorAttachmentOutput;
+	dependencies[0].dstAccessMask = vk::AccessBits::colorAttachmentWrite;
+
+	dependencies[1].srcSubpass = 0u;
+	dependencies[1].dstSubpass = vk::subpassExternal;
+	dependencies[1].srcStageMask =
+		vk::PipelineStageBits::colorAttachmentOutput;
+	dependencies[1].srcAccessMask = vk::AccessBits::colorAttachmentWrite;
+	dependencies[1].dstStageMask = vk::PipelineStageBits::fragmentShader;
+	dependencies[1].dstAccessMask = vk::AccessBits::shaderRead;
+
+	vk::RenderPassCreateInfo info;
+	info.attachmentCount = 1;
+	info.pAttachments = &attachment;
+	info.subpassCount = 1;
+	info.pSubpasses = &subpass;
+	info.dependencyCount = dependencies.size();
+	info.pDependencies = dependencies.data();
+
+	return {dev, info};
+}
+
+} // anon namespace
+
+CachedGroup::CachedGroup(Context& ctx, const Rect2f& area, Vec2ui size,
+		vk::Format format, Layer::Recording recording) :
+			context_(&ctx), area_(area), size_(size),
+			recording_(std::move(recording)),
+			rp_(createRenderPass(ctx.device(), format)),
+			layer_(ctx, [this](Recorder& rec) { record(rec); }, rp_, 0u) {
+
+	dlg_assert(recording_);
+	dlg_assert(size.x > 0 && size.y > 0);
+	dlg_assert(area.size.x > 0.f && area.size.y > 0.f);
+	auto samples = ctx.settings().samples;
+	dlg_assertm(samples == vk::SampleCountBits {} ||
+		samples == vk::SampleCountBits::e1,
+		"CachedGroup doesn't support multisampling");
+
+	auto& dev = ctx.device();
+	auto usage = vk::ImageUsageBits::colorAttachment |
+		vk::ImageUsageBits::sampled;
+	auto extent = vk::Extent3D {size.x, size.y, 1u};
+	auto info = vpp::ViewableImageCreateInfo::color(dev, extent, usage,
+		{format}).value();
+	auto memBits = dev.memoryTypeBits(vk::MemoryPropertyBits::deviceLocal);
+	image_ = {dev, info, memBits};
+
+	vk::FramebufferCreateInfo fbInfo;
+	fbInfo.renderPass = rp_;
+	fbInfo.attachmentCount = 1;
+	fbInfo.pAttachments = &image_.vkImageView();
+	fbInfo.width = size.x;
+	fbInfo.height = size.y;
+	fbInfo.layers = 1u;
+	fb_ = {dev, fbInfo};
+
+	// maps the area to normalized device coordinates
+	auto pos = area.position;
+	auto ext = area.size;
+	auto mat = identity<4, float>();
+	mat[0][0] = 2.f / ext.x;
+	mat[1][1] = 2.f / ext.y;
+	mat[0][3] = -1.f - 2.f * pos.x / ext.x;
+	mat[1][3] = -1.f - 2.f * pos.y / ext.y;
+	transform_ = {ctx, mat};
+
+	// maps the area to texture coordinates
+	mat = identity<4, float>();
+	mat[0][0] = 1.f / ext.x;
+	mat[1][1] = 1.f / ext.y;
+	mat[0][3] = -pos.x / ext.x;
+	mat[1][3] = -pos.y / ext.y;
+	paint_ = {ctx, texturePaintRGBA(mat, image_.vkImageView())};
+	rect_ = {ctx, pos, ext, {true, 0.f}};
+
+	ctx.addCachedGroup(*this);
+}
+
+CachedGroup::~CachedGroup() {
+	context().removeCachedGroup(*this);
+}
+
+void CachedGroup::record(Recorder& rec) {
+	// the draws don't end up in the output directly, the damage
+	// of the composited rect is added when the group is rendered
+	rec.trackDamage(false);
+
+	auto cb = rec.cmdBuf();
+	vk::Viewport vp {0.f, 0.f, float(size_.x), float(size_.y), 0.f, 1.f};
+	vk::cmdSetViewport(cb, 0, 1, vp);
+	vk::cmdSetScissor(cb, 0, 1, {0, 0, size_.x, size_.y});
+
+	transform_.bind(rec);
+	recording_(rec);
+}
+
+bool CachedGroup::needsRender() const {
+	return !rendered_ || layer_.invalid() || layer_.changed();
+}
+
+void CachedGroup::render(vk::CommandBuffer cb) {
+	layer_.record();
+	layer_.clearChanged();
+
+	auto clearValue = vk::ClearValue {{0.f, 0.f, 0.f, 0.f}};
+	vk::cmdBeginRenderPass(cb, {
+		rp_,
+		fb_,
+		{0u, 0u, size_.x, size_.y},
+		1,
+		&clearValue
+	}, vk::SubpassContents::secondaryCommandBuffers);
+
+	layer_.execute(cb);
+	vk::cmdEndRenderPass(cb);
+	rendered_ = true;
+}
+
+void CachedGroup::draw(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	draw(rec);
+}
+
+void CachedGroup::draw(Recorder& rec) const {
+	paint_.bind(rec);
+	rect_.fill(rec);
+}
+
+} // namespace rvg
@@ -6,11 +6,25 @@
 #include <rvg/font.hpp>
 #include <rvg/text.hpp>
 #include <rvg/polygon.hpp>
+#include <rvg/drawBatch.hpp>
 #include <rvg/shapes.hpp>
+#include <rvg/sdf.hpp>
+#include <rvg/shapeBatch.hpp>
+#include <rvg/textureAtlas.hpp>
+#include <rvg/spriteBatch.hpp>
 #include <rvg/state.hpp>
 #include <rvg/stateChange.hpp>
 #include <rvg/deviceObject.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/bindless.hpp>
+#include <rvg/geometry.hpp>
+#include <rvg/layer.hpp>
+#include <rvg/cachedGroup.hpp>
+#include <rvg/damage.hpp>
+#include <rvg/timer.hpp>
 #include <rvg/util.hpp>
+#include <rvg/tracing.hpp>
+#include <rvg/threadPool.hpp>
 
 #include <katachi/path.hpp>
 #include <katachi/curves.hpp>
@@ -21,7 +35,11 @@
 #include <dlg/dlg.hpp>
 #include <nytl/matOps.hpp>
 #include <nytl/vecOps.hpp>
+#include <cstddef>
 #include <cstring>
+#include <map>
+#include <unordered_map>
+#include <tuple>
 
 #include <shaders/fill.vert.frag_scissor.h>
 #include <shaders/fill.frag.frag_scissor.h>
@@ -29,6 +47,30 @@
 #include <shaders/fill.frag.plane_scissor.h>
 #include <shaders/fill.frag.frag_scissor.edge_aa.h>
 #include <shaders/fill.frag.plane_scissor.edge_aa.h>
+#include <shaders/fill.vert.frag_scissor.bindless.h>
+#include <shaders/fill.frag.frag_scissor.bindless.h>
+#include <shaders/fill.vert.plane_scissor.bindless.h>
+#include <shaders/fill.frag.plane_scissor.bindless.h>
+#include <shaders/fill.frag.frag_scissor.edge_aa.bindless.h>
+#include <shaders/fill.frag.plane_scissor.edge_aa.bindless.h>
+
+#include <shaders/sdf.vert.frag_scissor.h>
+#include <shaders/sdf.frag.frag_scissor.h>
+#include <shaders/sdf.vert.plane_scissor.h>
+#include <shaders/sdf.frag.plane_scissor.h>
+#include <shaders/sdf.vert.frag_scissor.bindless.h>
+#include <shaders/sdf.frag.frag_scissor.bindless.h>
+#include <shaders/sdf.vert.plane_scissor.bindless.h>
+#include <shaders/sdf.frag.plane_scissor.bindless.h>
+
+#include <shaders/sprite.vert.frag_scissor.h>
+#include <shaders/sprite.frag.frag_scissor.h>
+#include <shaders/sprite.vert.plane_scissor.h>
+#include <shaders/sprite.frag.plane_scissor.h>
+#include <shaders/sprite.vert.frag_scissor.bindless.h>
+#include <shaders/sprite.frag.frag_scissor.bindless.h>
+#include <shaders/sprite.vert.plane_scissor.bindless.h>
+#include <shaders/sprite.frag.plane_scissor.bindless.h>
 
 namespace rvg {
 
@@ -85,60 +127,522 @@ Context::Context(vpp::Device& dev, const ContextSettings& settings) :
 		vpp::descriptorBinding(vk::DescriptorType::uniformBuffer, scissorStage),
 	};
 
-	dsLayoutTransform_ = {dev, transformDSB};
-	dsLayoutPaint_ = {dev, paintDSB};
-	dsLayoutFontAtlas_ = {dev, fontAtlasDSB};
-	dsLayoutScissor_ = {dev, scissorDSB};
-	std::vector<vk::DescriptorSetLayout> layouts = {
-		dsLayoutTransform_,
-		dsLayoutPaint_,
-		dsLayoutFontAtlas_,
-		dsLayoutScissor_
-	};
+	if(settings.bindless) {
+		// all state in one set, see bindless.glsl
+		dlg_assertm(settings.bindlessTextures > 0,
+			"ContextSettings::bindlessTextures must not be 0");
+		auto vertFrag = vk::ShaderStageBits::vertex |
+			vk::ShaderStageBits::fragment;
+		std::vector<vk::Sampler> samplers(settings.bindlessTextures,
+			texSampler_.vkHandle());
+		auto bindlessDSB = {
+			vpp::descriptorBinding(vk::DescriptorType::storageBuffer,
+				vk::ShaderStageBits::vertex),
+			vpp::descriptorBinding(vk::DescriptorType::storageBuffer,
+				vertFrag),
+			vpp::descriptorBinding(vk::DescriptorType::storageBuffer,
+				scissorStage),
+			vpp::descriptorBinding(vk::DescriptorType::combinedImageSampler,
+				vk::ShaderStageBits::fragment, -1, settings.bindlessTextures,
+				samplers.data()),
+		};
 
-	if(settings.antiAliasing) {
-		auto aaStrokeDSB = {
-			vpp::descriptorBinding(vk::DescriptorType::uniformBuffer,
-				vk::ShaderStageBits::fragment),
+		dsLayoutBindless_ = {dev, bindlessDSB};
+		std::vector<vk::DescriptorSetLayout> layouts = {dsLayoutBindless_};
+		pipeLayout_ = {dev, layouts, {
+			{vertFrag, 0, 4 * pushSlotCount}
+		}};
+	} else {
+		dsLayoutTransform_ = {dev, transformDSB};
+		dsLayoutPaint_ = {dev, paintDSB};
+		dsLayoutFontAtlas_ = {dev, fontAtlasDSB};
+		dsLayoutScissor_ = {dev, scissorDSB};
+		std::vector<vk::DescriptorSetLayout> layouts = {
+			dsLayoutTransform_,
+			dsLayoutPaint_,
+			dsLayoutFontAtlas_,
+			dsLayoutScissor_
 		};
 
-		dsLayoutStrokeAA_ = {dev, aaStrokeDSB};
-		layouts.push_back(dsLayoutStrokeAA_);
+		if(settings.antiAliasing) {
+			auto aaStrokeDSB = {
+				vpp::descriptorBinding(vk::DescriptorType::uniformBuffer,
+					vk::ShaderStageBits::fragment),
+			};
+
+			dsLayoutStrokeAA_ = {dev, aaStrokeDSB};
+			layouts.push_back(dsLayoutStrokeAA_);
+		}
+
+		// the type is also read by the sdf vertex shader
+		pipeLayout_ = {dev, layouts, {
+			{vk::ShaderStageBits::vertex | vk::ShaderStageBits::fragment, 0, 4}
+		}};
 	}
 
-	pipeLayout_ = {dev, layouts, {
-		{vk::ShaderStageBits::fragment, 0, 4}
-	}};
+	// pipelines and their shaders are created on first use, see pipeline
+	if(!settings.pipelineCache && !settings.pipelineCacheFile.empty()) {
+		pipelineCache_ = {dev, settings.pipelineCacheFile};
+	}
 
-	// pipeline
-	using ShaderData = nytl::Span<const std::uint32_t>;
-	auto vertData = ShaderData(fill_vert_frag_scissor_data);
-	auto fragData = ShaderData(fill_frag_frag_scissor_data);
+	// sync stuff
+	dlg_assertm(settings.framesInFlight > 0,
+		"ContextSettings::framesInFlight must not be 0");
+	auto family = device().queueSubmitter().queue().family();
+	auto tq = settings.transferQueue;
+	if(tq && tq->family() != family) {
+		transferSubmitter_.emplace(*tq);
+	}
 
-	if(clipDistance) {
-		vertData = fill_vert_plane_scissor_data;
-		if(settings.antiAliasing) {
-			fragData = fill_frag_plane_scissor_edge_aa_data;
-		} else {
-			fragData = fill_frag_plane_scissor_data;
+	frames_.resize(settings.framesInFlight + 1);
+	for(auto& frame : frames_) {
+		auto& cmdAlloc = device().commandAllocator();
+		auto flags = vk::CommandPoolCreateBits::resetCommandBuffer;
+		frame.semaphore = {device()};
+		frame.cmdBuf = cmdAlloc.get(family, flags);
+
+		if(transferSubmitter_) {
+			frame.releaseSemaphore = {device()};
+			frame.releaseCmdBuf = cmdAlloc.get(family, flags);
+			frame.transferSemaphore = {device()};
+			frame.transferCmdBuf = cmdAlloc.get(tq->family(), flags);
 		}
+	}
+
+	if(settings.updateThreads) {
+		threadPool_ = std::make_unique<ThreadPool>(settings.updateThreads);
+	}
+
+	// dummies
+	constexpr std::uint8_t bytes[] = {0xFF, 0xFF, 0xFF, 0xFF};
+	emptyImage_ = {*this, {1u, 1u},
+		{*reinterpret_cast<const std::byte*>(bytes), 4u},
+		TextureType::rgba32};
+
+	if(settings.bindless) {
+		constexpr auto paintEntrySize = sizeof(nytl::Mat4f) +
+			sizeof(Vec4f) * 4; // std430 stride, see bindless.glsl
+		bindlessTransforms_ = std::make_unique<BindlessBuffer>(*this,
+			sizeof(nytl::Mat4f));
+		bindlessScissors_ = std::make_unique<BindlessBuffer>(*this,
+			sizeof(Vec4f));
+		bindlessPaints_ = std::make_unique<BindlessBuffer>(*this,
+			paintEntrySize);
+		bindlessTextures_ = std::make_unique<BindlessTextures>(
+			settings.bindlessTextures, emptyImage_.vkImageView());
+	} else {
+		dummyTex_ = {dsAllocator(), dsLayoutFontAtlas_};
+		vpp::DescriptorSetUpdate update(dummyTex_);
+		auto layout = vk::ImageLayout::shaderReadOnlyOptimal;
+		update.imageSampler({{{}, emptyImage_.vkImageView(), layout}});
+	}
+
+	geometryArena_ = std::make_unique<GeometryArena>(*this);
+	if(settings.damageTracking) {
+		damage_ = std::make_unique<DamageTracker>(*this);
+	}
+
+	if(settings.gpuTiming) {
+		gpuTimer_ = std::make_unique<GpuTimer>(*this);
+	}
+
+	identityTransform_ = {*this};
+	pointColorPaint_ = {*this, ::rvg::pointColorPaint()};
+	defaultScissor_ = {*this, Scissor::reset};
+
+	if(settings.bindless) {
+		updateBindless();
 	} else if(settings.antiAliasing) {
-		fragData = fill_frag_frag_scissor_edge_aa_data;
+		defaultStrokeAABuf_ = {bufferAllocator(), 12 * sizeof(float),
+			vk::BufferUsageBits::uniformBuffer, 0u, device().hostMemoryTypes()};
+		auto map = defaultStrokeAABuf_.memoryMap();
+		auto ptr = map.ptr();
+		write(ptr, 1.f);
+
+		defaultStrokeAA_ = {dsAllocator(), dsLayoutStrokeAA_};
+		auto& b = defaultStrokeAABuf_;
+		vpp::DescriptorSetUpdate update(defaultStrokeAA_);
+		update.uniform({{b.buffer(), b.offset(), sizeof(float)}});
 	}
+}
 
-	auto fillVertex = vpp::ShaderModule(dev, vertData);
-	auto fillFragment = vpp::ShaderModule(dev, fragData);
+vpp::DescriptorAllocator& Context::dsAllocator() const {
+	return device().descriptorAllocator();
+}
 
-	auto samples = settings.samples == vk::SampleCountBits {} ?
-		vk::SampleCountBits::e1 : settings.samples;
-	vpp::GraphicsPipelineInfo fanPipeInfo(settings.renderPass,
-		pipeLayout_, {{
-			{fillVertex, vk::ShaderStageBits::vertex},
-			{fillFragment, vk::ShaderStageBits::fragment}
-		}}, settings.subpass, samples);
+vpp::BufferAllocator& Context::bufferAllocator() const {
+	return device().bufferAllocator();
+}
+
+void Context::bindDefaults(vk::CommandBuffer cmdb) {
+	Recorder rec(*this, cmdb);
+	bindDefaults(rec);
+}
+
+void Context::bindDefaults(Recorder& rec) {
+	if(bindless()) {
+		rec.bindDescriptorSet(bindlessBindSet, bindlessDs_);
+		identityTransform_.bind(rec);
+		defaultScissor_.bind(rec);
+		rec.push(fontPushSlot, 0u); // empty image
+		rec.push(strokeMultPushSlot, 1.f);
+		return;
+	}
 
+	identityTransform_.bind(rec);
+	defaultScissor_.bind(rec);
+	rec.bindDescriptorSet(fontBindSet, dummyTex_);
+
+	if(settings().antiAliasing) {
+		rec.bindDescriptorSet(aaStrokeBindSet, defaultStrokeAA_);
+	}
+}
+
+Context::~Context() {
+	if(!savePipelineCache()) {
+		dlg_warn("Could not save the pipeline cache to '{}'",
+			settings().pipelineCacheFile);
+	}
 
-	fanPipeInfo.flags(vk::PipelineCreateBits::allowDerivatives);
+	// the bindless tables are destroyed before the frames
+	for(auto& frame : frames_) {
+		frame.slots.clear();
+	}
+}
+
+bool Context::updateDevice() {
+	RVG_TRACE_EVENT("Context::updateDevice", "Context");
+	if(damage_) {
+		damage_->reset();
+	}
+
+	if(threadPool_) {
+		updateHostParallel();
+	}
+
+	// Iterate by index since objects might register (other) objects
+	// in their updateDevice. An object is unregistered before its
+	// updateDevice call so that it can be registered again
+	// afterwards in this loop (e.g. a DrawBatch by its polygons).
+	auto visitor = [&](auto* obj) {
+		if(!obj) {
+			return false;
+		}
+
+		static_cast<DeviceObject*>(obj)->updateSlot_ = DeviceObject::noSlot;
+		auto ret = obj->updateDevice();
+		if(damage_) {
+			damage_->updated(*obj);
+		}
+
+		// the device data of layers using it changed
+		std::lock_guard lock(layerMutex_);
+		auto it = layerRefs_.find(obj);
+		if(it != layerRefs_.end()) {
+			for(auto* layer : it->second) {
+				layer->changed_ = true;
+			}
+		}
+
+		return ret;
+	};
+
+	for(auto i = 0u; i < updateDevice_.size(); ++i) {
+		auto ud = updateDevice_[i];
+		updateDevice_[i] = {};
+		auto* obj = std::visit([](auto* o) -> DeviceObject* {
+			return o;
+		}, ud);
+		if(!obj) {
+			continue;
+		}
+
+		++stats_.updated[ud.index()];
+		auto causes = rerecordCauses();
+		if(std::visit(visitor, ud)) {
+			if(rerecordCauses() == causes) {
+				rerecordCause(*obj, "updateDevice");
+			}
+
+			invalidate(obj);
+		}
+	}
+
+	updateDevice_.clear();
+	geometryArena_->trim();
+	if(bindless()) {
+		auto causes = rerecordCauses();
+		if(updateBindless()) {
+			if(rerecordCauses() == causes) {
+				std::lock_guard lock(statsMutex_);
+				stats_.rerecords.push_back({nullptr,
+					"BindlessTextures: slots changed"});
+			}
+
+			invalidate(nullptr);
+		}
+	}
+
+	auto ret = rerecord_.exchange(false);
+	RVG_TRACE_RERECORD(ret);
+
+	std::lock_guard lock(statsMutex_);
+	stats_.tessellations = tessellations_.exchange(0u);
+	stats_.bytesWritten = bytesWritten_.exchange(0u);
+	stats_.bytesStaged = bytesStaged_.exchange(0u);
+	lastStats_ = std::move(stats_);
+	stats_ = {};
+	return ret;
+}
+
+void Context::rerecord(const char* cause) {
+	{
+		std::lock_guard lock(statsMutex_);
+		stats_.rerecords.push_back({nullptr,
+			cause ? cause : "Context::rerecord"});
+	}
+
+	invalidate(nullptr);
+}
+
+void Context::rerecord(const DeviceObject& obj, const char* cause) {
+	rerecordCause(obj, cause ? cause : "Context::rerecord");
+	invalidate(&obj);
+}
+
+void Context::rerecordCause(const DeviceObject& obj, const char* cause) {
+	std::lock_guard lock(statsMutex_);
+	stats_.rerecords.push_back({&obj, cause});
+}
+
+std::size_t Context::rerecordCauses() {
+	std::lock_guard lock(statsMutex_);
+	return stats_.rerecords.size();
+}
+
+// Invalidates the layers using the given object, all if it is nullptr
+void Context::invalidate(const DeviceObject* obj) {
+	RVG_TRACE_COUNT_RERECORD();
+	rerecord_.store(true);
+	std::lock_guard lock(layerMutex_);
+	if(!obj) {
+		for(auto* layer : layers_) {
+			layer->invalid_ = true;
+		}
+
+		return;
+	}
+
+	auto it = layerRefs_.find(obj);
+	if(it != layerRefs_.end()) {
+		for(auto* layer : it->second) {
+			layer->invalid_ = true;
+		}
+	}
+}
+
+std::vector<Layer*> Context::invalidLayers() const {
+	std::lock_guard lock(layerMutex_);
+	std::vector<Layer*> ret;
+	for(auto* layer : layers_) {
+		if(layer->invalid_) {
+			ret.push_back(layer);
+		}
+	}
+
+	return ret;
+}
+
+vk::ShaderStageFlags Context::pushConstantStages() const {
+	return vk::ShaderStageBits::vertex | vk::ShaderStageBits::fragment;
+}
+
+vk::Pipeline Context::pipeline(vk::PrimitiveTopology topology,
+		std::uint32_t drawType, std::uint32_t paintType) {
+	return pipeline(ShaderProgram::fill, topology, drawType, paintType);
+}
+
+vk::Pipeline Context::pipeline(ShaderProgram program,
+		vk::PrimitiveTopology topology, std::uint32_t drawType,
+		std::uint32_t paintType) {
+	if(!settings().pipelineVariants) {
+		drawType = anyType;
+		paintType = anyType;
+	}
+
+	std::lock_guard lock(pipelineMutex_);
+	auto key = pipelineKey(program, topology, drawType, paintType);
+	auto it = pipelines_.find(key);
+	if(it == pipelines_.end()) {
+		auto pipe = createPipeline(program, topology, drawType, paintType);
+		it = pipelines_.emplace(key, std::move(pipe)).first;
+	}
+
+	return it->second;
+}
+
+vk::PipelineCache Context::pipelineCache() const {
+	if(settings().pipelineCache) {
+		return settings().pipelineCache;
+	}
+
+	return pipelineCache_;
+}
+
+bool Context::savePipelineCache() {
+	std::lock_guard lock(pipelineMutex_);
+	if(!pipelineCache_.vkHandle() || !pipelineCacheChanged_) {
+		return true;
+	}
+
+	if(!vpp::save(pipelineCache_, settings().pipelineCacheFile)) {
+		return false;
+	}
+
+	pipelineCacheChanged_ = false;
+	return true;
+}
+
+FontAtlas& Context::defaultAtlas() {
+	if(!defaultAtlas_) {
+		defaultAtlas_ = std::make_unique<FontAtlas>(*this);
+	}
+
+	return *defaultAtlas_;
+}
+
+vk::Pipeline Context::fanPipe() {
+	return pipeline(vk::PrimitiveTopology::triangleFan, anyType, anyType);
+}
+
+vk::Pipeline Context::stripPipe() {
+	return pipeline(vk::PrimitiveTopology::triangleStrip, anyType, anyType);
+}
+
+// draw and paint types are small, anyType maps to 0xFF
+std::uint32_t Context::pipelineKey(ShaderProgram program,
+		vk::PrimitiveTopology topology, std::uint32_t drawType,
+		std::uint32_t paintType) {
+	auto fan = (topology == vk::PrimitiveTopology::triangleFan);
+	return std::uint32_t(program) << 24 | std::uint32_t(fan) << 16 |
+		(drawType & 0xFFu) << 8 | (paintType & 0xFFu);
+}
+
+void Context::createShaders(ShaderProgram program) {
+	using ShaderData = nytl::Span<const std::uint32_t>;
+
+	// The compiled variants, see src/shaders/meson.build.
+	// Indexed by [bindless][clipDistance], the fill fragment shader
+	// additionally by [antiAliasing]. The analytic shapes and sprites
+	// don't use the edge aa values.
+	const ShaderData fillVert[2][2] = {
+		{fill_vert_frag_scissor_data, fill_vert_plane_scissor_data},
+		{fill_vert_frag_scissor_bindless_data,
+			fill_vert_plane_scissor_bindless_data},
+	};
+
+	const ShaderData fillFrag[2][2][2] = {{
+			{fill_frag_frag_scissor_data, fill_frag_frag_scissor_edge_aa_data},
+			{fill_frag_plane_scissor_data,
+				fill_frag_plane_scissor_edge_aa_data},
+		}, {
+			{fill_frag_frag_scissor_bindless_data,
+				fill_frag_frag_scissor_edge_aa_bindless_data},
+			{fill_frag_plane_scissor_bindless_data,
+				fill_frag_plane_scissor_edge_aa_bindless_data},
+		},
+	};
+
+	const ShaderData sdfVert[2][2] = {
+		{sdf_vert_frag_scissor_data, sdf_vert_plane_scissor_data},
+		{sdf_vert_frag_scissor_bindless_data,
+			sdf_vert_plane_scissor_bindless_data},
+	};
+
+	const ShaderData sdfFrag[2][2] = {
+		{sdf_frag_frag_scissor_data, sdf_frag_plane_scissor_data},
+		{sdf_frag_frag_scissor_bindless_data,
+			sdf_frag_plane_scissor_bindless_data},
+	};
+
+	const ShaderData spriteVert[2][2] = {
+		{sprite_vert_frag_scissor_data, sprite_vert_plane_scissor_data},
+		{sprite_vert_frag_scissor_bindless_data,
+			sprite_vert_plane_scissor_bindless_data},
+	};
+
+	const ShaderData spriteFrag[2][2] = {
+		{sprite_frag_frag_scissor_data, sprite_frag_plane_scissor_data},
+		{sprite_frag_frag_scissor_bindless_data,
+			sprite_frag_plane_scissor_bindless_data},
+	};
+
+	auto bindless = unsigned(settings().bindless);
+	auto plane = unsigned(settings().clipDistanceEnable);
+	auto aa = unsigned(settings().antiAliasing);
+	auto& shaders = shaders_[unsigned(program)];
+	switch(program) {
+		case ShaderProgram::fill:
+			shaders.vertex = {device(), fillVert[bindless][plane]};
+			shaders.fragment = {device(), fillFrag[bindless][plane][aa]};
+			break;
+		case ShaderProgram::sdf:
+			shaders.vertex = {device(), sdfVert[bindless][plane]};
+			shaders.fragment = {device(), sdfFrag[bindless][plane]};
+			break;
+		case ShaderProgram::sprite:
+			shaders.vertex = {device(), spriteVert[bindless][plane]};
+			shaders.fragment = {device(), spriteFrag[bindless][plane]};
+			break;
+	}
+}
+
+vpp::Pipeline Context::createPipeline(ShaderProgram program,
+		vk::PrimitiveTopology topology, std::uint32_t drawType,
+		std::uint32_t paintType) {
+	auto& shaders = shaders_[unsigned(program)];
+	if(!shaders.vertex.vkHandle()) {
+		createShaders(program);
+	}
+
+	// see fill.frag: the size of the texture array in bindless mode
+	// and the draw and paint type, anyType reads them at runtime.
+	// The sdf vertex shader also reads the draw type.
+	struct {
+		std::uint32_t textureCount;
+		std::uint32_t drawType;
+		std::uint32_t paintType;
+	} specData {settings().bindlessTextures, drawType, paintType};
+
+	constexpr auto u32 = sizeof(std::uint32_t);
+	std::array<vk::SpecializationMapEntry, 3> specEntries {{
+		{0, 0 * u32, u32},
+		{1, 1 * u32, u32},
+		{2, 2 * u32, u32},
+	}};
+
+	vk::SpecializationInfo spec {std::uint32_t(specEntries.size()),
+		specEntries.data(), sizeof(specData), &specData};
+
+	auto samples = settings().samples == vk::SampleCountBits {} ?
+		vk::SampleCountBits::e1 : settings().samples;
+	vpp::GraphicsPipelineInfo pipeInfo(settings().renderPass,
+		pipeLayout_, {{
+			{shaders.vertex, vk::ShaderStageBits::vertex, &spec},
+			{shaders.fragment, vk::ShaderStageBits::fragment, &spec}
+		}}, settings().subpass, samples);
+
+	// derive from the generic fan pipeline if it was already created
+	auto flags = nytl::Flags {vk::PipelineCreateBits::allowDerivatives};
+	auto fan = vk::PrimitiveTopology::triangleFan;
+	auto base = pipelines_.find(pipelineKey(ShaderProgram::fill, fan,
+		anyType, anyType));
+	if(base != pipelines_.end()) {
+		pipeInfo.base(base->second);
+		flags |= vk::PipelineCreateBits::derivative;
+	}
+
+	pipeInfo.flags(flags);
 
 	// vertex attribs: vec2 pos, vec2 uv, vec4u8 color
 	std::array<vk::VertexInputAttributeDescription, 3> vertexAttribs = {};
@@ -169,223 +673,813 @@ Context::Context(vpp::Device& dev, const ContextSettings& settings) :
 	vertexBindings[2].stride = sizeof(u8) * 4; // color
 	vertexBindings[2].binding = 2;
 
-	fanPipeInfo.vertex.pVertexAttributeDescriptions = vertexAttribs.data();
-	fanPipeInfo.vertex.vertexAttributeDescriptionCount = vertexAttribs.size();
-	fanPipeInfo.vertex.pVertexBindingDescriptions = vertexBindings.data();
-	fanPipeInfo.vertex.vertexBindingDescriptionCount = vertexBindings.size();
-
-	fanPipeInfo.assembly.topology = vk::PrimitiveTopology::triangleFan;
+	pipeInfo.vertex.pVertexAttributeDescriptions = vertexAttribs.data();
+	pipeInfo.vertex.vertexAttributeDescriptionCount = vertexAttribs.size();
+	pipeInfo.vertex.pVertexBindingDescriptions = vertexBindings.data();
+	pipeInfo.vertex.vertexBindingDescriptionCount = vertexBindings.size();
+
+	// analytic shapes: one SdfInstance per instance in binding 0
+	std::array<vk::VertexInputAttributeDescription, 5> sdfAttribs = {{
+		{0, 0, vk::Format::r32g32b32a32Sfloat,
+			offsetof(SdfInstance, position)}, // position and size
+		{1, 0, vk::Format::r32g32b32a32Sfloat, offsetof(SdfInstance, radii)},
+		{2, 0, vk::Format::r8g8b8a8Unorm, offsetof(SdfInstance, color)},
+		{3, 0, vk::Format::r32Sfloat, offsetof(SdfInstance, stroke)},
+		{4, 0, vk::Format::r32Uint, offsetof(SdfInstance, flags)},
+	}};
 
-	// stripPipe
-	auto stripPipeInfo = fanPipeInfo;
-	stripPipeInfo.base(0);
-	stripPipeInfo.assembly.topology = vk::PrimitiveTopology::triangleStrip;
+	vk::VertexInputBindingDescription sdfBinding {0, sizeof(SdfInstance),
+		vk::VertexInputRate::instance};
+
+	// sprites: one SpriteInstance per instance in binding 0
+	std::array<vk::VertexInputAttributeDescription, 5> spriteAttribs = {{
+		{0, 0, vk::Format::r32g32b32a32Sfloat,
+			offsetof(SpriteInstance, axisX)}, // both axes
+		{1, 0, vk::Format::r32g32Sfloat, offsetof(SpriteInstance, origin)},
+		{2, 0, vk::Format::r8g8b8a8Unorm, offsetof(SpriteInstance, tint)},
+		{3, 0, vk::Format::r32g32b32a32Sfloat,
+			offsetof(SpriteInstance, regionPosition)}, // position and size
+		{4, 0, vk::Format::r32Uint, offsetof(SpriteInstance, flags)},
+	}};
 
-	auto pipes = vk::createGraphicsPipelines(dev, settings.pipelineCache,
-		{fanPipeInfo.info(), stripPipeInfo.info()});
-	fanPipe_ = {dev, pipes[0]};
-	stripPipe_ = {dev, pipes[1]};
+	vk::VertexInputBindingDescription spriteBinding {0,
+		sizeof(SpriteInstance), vk::VertexInputRate::instance};
+
+	if(program == ShaderProgram::sdf) {
+		pipeInfo.vertex.pVertexAttributeDescriptions = sdfAttribs.data();
+		pipeInfo.vertex.vertexAttributeDescriptionCount = sdfAttribs.size();
+		pipeInfo.vertex.pVertexBindingDescriptions = &sdfBinding;
+		pipeInfo.vertex.vertexBindingDescriptionCount = 1u;
+	} else if(program == ShaderProgram::sprite) {
+		pipeInfo.vertex.pVertexAttributeDescriptions = spriteAttribs.data();
+		pipeInfo.vertex.vertexAttributeDescriptionCount = spriteAttribs.size();
+		pipeInfo.vertex.pVertexBindingDescriptions = &spriteBinding;
+		pipeInfo.vertex.vertexBindingDescriptionCount = 1u;
+	}
 
-	// sync stuff
-	auto family = device().queueSubmitter().queue().family();
-	uploadSemaphore_ = {device()};
-	uploadCmdBuf_ = device().commandAllocator().get(family,
-		vk::CommandPoolCreateBits::resetCommandBuffer);
+	pipeInfo.assembly.topology = topology;
 
-	// dummies
-	constexpr std::uint8_t bytes[] = {0xFF, 0xFF, 0xFF, 0xFF};
-	emptyImage_ = {*this, {1u, 1u},
-		{*reinterpret_cast<const std::byte*>(bytes), 4u},
-		TextureType::rgba32};
+	auto pipes = vk::createGraphicsPipelines(device(), pipelineCache(),
+		{pipeInfo.info()});
+	pipelineCacheChanged_ = true;
+	return {device(), pipes[0]};
+}
 
-	dummyTex_ = {dsAllocator(), dsLayoutFontAtlas_};
-	vpp::DescriptorSetUpdate update(dummyTex_);
-	auto layout = vk::ImageLayout::shaderReadOnlyOptimal;
-	update.imageSampler({{{}, emptyImage_.vkImageView(), layout}});
+bool Context::updateBindless() {
+	// uploads the entries written in this updateDevice call.
+	// Descriptors of a set that might be used by a pending frame
+	// can't be changed, so we use a new one when anything changed.
+	auto changed = bindlessTransforms_->updateDevice();
+	changed |= bindlessScissors_->updateDevice();
+	changed |= bindlessPaints_->updateDevice();
+	changed |= bindlessTextures_->updateDevice();
+	if(changed || !bindlessDs_) {
+		keepAlive(std::move(bindlessDs_));
+		writeBindlessDs();
+	}
 
-	identityTransform_ = {*this};
-	pointColorPaint_ = {*this, ::rvg::pointColorPaint()};
-	defaultScissor_ = {*this, Scissor::reset};
-	defaultAtlas_ = std::make_unique<FontAtlas>(*this);
+	return changed;
+}
 
-	if(settings.antiAliasing) {
-		defaultStrokeAABuf_ = {bufferAllocator(), 12 * sizeof(float),
-			vk::BufferUsageBits::uniformBuffer, 0u, device().hostMemoryTypes()};
-		auto map = defaultStrokeAABuf_.memoryMap();
-		auto ptr = map.ptr();
-		write(ptr, 1.f);
+void Context::writeBindlessDs() {
+	bindlessDs_ = {dsAllocator(), dsLayoutBindless_};
+	vpp::DescriptorSetUpdate update(bindlessDs_);
+	for(auto* table : {bindlessTransforms_.get(), bindlessPaints_.get(),
+			bindlessScissors_.get()}) {
+		auto& b = table->buffer();
+		update.storage({{b.buffer(), b.offset(), b.size()}});
+	}
 
-		defaultStrokeAA_ = {dsAllocator(), dsLayoutStrokeAA_};
-		auto& b = defaultStrokeAABuf_;
-		vpp::DescriptorSetUpdate update(defaultStrokeAA_);
-		update.uniform({{b.buffer(), b.offset(), sizeof(float)}});
+	std::vector<vk::DescriptorImageInfo> images;
+	images.reserve(bindlessTextures_->views().size());
+	for(auto view : bindlessTextures_->views()) {
+		images.push_back({{}, view, vk::ImageLayout::shaderReadOnlyOptimal});
 	}
-}
 
-vpp::DescriptorAllocator& Context::dsAllocator() const {
-	return device().descriptorAllocator();
+	update.imageSampler(images);
 }
 
-vpp::BufferAllocator& Context::bufferAllocator() const {
-	return device().bufferAllocator();
+void Context::updateHostParallel() {
+	// Collect the work first, updateDevice_ may grow while the workers
+	// run (e.g. font atlases registering themselves).
+	// Polygons are independent, texts share the (not thread safe)
+	// fontstash context of their atlas and are therefore laid out
+	// in registration order by one thread per atlas. This also keeps
+	// the result deterministic.
+	std::vector<Polygon*> polygons;
+	std::vector<std::pair<FontAtlas*, std::vector<Text*>>> atlases;
+	for(auto& ud : updateDevice_) {
+		if(auto* polygon = std::get_if<Polygon*>(&ud); polygon && *polygon) {
+			polygons.push_back(*polygon);
+		} else if(auto* text = std::get_if<Text*>(&ud); text && *text) {
+			auto* atlas = &(*text)->font().atlas();
+			auto it = std::find_if(atlases.begin(), atlases.end(),
+				[&](auto& a) { return a.first == atlas; });
+			if(it == atlases.end()) {
+				it = atlases.emplace(atlases.end(), atlas,
+					std::vector<Text*>{});
+			}
+
+			it->second.push_back(*text);
+		}
+	}
+
+	auto count = unsigned(polygons.size() + atlases.size());
+	threadPool_->parallelFor(count, [&](unsigned i) {
+		if(i < polygons.size()) {
+			polygons[i]->updateHost();
+			return;
+		}
+
+		for(auto* text : atlases[i - polygons.size()].second) {
+			text->updateHost();
+		}
+	});
 }
 
-void Context::bindDefaults(vk::CommandBuffer cmdb) {
-	identityTransform_.bind(cmdb);
-	defaultScissor_.bind(cmdb);
+std::pair<bool, vk::Semaphore> Context::upload() {
+	auto rerecord = updateDevice();
+	auto seph = stageUpload();
+	return {rerecord, seph};
+}
 
-	vk::cmdBindDescriptorSets(cmdb, vk::PipelineBindPoint::graphics,
-		pipeLayout(), fontBindSet, {dummyTex_}, {});
+vk::Semaphore Context::stageUpload() {
+	RVG_TRACE_EVENT("Context::stageUpload", "Context");
+	if(gpuTimer_) {
+		gpuTimer_->frame();
+	}
 
-	if(settings().antiAliasing) {
-		vk::cmdBindDescriptorSets(cmdb, vk::PipelineBindPoint::graphics,
-			pipeLayout(), aaStrokeBindSet, {defaultStrokeAA_}, {});
+	vk::Semaphore ret {};
+	auto& frame = currentFrame();
+	auto& arena = frame.arena;
+	if(arena.offset && !arena.map.coherent()) {
+		arena.map.flush();
 	}
-}
 
-bool Context::updateDevice() {
-	auto visitor = [&](auto* obj) {
-		dlg_assert(obj);
-		return obj->updateDevice();
+	// drop uploads of objects that were destroyed in the meantime
+	auto destroyed = [&](auto& upload) {
+		return !frame.owners[upload.owner];
 	};
 
-	for(auto& ud : updateDevice_) {
-		rerecord_ |= std::visit(visitor, ud);
+	auto& bufs = frame.bufferUploads;
+	bufs.erase(std::remove_if(bufs.begin(), bufs.end(), destroyed),
+		bufs.end());
+
+	auto& imgs = frame.imageUploads;
+	imgs.erase(std::remove_if(imgs.begin(), imgs.end(), destroyed),
+		imgs.end());
+
+	auto uploads = !frame.bufferUploads.empty() ||
+		!frame.imageUploads.empty();
+	if(uploads && transferSubmitter_) {
+		submitTransferUploads();
+		ret = frame.semaphore;
+	} else if(uploads) {
+		vk::CommandBufferBeginInfo beginInfo;
+		beginInfo.flags = vk::CommandBufferUsageBits::oneTimeSubmit;
+		vk::beginCommandBuffer(frame.cmdBuf, beginInfo);
+
+		// when there are frames in flight, the copies must not start
+		// before they finished reading (write-after-read). The first
+		// barrier in recordUploads has the transfer stage as source
+		// and therefore chains with this dependency.
+		if(settings().framesInFlight > 1) {
+			vk::cmdPipelineBarrier(frame.cmdBuf,
+				vk::PipelineStageBits::allCommands,
+				vk::PipelineStageBits::transfer, {}, {}, {}, {});
+		}
+
+		if(gpuTimer_) {
+			gpuTimer_->beginUpload(frame.cmdBuf);
+		}
+
+		recordUploads(frame.cmdBuf, false);
+		if(gpuTimer_) {
+			gpuTimer_->endUpload(frame.cmdBuf);
+		}
+
+		vk::endCommandBuffer(frame.cmdBuf);
+
+		vk::SubmitInfo info;
+		info.commandBufferCount = 1;
+		info.pCommandBuffers = &frame.cmdBuf.vkHandle();
+		info.pSignalSemaphores = &frame.semaphore.vkHandle();
+		info.signalSemaphoreCount = 1u;
+		frame.submission = device().queueSubmitter().add(info);
+		ret = frame.semaphore;
 	}
 
-	updateDevice_.clear();
-	auto ret = rerecord_;
-	rerecord_ = false;
+	ret = renderCachedGroups(ret);
+
+	// The frame we advance to was used framesInFlight stageUpload calls
+	// ago and has therefore completed (as guaranteed by the caller).
+	// Its arena can be reused from the beginning.
+	// We still make sure that its upload has finished, which should
+	// never block.
+	frame_ = (frame_ + 1) % frames_.size();
+	auto& next = currentFrame();
+	if(next.submission) {
+		device().queueSubmitter().wait(next.submission);
+		next.submission = {};
+	}
+
+	++frameCount_;
+	for(auto& range : next.ranges) {
+		geometryArena_->release(range.block, range.offset, range.size);
+	}
+
+	next.ranges.clear();
+	next.bufferUploads.clear();
+	next.imageUploads.clear();
+	next.owners.clear();
+	next.buffers.clear();
+	next.descriptors.clear();
+	next.images.clear();
+	next.commandBuffers.clear();
+	next.slots.clear();
+	next.arena.offset = 0u;
 	return ret;
 }
 
-std::pair<bool, vk::Semaphore> Context::upload() {
-	auto rerecord = updateDevice();
-	auto seph = stageUpload();
-	return {rerecord, seph};
+vk::Semaphore Context::renderCachedGroups(vk::Semaphore wait) {
+	auto& frame = currentFrame();
+	auto render = std::any_of(cachedGroups_.begin(), cachedGroups_.end(),
+		[](auto* group) { return group->needsRender(); });
+	if(!render) {
+		return wait;
+	}
+
+	if(!frame.renderCmdBuf.vkHandle()) {
+		auto family = device().queueSubmitter().queue().family();
+		auto flags = vk::CommandPoolCreateBits::resetCommandBuffer;
+		frame.renderCmdBuf = device().commandAllocator().get(family, flags);
+		frame.renderSemaphore = {device()};
+	}
+
+	// ordering with pending frames sampling the images is done
+	// by the dependencies of the render passes
+	vk::CommandBufferBeginInfo beginInfo;
+	beginInfo.flags = vk::CommandBufferUsageBits::oneTimeSubmit;
+	vk::beginCommandBuffer(frame.renderCmdBuf, beginInfo);
+	for(auto* group : cachedGroups_) {
+		if(group->needsRender()) {
+			group->render(frame.renderCmdBuf);
+			if(damage_) {
+				damage_->redrawn(group->shape().polygon());
+			}
+		}
+	}
+	vk::endCommandBuffer(frame.renderCmdBuf);
+
+	// the uploads of this frame must have finished
+	vk::SubmitInfo info;
+	info.commandBufferCount = 1;
+	info.pCommandBuffers = &frame.renderCmdBuf.vkHandle();
+	info.pSignalSemaphores = &frame.renderSemaphore.vkHandle();
+	info.signalSemaphoreCount = 1u;
+	if(wait) {
+		info.pWaitSemaphores = &wait;
+		info.pWaitDstStageMask = &waitStage_;
+		info.waitSemaphoreCount = 1u;
+	}
+
+	// completes after the upload submission (waits for it)
+	frame.submission = device().queueSubmitter().add(info);
+	return frame.renderSemaphore;
 }
 
-vk::Semaphore Context::stageUpload() {
-	vk::Semaphore ret {};
-	if(!currentFrame_.cmdBufs.empty()) {
-		// we currently record secondary buffers and then unify
-		// them here as one since we might need the ordering
-		// guarantees. Not really sure though (can currently
-		// only think of Texture and that might be solveable
-		// in a different way). Investigate/profile.
-		vk::beginCommandBuffer(uploadCmdBuf_, {});
-		for(auto& buf : currentFrame_.cmdBufs) {
-			vk::cmdExecuteCommands(uploadCmdBuf_, {buf.second});
-		}
-		vk::endCommandBuffer(uploadCmdBuf_);
+void Context::submitTransferUploads() {
+	auto& frame = currentFrame();
+	auto& qs = device().queueSubmitter();
+	auto gfam = qs.queue().family();
+	auto tfam = transferSubmitter_->queue().family();
+
+	vk::CommandBufferBeginInfo beginInfo;
+	beginInfo.flags = vk::CommandBufferUsageBits::oneTimeSubmit;
+	auto stage = vk::PipelineStageFlags(vk::PipelineStageBits::transfer);
+
+	// 1: release the written buffer ranges and images from the graphics
+	// queue family. Images first uploaded from the undefined layout
+	// (i.e. as a whole) discard their content and aren't released.
+	// When there are frames in flight, this submission is also what
+	// orders the transfer after them.
+	auto barriers = ownershipBarriers(gfam, tfam);
+	auto imgBarriers = imageBarriers();
+	imgBarriers.erase(std::remove_if(imgBarriers.begin(), imgBarriers.end(),
+		[](auto& barrier) {
+			return barrier.oldLayout == vk::ImageLayout::undefined;
+		}), imgBarriers.end());
+	for(auto& barrier : imgBarriers) {
+		barrier.srcQueueFamilyIndex = gfam;
+		barrier.dstQueueFamilyIndex = tfam;
+	}
+
+	auto release = !barriers.empty() || !imgBarriers.empty() ||
+		settings().framesInFlight > 1;
+	if(release) {
+		vk::beginCommandBuffer(frame.releaseCmdBuf, beginInfo);
+		if(!barriers.empty() || !imgBarriers.empty()) {
+			vk::cmdPipelineBarrier(frame.releaseCmdBuf,
+				vk::PipelineStageBits::allCommands,
+				vk::PipelineStageBits::bottomOfPipe, {}, {}, barriers,
+				imgBarriers);
+		}
+		vk::endCommandBuffer(frame.releaseCmdBuf);
 
 		vk::SubmitInfo info;
 		info.commandBufferCount = 1;
-		info.pCommandBuffers = &uploadCmdBuf_.vkHandle();
-		info.pSignalSemaphores = &uploadSemaphore_.vkHandle();
+		info.pCommandBuffers = &frame.releaseCmdBuf.vkHandle();
+		info.pSignalSemaphores = &frame.releaseSemaphore.vkHandle();
 		info.signalSemaphoreCount = 1u;
-		device().queueSubmitter().add(info);
-		ret = uploadSemaphore_;
+
+		// The transfer waits for the signal, so it has to be submitted
+		// now. Submitted directly to not flush the batches queued
+		// on the QueueSubmitter by the application.
+		vpp::QueueLock lock(device(), qs.queue());
+		vk::queueSubmit(qs.queue().vkHandle(), {{info}}, {});
+	}
+
+	// 2: copies on the transfer queue
+	vk::beginCommandBuffer(frame.transferCmdBuf, beginInfo);
+	recordUploads(frame.transferCmdBuf, true);
+	vk::endCommandBuffer(frame.transferCmdBuf);
+
+	vk::SubmitInfo info;
+	info.commandBufferCount = 1;
+	info.pCommandBuffers = &frame.transferCmdBuf.vkHandle();
+	info.pSignalSemaphores = &frame.transferSemaphore.vkHandle();
+	info.signalSemaphoreCount = 1u;
+	if(release) {
+		info.pWaitSemaphores = &frame.releaseSemaphore.vkHandle();
+		info.pWaitDstStageMask = &stage;
+		info.waitSemaphoreCount = 1u;
+	}
+
+	transferSubmitter_->add(info);
+	transferSubmitter_->submit();
+
+	// 3: acquire everything on the graphics queue
+	vk::beginCommandBuffer(frame.cmdBuf, beginInfo);
+	barriers = ownershipBarriers(tfam, gfam);
+	for(auto& barrier : barriers) {
+		barrier.dstAccessMask = vk::AccessBits::indirectCommandRead |
+			vk::AccessBits::vertexAttributeRead |
+			vk::AccessBits::uniformRead |
+			vk::AccessBits::shaderRead;
+	}
+
+	imgBarriers = imageBarriers();
+	for(auto& barrier : imgBarriers) {
+		barrier.oldLayout = vk::ImageLayout::transferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::shaderReadOnlyOptimal;
+		barrier.dstAccessMask = vk::AccessBits::shaderRead;
+		barrier.srcQueueFamilyIndex = tfam;
+		barrier.dstQueueFamilyIndex = gfam;
+	}
+
+	vk::cmdPipelineBarrier(frame.cmdBuf, vk::PipelineStageBits::topOfPipe,
+		vk::PipelineStageBits::allCommands, {}, {}, barriers, imgBarriers);
+	vk::endCommandBuffer(frame.cmdBuf);
+
+	info.pCommandBuffers = &frame.cmdBuf.vkHandle();
+	info.pSignalSemaphores = &frame.semaphore.vkHandle();
+	info.pWaitSemaphores = &frame.transferSemaphore.vkHandle();
+	info.pWaitDstStageMask = &waitStage_;
+	info.waitSemaphoreCount = 1u;
+	frame.submission = qs.add(info);
+}
+
+std::vector<vk::BufferMemoryBarrier> Context::ownershipBarriers(
+		unsigned srcFamily, unsigned dstFamily) {
+	// one barrier per buffer, covering all ranges written in it
+	std::unordered_map<vk::Buffer, std::pair<vk::DeviceSize,
+		vk::DeviceSize>> ranges;
+	for(auto& buf : currentFrame().bufferUploads) {
+		auto begin = buf.copy.dstOffset;
+		auto end = begin + buf.copy.size;
+		auto [it, inserted] = ranges.try_emplace(buf.dst, begin, end);
+		if(!inserted) {
+			it->second.first = std::min(it->second.first, begin);
+			it->second.second = std::max(it->second.second, end);
+		}
+	}
+
+	std::vector<vk::BufferMemoryBarrier> ret;
+	ret.reserve(ranges.size());
+	for(auto& [buffer, range] : ranges) {
+		auto& barrier = ret.emplace_back();
+		barrier.buffer = buffer;
+		barrier.offset = range.first;
+		barrier.size = range.second - range.first;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
 	}
 
-	oldFrame_ = std::move(currentFrame_);
 	return ret;
 }
 
-vpp::CommandBuffer Context::uploadCmdBuf() {
-	auto family = device().queueSubmitter().queue().family();
-	auto flags = vk::CommandPoolCreateBits::resetCommandBuffer |
-			vk::CommandPoolCreateBits::transient;
-	auto cmd = device().commandAllocator().get(family, flags,
-		vk::CommandBufferLevel::secondary);
+void Context::recordUploads(vk::CommandBuffer cb, bool transferQueue) {
+	auto& images = currentFrame().imageUploads;
+	auto& buffers = currentFrame().bufferUploads;
+
+	// on a dedicated transfer queue, the written buffer ranges
+	// have to be acquired first (and released at the end)
+	auto gfam = device().queueSubmitter().queue().family();
+	auto tfam = transferQueue ? transferSubmitter_->queue().family() : gfam;
+	std::vector<vk::BufferMemoryBarrier> bufBarriers;
+	if(transferQueue) {
+		bufBarriers = ownershipBarriers(gfam, tfam);
+		for(auto& barrier : bufBarriers) {
+			barrier.dstAccessMask = vk::AccessBits::transferWrite;
+		}
+	}
+
+	// transition all images at once. On a dedicated transfer queue,
+	// the images whose content is kept have to be acquired
+	auto barriers = imageBarriers();
+	for(auto& barrier : barriers) {
+		barrier.dstAccessMask = vk::AccessBits::transferWrite;
+		if(transferQueue && barrier.oldLayout != vk::ImageLayout::undefined) {
+			barrier.srcQueueFamilyIndex = gfam;
+			barrier.dstQueueFamilyIndex = tfam;
+		}
+	}
 
-	vk::CommandBufferInheritanceInfo inherit;
-	vk::CommandBufferBeginInfo info;
-	info.flags = vk::CommandBufferUsageBits::oneTimeSubmit;
-	info.pInheritanceInfo = &inherit;
-	vk::beginCommandBuffer(cmd, info);
+	if(!barriers.empty() || !bufBarriers.empty()) {
+		vk::cmdPipelineBarrier(cb, vk::PipelineStageBits::transfer,
+			vk::PipelineStageBits::transfer, {}, {}, bufBarriers, barriers);
+	}
+
+	// copies to the same image might overlap and are ordered
+	std::vector<vk::Image> copied;
+	for(auto& img : images) {
+		if(std::find(copied.begin(), copied.end(), img.dst) != copied.end()) {
+			vk::MemoryBarrier barrier;
+			barrier.srcAccessMask = vk::AccessBits::transferWrite;
+			barrier.dstAccessMask = vk::AccessBits::transferWrite;
+			vk::cmdPipelineBarrier(cb, vk::PipelineStageBits::transfer,
+				vk::PipelineStageBits::transfer, {}, {barrier}, {}, {});
+			copied.clear();
+		}
 
-	return cmd;
+		copied.push_back(img.dst);
+		vk::cmdCopyBufferToImage(cb, img.src, img.dst,
+			vk::ImageLayout::transferDstOptimal, {img.copy});
+	}
+
+	// Merge all buffer copies with the same source and destination
+	// into one command. Copies in one batch must not write overlapping
+	// ranges (happens e.g. when an object is uploaded multiple times in
+	// one frame), such a copy starts a new batch after a barrier, so
+	// the later upload wins.
+	using Ranges = std::map<vk::DeviceSize, vk::DeviceSize>; // begin, end
+	std::unordered_map<vk::Buffer, Ranges> written;
+	std::vector<const BufferUpload*> batch;
+	std::vector<vk::BufferCopy> regions;
+
+	auto flush = [&]{
+		std::stable_sort(batch.begin(), batch.end(), [](auto* a, auto* b) {
+			return std::tie(a->src, a->dst) < std::tie(b->src, b->dst);
+		});
+
+		for(auto it = batch.begin(); it != batch.end();) {
+			auto src = (*it)->src;
+			auto dst = (*it)->dst;
+			regions.clear();
+			for(; it != batch.end() && (*it)->src == src &&
+					(*it)->dst == dst; ++it) {
+				regions.push_back((*it)->copy);
+			}
+
+			vk::cmdCopyBuffer(cb, src, dst, regions);
+		}
+
+		batch.clear();
+		written.clear();
+	};
+
+	for(auto& buf : buffers) {
+		auto begin = buf.copy.dstOffset;
+		auto end = begin + buf.copy.size;
+		auto& ranges = written[buf.dst];
+		auto next = ranges.upper_bound(begin);
+		auto overlap = (next != ranges.end() && next->first < end) ||
+			(next != ranges.begin() && std::prev(next)->second > begin);
+
+		if(overlap) {
+			flush();
+
+			vk::MemoryBarrier barrier;
+			barrier.srcAccessMask = vk::AccessBits::transferWrite;
+			barrier.dstAccessMask = vk::AccessBits::transferWrite;
+			vk::cmdPipelineBarrier(cb, vk::PipelineStageBits::transfer,
+				vk::PipelineStageBits::transfer, {}, {barrier}, {}, {});
+		}
+
+		written[buf.dst].emplace(begin, end);
+		batch.push_back(&buf);
+	}
+
+	flush();
+
+	// make images readable
+	for(auto& barrier : barriers) {
+		barrier.oldLayout = vk::ImageLayout::transferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::shaderReadOnlyOptimal;
+		barrier.srcAccessMask = vk::AccessBits::transferWrite;
+		barrier.dstAccessMask = vk::AccessBits::shaderRead;
+	}
+
+	if(transferQueue) {
+		// release everything to the graphics queue family, the
+		// matching acquire is done in submitTransferUploads
+		for(auto& barrier : barriers) {
+			barrier.dstAccessMask = {};
+			barrier.srcQueueFamilyIndex = tfam;
+			barrier.dstQueueFamilyIndex = gfam;
+		}
+
+		for(auto& barrier : bufBarriers) {
+			barrier.srcAccessMask = vk::AccessBits::transferWrite;
+			barrier.dstAccessMask = {};
+			barrier.srcQueueFamilyIndex = tfam;
+			barrier.dstQueueFamilyIndex = gfam;
+		}
+
+		vk::cmdPipelineBarrier(cb, vk::PipelineStageBits::transfer,
+			vk::PipelineStageBits::bottomOfPipe, {}, {}, bufBarriers,
+			barriers);
+	} else if(!barriers.empty()) {
+		vk::cmdPipelineBarrier(cb, vk::PipelineStageBits::transfer,
+			vk::PipelineStageBits::allGraphics, {}, {}, {}, barriers);
+	}
+}
+
+std::vector<vk::ImageMemoryBarrier> Context::imageBarriers() {
+	// one transition per image, from the layout of its first upload
+	// in this frame, the layout it actually is in
+	auto range = vk::ImageSubresourceRange {vk::ImageAspectBits::color,
+		0, 1, 0, 1};
+	std::vector<vk::ImageMemoryBarrier> ret;
+	for(auto& img : currentFrame().imageUploads) {
+		auto it = std::find_if(ret.begin(), ret.end(),
+			[&](auto& barrier) { return barrier.image == img.dst; });
+		if(it != ret.end()) {
+			continue;
+		}
+
+		auto& barrier = ret.emplace_back();
+		barrier.image = img.dst;
+		barrier.oldLayout = img.layout;
+		barrier.newLayout = vk::ImageLayout::transferDstOptimal;
+		barrier.subresourceRange = range;
+	}
+
+	return ret;
 }
 
-void Context::addStage(vpp::SubBuffer&& buf) {
+StageRange Context::stage(vk::DeviceSize size) {
+	constexpr auto minArenaSize = vk::DeviceSize(64 * 1024);
+	constexpr auto align = vk::DeviceSize(4u); // needed for image copies
+
+	auto& arena = currentFrame().arena;
+	auto offset = (arena.offset + align - 1) & ~(align - 1);
+	if(offset + size > arena.buffer.size()) {
+		// the old arena might still be referenced by this frames
+		// transfer commands so we keep it alive until the frame is reused.
+		// The next time this frame is used, the larger one will suffice
+		auto capacity = std::max(2 * arena.buffer.size(), minArenaSize);
+		while(capacity < size) {
+			capacity *= 2;
+		}
+
+		if(arena.buffer.size()) {
+			if(!arena.map.coherent()) {
+				arena.map.flush();
+			}
+
+			arena.map = {};
+			currentFrame().buffers.emplace_back(std::move(arena.buffer));
+		}
+
+		arena.buffer = {bufferAllocator(), capacity,
+			vk::BufferUsageBits::transferSrc, 0u, device().hostMemoryTypes()};
+		++stats_.stagingBuffers;
+		arena.map = arena.buffer.memoryMap();
+		offset = 0u;
+	}
+
+	arena.offset = offset + size;
+	bytesStaged_ += size;
+	RVG_TRACE_BYTES(size);
+	auto& b = arena.buffer;
+	auto span = vpp::BufferSpan(b.buffer(), {b.offset() + offset, size});
+	return {span, arena.map.ptr() + offset};
+}
+
+std::uint32_t Context::uploadOwner(DeviceObject& obj) {
+	auto& owners = currentFrame().owners;
+	if(obj.uploadFrame_ != frameCount_) {
+		obj.uploadFrame_ = frameCount_;
+		obj.uploadSlot_ = owners.size();
+		owners.push_back(&obj);
+	}
+
+	return obj.uploadSlot_;
+}
+
+void Context::addCopy(DeviceObject& obj, vk::Buffer src, vk::Buffer dst,
+		const vk::BufferCopy& copy) {
+	auto owner = uploadOwner(obj);
+	currentFrame().bufferUploads.push_back({owner, src, dst, copy});
+}
+
+void Context::addCopy(DeviceObject& obj, vk::Buffer src, vk::Image dst,
+		vk::ImageLayout layout, const vk::BufferImageCopy& copy) {
+	auto owner = uploadOwner(obj);
+
+	// a copy of the same region as the last copy to the image in
+	// this frame simply replaces it
+	auto& imgs = currentFrame().imageUploads;
+	auto it = std::find_if(imgs.rbegin(), imgs.rend(),
+		[&](auto& img) { return img.dst == dst; });
+	if(it != imgs.rend()) {
+		auto& o = it->copy.imageOffset;
+		auto& e = it->copy.imageExtent;
+		if(o.x == copy.imageOffset.x && o.y == copy.imageOffset.y &&
+				e.width == copy.imageExtent.width &&
+				e.height == copy.imageExtent.height) {
+			it->src = src;
+			it->copy = copy;
+			return;
+		}
+	}
+
+	imgs.push_back({owner, src, dst, layout, copy});
+}
+
+void Context::keepAlive(vpp::SubBuffer&& buf) {
 	if(buf.size()) {
-		currentFrame_.stages.emplace_back(std::move(buf));
+		currentFrame().buffers.emplace_back(std::move(buf));
 	}
 }
 
-void Context::addCommandBuffer(DevRes obj, vpp::CommandBuffer&& buf) {
-	vk::endCommandBuffer(buf);
-	currentFrame_.cmdBufs.emplace_back(obj, std::move(buf));
+void Context::keepAlive(vpp::TrDs&& ds) {
+	if(ds) {
+		currentFrame().descriptors.emplace_back(std::move(ds));
+	}
 }
 
-void Context::registerUpdateDevice(DevRes obj) {
-	updateDevice_.insert(obj);
+void Context::keepAlive(Texture&& tex) {
+	if(tex.image_.vkImage()) {
+		currentFrame().images.emplace_back(std::move(tex.image_));
+	}
 }
 
-bool Context::deviceObjectDestroyed(::rvg::DeviceObject& obj) noexcept {
-	// remove its command buffers since they might reference
-	// resources that just got destroyed.
-	auto compareVisitor = [&](auto* ud) {
-		return &obj == ud;
-	};
+void Context::keepAlive(vpp::CommandBuffer&& cb) {
+	if(cb.vkHandle()) {
+		currentFrame().commandBuffers.emplace_back(std::move(cb));
+	}
+}
+
+void Context::keepAlive(BindlessSlot&& slot) {
+	if(slot.valid()) {
+		currentFrame().slots.emplace_back(std::move(slot));
+	}
+}
+
+void Context::retireRange(unsigned block, vk::DeviceSize offset,
+		vk::DeviceSize size) {
+	currentFrame().ranges.push_back({block, offset, size});
+}
+
+void Context::addLayer(Layer& layer) {
+	std::lock_guard lock(layerMutex_);
+	layers_.push_back(&layer);
+}
+
+void Context::removeLayer(Layer& layer) {
+	std::lock_guard lock(layerMutex_);
+	unreferenceLayer(layer, layer.refs_);
+	auto it = std::find(layers_.begin(), layers_.end(), &layer);
+	dlg_assert(it != layers_.end());
+	layers_.erase(it);
+}
 
-	auto& bufs = currentFrame_.cmdBufs;
-	bufs.erase(std::remove_if(bufs.begin(), bufs.end(),
-		[&](auto& b) { return std::visit(compareVisitor, b.first); }), bufs.end());
+void Context::layerRecorded(Layer& layer,
+		const std::vector<const DeviceObject*>& old) {
+	std::lock_guard lock(layerMutex_);
+	unreferenceLayer(layer, old);
+	for(auto* obj : layer.refs_) {
+		layerRefs_[obj].push_back(&layer);
+	}
+}
 
-	// remove it from updateDevice_ vector
-	auto it = updateDevice_.begin();
-	auto eraseVisitor = [&](auto* ud) {
-		if(&obj == ud) {
-			updateDevice_.erase(it);
-			return true;
+// layerMutex_ must be locked
+void Context::unreferenceLayer(Layer& layer,
+		const std::vector<const DeviceObject*>& refs) {
+	for(auto* obj : refs) {
+		auto it = layerRefs_.find(obj);
+		if(it == layerRefs_.end()) {
+			continue; // destroyed in the meantime
 		}
 
-		return false;
-	};
+		auto& layers = it->second;
+		layers.erase(std::remove(layers.begin(), layers.end(), &layer),
+			layers.end());
+		if(layers.empty()) {
+			layerRefs_.erase(it);
+		}
+	}
+}
+
+void Context::addCachedGroup(CachedGroup& group) {
+	cachedGroups_.push_back(&group);
+}
+
+void Context::removeCachedGroup(CachedGroup& group) {
+	auto it = std::find(cachedGroups_.begin(), cachedGroups_.end(), &group);
+	dlg_assert(it != cachedGroups_.end());
+	cachedGroups_.erase(it);
+}
 
-	for(; it != updateDevice_.end(); ++it) {
-		if(std::visit(eraseVisitor, *it)) {
-			return true;
+void Context::registerUpdateDevice(DevRes res) {
+	std::lock_guard lock(updateMutex_);
+	auto& obj = *std::visit([](auto* o) -> DeviceObject* { return o; }, res);
+	if(obj.updateSlot_ == DeviceObject::noSlot) {
+		obj.updateSlot_ = updateDevice_.size();
+		updateDevice_.push_back(res);
+	}
+}
+
+bool Context::deviceObjectDestroyed(::rvg::DeviceObject& obj) noexcept {
+	if(damage_) {
+		damage_->destroyed(obj);
+	}
+
+	{
+		// layers using it are invalid now
+		std::lock_guard lock(layerMutex_);
+		auto it = layerRefs_.find(&obj);
+		if(it != layerRefs_.end()) {
+			for(auto* layer : it->second) {
+				layer->invalid_ = true;
+			}
+
+			layerRefs_.erase(it);
 		}
 	}
 
+	std::lock_guard lock(updateMutex_);
+	// drop its pending uploads since they might reference
+	// resources that just got destroyed.
+	if(obj.uploadFrame_ == frameCount_) {
+		currentFrame().owners[obj.uploadSlot_] = nullptr;
+	}
+
+	if(obj.updateSlot_ != DeviceObject::noSlot) {
+		updateDevice_[obj.updateSlot_] = {};
+		obj.updateSlot_ = DeviceObject::noSlot;
+		return true;
+	}
+
 	return false;
 }
 
 void Context::deviceObjectMoved(::rvg::DeviceObject& o,
 		::rvg::DeviceObject& n) noexcept {
+	if(damage_) {
+		damage_->moved(o, n);
+	}
 
-	auto it = updateDevice_.begin();
-
-	// move device object in currentFrame_.cmdBufs
-	for(auto& b : currentFrame_.cmdBufs) {
-		auto updateVisitor = [&](auto* ud) {
-			if(ud == &o) {
-				b.first = static_cast<decltype(ud)>(&n);
+	{
+		std::lock_guard lock(layerMutex_);
+		auto it = layerRefs_.find(&o);
+		if(it != layerRefs_.end()) {
+			auto layers = std::move(it->second);
+			layerRefs_.erase(it);
+			for(auto* layer : layers) {
+				layer->moved(o, n);
 			}
-		};
-
-		std::visit(updateVisitor, b.first);
-	}
 
-	// move it in updateDevice_
-	auto visitor = [&](auto* ud) {
-		if(&o == ud) {
-			updateDevice_.erase(it);
-			auto i = static_cast<decltype(ud)>(&n);
-			updateDevice_.insert(i);
-			return true;
+			layerRefs_[&n] = std::move(layers);
 		}
+	}
 
-		return false;
-	};
+	std::lock_guard lock(updateMutex_);
+	n.uploadFrame_ = o.uploadFrame_;
+	n.uploadSlot_ = o.uploadSlot_;
+	if(o.uploadFrame_ == frameCount_) {
+		currentFrame().owners[o.uploadSlot_] = &n;
+	}
 
-	for(; it != updateDevice_.end(); ++it) {
-		if(std::visit(visitor, *it)) {
-			return;
-		}
+	n.updateSlot_ = o.updateSlot_;
+	o.updateSlot_ = DeviceObject::noSlot;
+	if(n.updateSlot_ != DeviceObject::noSlot) {
+		auto& res = updateDevice_[n.updateSlot_];
+		std::visit([&](auto* ud) {
+			res = static_cast<decltype(ud)>(&n);
+		}, res);
 	}
 }
 
@@ -0,0 +1,463 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/damage.hpp>
+#include <rvg/context.hpp>
+#include <rvg/polygon.hpp>
+#include <rvg/text.hpp>
+#include <rvg/sdf.hpp>
+#include <rvg/shapeBatch.hpp>
+#include <rvg/spriteBatch.hpp>
+#include <rvg/state.hpp>
+#include <rvg/paint.hpp>
+#include <rvg/util.hpp>
+#include <vpp/vk.hpp>
+#include <nytl/matOps.hpp>
+#include <nytl/vecOps.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace rvg {
+namespace {
+
+constexpr Rect2f ndc = {-1.f, -1.f, 2.f, 2.f};
+
+bool uses(const DamageTracker::Draw& draw, const DeviceObject* state) {
+	return draw.transform == state || draw.scissor == state ||
+		draw.paint == state;
+}
+
+bool overlap(const Rect2f& a, const Rect2f& b) {
+	return a.position.x <= b.position.x + b.size.x &&
+		b.position.x <= a.position.x + a.size.x &&
+		a.position.y <= b.position.y + b.size.y &&
+		b.position.y <= a.position.y + a.size.y;
+}
+
+vk::Rect2D pixels(const Rect2f& rect, vk::Extent2D extent) {
+	auto w = float(extent.width);
+	auto h = float(extent.height);
+	auto x0 = std::floor(0.5f * (rect.position.x + 1.f) * w);
+	auto y0 = std::floor(0.5f * (rect.position.y + 1.f) * h);
+	auto x1 = std::ceil(0.5f * (rect.position.x + rect.size.x + 1.f) * w);
+	auto y1 = std::ceil(0.5f * (rect.position.y + rect.size.y + 1.f) * h);
+
+	x0 = std::clamp(x0, 0.f, w);
+	y0 = std::clamp(y0, 0.f, h);
+	x1 = std::clamp(x1, x0, w);
+	y1 = std::clamp(y1, y0, h);
+	return {{std::int32_t(x0), std::int32_t(y0)},
+		{std::uint32_t(x1 - x0), std::uint32_t(y1 - y0)}};
+}
+
+} // anon namespace
+
+DamageTracker::DamageTracker(Context& ctx) : context_(&ctx) {
+}
+
+DamageTracker::~DamageTracker() = default;
+
+Rect2f DamageTracker::bounds() const {
+	if(full_) {
+		return ndc;
+	}
+
+	Rect2f ret {};
+	for(auto& rect : rects_) {
+		ret = uniteRects(ret, rect);
+	}
+
+	return ret;
+}
+
+vk::Rect2D DamageTracker::scissor(vk::Extent2D extent) const {
+	if(idle()) {
+		return {};
+	}
+
+	return pixels(bounds(), extent);
+}
+
+std::vector<vk::Rect2D> DamageTracker::regions(vk::Extent2D extent) const {
+	if(full_) {
+		return {pixels(ndc, extent)};
+	}
+
+	std::vector<vk::Rect2D> ret;
+	ret.reserve(rects_.size());
+	for(auto& rect : rects_) {
+		ret.push_back(pixels(rect, extent));
+	}
+
+	return ret;
+}
+
+void DamageTracker::add(const Rect2f& rect) {
+	std::lock_guard lock(mutex_);
+	merge(rect);
+}
+
+void DamageTracker::addFull() {
+	std::lock_guard lock(mutex_);
+	full_ = true;
+	rects_.clear();
+}
+
+void DamageTracker::reset() {
+	std::lock_guard lock(mutex_);
+	full_ = false;
+	rects_.clear();
+}
+
+void DamageTracker::drawn(const Polygon& polygon, const Draw& draw) {
+	drawn(polygon, polygon.drawBounds(), draw);
+}
+
+void DamageTracker::drawn(const Text& text, const Draw& draw) {
+	drawn(text, text.drawBounds(), draw);
+}
+
+void DamageTracker::drawn(const SdfShape& shape, const Draw& draw) {
+	drawn(shape, shape.drawBounds(), draw);
+}
+
+void DamageTracker::drawn(const ShapeBatch& batch, const Draw& draw) {
+	drawn(batch, batch.drawBounds(), draw);
+}
+
+void DamageTracker::drawn(const SpriteBatch& batch, const Draw& draw) {
+	drawn(batch, batch.drawBounds(), draw);
+}
+
+void DamageTracker::drawn(const DeviceObject& obj, const Rect2f& bounds,
+		const Draw& draw) {
+	std::lock_guard lock(mutex_);
+	auto [it, created] = objects_.try_emplace(&obj);
+	auto& object = it->second;
+	if(created) {
+		object.bounds = bounds;
+	}
+
+	auto& draws = object.draws;
+	if(std::find(draws.begin(), draws.end(), draw) != draws.end()) {
+		return;
+	}
+
+	// users are only stored once per state
+	auto use = [&](const DeviceObject* state, auto&& init) {
+		if(!state) {
+			return;
+		}
+
+		auto [sit, screated] = states_.try_emplace(state);
+		if(screated) {
+			init(sit->second);
+		}
+
+		auto pred = [&](auto& d) { return uses(d, state); };
+		if(std::none_of(draws.begin(), draws.end(), pred)) {
+			sit->second.users.push_back(&obj);
+		}
+	};
+
+	auto& t = draw.transform;
+	auto& s = draw.scissor;
+	use(t, [&](State& state) { state.matrix = t->matrix(); });
+	use(s, [&](State& state) { state.rect = s->rect(); });
+	use(draw.paint, [](State&) {});
+
+	draws.push_back(draw);
+	damage(object.bounds, draw);
+}
+
+void DamageTracker::updated(const Polygon& polygon) {
+	updated(polygon, polygon.drawBounds());
+}
+
+void DamageTracker::updated(const Text& text) {
+	updated(text, text.drawBounds());
+}
+
+void DamageTracker::updated(const SdfShape& shape) {
+	updated(shape, shape.drawBounds());
+}
+
+void DamageTracker::updated(const ShapeBatch& batch) {
+	updated(batch, batch.drawBounds());
+}
+
+void DamageTracker::updated(const SpriteBatch& batch) {
+	updated(batch, batch.drawBounds());
+}
+
+void DamageTracker::updated(const Transform& transform) {
+	updatedState(transform, &transform.matrix(), nullptr);
+}
+
+void DamageTracker::updated(const Scissor& scissor) {
+	updatedState(scissor, nullptr, &scissor.rect());
+}
+
+void DamageTracker::updated(const Paint& paint) {
+	updatedState(paint, nullptr, nullptr);
+}
+
+void DamageTracker::updated(const Texture&) {
+	// we don't know which paints use it
+	addFull();
+}
+
+void DamageTracker::updated(const DeviceObject& obj, const Rect2f& bounds) {
+	std::lock_guard lock(mutex_);
+	auto it = objects_.find(&obj);
+	if(it == objects_.end()) {
+		return; // not drawn (yet)
+	}
+
+	// the previous and the new geometry
+	auto& object = it->second;
+	for(auto& draw : object.draws) {
+		damage(object.bounds, draw);
+	}
+
+	object.bounds = bounds;
+	for(auto& draw : object.draws) {
+		damage(object.bounds, draw);
+	}
+}
+
+void DamageTracker::updatedState(const DeviceObject& obj, const Mat4f* matrix,
+		const Rect2f* rect) {
+	std::lock_guard lock(mutex_);
+	auto it = states_.find(&obj);
+	if(it == states_.end()) {
+		return; // not used by any draw
+	}
+
+	auto& state = it->second;
+	auto damageUsers = [&]{
+		for(auto* user : state.users) {
+			// users might be outdated when a draw was removed
+			auto oit = objects_.find(user);
+			if(oit == objects_.end()) {
+				continue;
+			}
+
+			for(auto& draw : oit->second.draws) {
+				if(uses(draw, &obj)) {
+					damage(oit->second.bounds, draw);
+				}
+			}
+		}
+	};
+
+	// the draws before and after the change, a paint change
+	// doesn't move the draws
+	damageUsers();
+	if(matrix || rect) {
+		state.matrix = matrix ? *matrix : state.matrix;
+		state.rect = rect ? *rect : state.rect;
+		damageUsers();
+	}
+}
+
+void DamageTracker::redrawn(const DeviceObject& obj) {
+	std::lock_guard lock(mutex_);
+	auto it = objects_.find(&obj);
+	if(it != objects_.end()) {
+		for(auto& draw : it->second.draws) {
+			damage(it->second.bounds, draw);
+		}
+	}
+}
+
+void DamageTracker::destroyed(const DeviceObject& obj) {
+	std::lock_guard lock(mutex_);
+	if(auto it = objects_.find(&obj); it != objects_.end()) {
+		for(auto& draw : it->second.draws) {
+			damage(it->second.bounds, draw);
+			removeUser(draw.transform, obj);
+			removeUser(draw.scissor, obj);
+			removeUser(draw.paint, obj);
+		}
+
+		objects_.erase(it);
+	}
+
+	// the draws using it can't be recorded again like this
+	if(auto it = states_.find(&obj); it != states_.end()) {
+		for(auto* user : it->second.users) {
+			auto oit = objects_.find(user);
+			if(oit == objects_.end()) {
+				continue;
+			}
+
+			auto& object = oit->second;
+			for(auto& draw : object.draws) {
+				if(uses(draw, &obj)) {
+					damage(object.bounds, draw);
+				}
+			}
+
+			auto pred = [&](auto& d) { return uses(d, &obj); };
+			object.draws.erase(std::remove_if(object.draws.begin(),
+				object.draws.end(), pred), object.draws.end());
+		}
+
+		states_.erase(it);
+	}
+}
+
+void DamageTracker::moved(const DeviceObject& o, const DeviceObject& n) {
+	std::lock_guard lock(mutex_);
+	if(auto node = objects_.extract(&o); node) {
+		auto replace = [&](const DeviceObject* state) {
+			if(auto sit = states_.find(state); sit != states_.end()) {
+				auto& users = sit->second.users;
+				std::replace(users.begin(), users.end(), &o, &n);
+			}
+		};
+
+		for(auto& draw : node.mapped().draws) {
+			replace(draw.transform);
+			replace(draw.scissor);
+			replace(draw.paint);
+		}
+
+		node.key() = &n;
+		objects_.insert(std::move(node));
+	}
+
+	if(auto node = states_.extract(&o); node) {
+		for(auto* user : node.mapped().users) {
+			auto oit = objects_.find(user);
+			if(oit == objects_.end()) {
+				continue;
+			}
+
+			for(auto& draw : oit->second.draws) {
+				if(draw.transform == &o) {
+					draw.transform = static_cast<const Transform*>(&n);
+				} else if(draw.scissor == &o) {
+					draw.scissor = static_cast<const Scissor*>(&n);
+				} else if(draw.paint == &o) {
+					draw.paint = static_cast<const Paint*>(&n);
+				}
+			}
+		}
+
+		node.key() = &n;
+		states_.insert(std::move(node));
+	}
+}
+
+// mutex_ must be locked
+void DamageTracker::removeUser(const DeviceObject* state,
+		const DeviceObject& user) {
+	if(!state) {
+		return;
+	}
+
+	auto it = states_.find(state);
+	if(it != states_.end()) {
+		auto& users = it->second.users;
+		users.erase(std::remove(users.begin(), users.end(), &user),
+			users.end());
+	}
+}
+
+// mutex_ must be locked
+void DamageTracker::damage(const Rect2f& bounds, const Draw& draw) {
+	if(full_ || isEmpty(bounds)) {
+		return;
+	}
+
+	// the scissor is applied before the transform
+	auto rect = bounds;
+	if(draw.scissor) {
+		auto it = states_.find(draw.scissor);
+		dlg_assert(it != states_.end());
+		rect = intersectRects(rect, it->second.rect);
+		if(isEmpty(rect)) {
+			return;
+		}
+	}
+
+	if(!draw.transform) {
+		merge(rect);
+		return;
+	}
+
+	auto it = states_.find(draw.transform);
+	dlg_assert(it != states_.end());
+	auto& mat = it->second.matrix;
+
+	Vec2f min {1e30f, 1e30f};
+	Vec2f max {-1e30f, -1e30f};
+	auto x = rect.position.x;
+	auto y = rect.position.y;
+	auto w = rect.size.x;
+	auto h = rect.size.y;
+	for(auto p : {Vec2f{x, y}, Vec2f{x + w, y}, Vec2f{x, y + h},
+			Vec2f{x + w, y + h}}) {
+		auto t = mat * Vec4f{p[0], p[1], 0.f, 1.f};
+		if(t[3] <= 0.f) {
+			// behind the viewer, can't be bounded
+			merge(ndc);
+			return;
+		}
+
+		for(auto i = 0u; i < 2; ++i) {
+			min[i] = std::min(min[i], t[i] / t[3]);
+			max[i] = std::max(max[i], t[i] / t[3]);
+		}
+	}
+
+	merge({min, max - min});
+}
+
+// mutex_ must be locked
+void DamageTracker::merge(Rect2f rect) {
+	if(full_) {
+		return;
+	}
+
+	rect = intersectRects(rect, ndc);
+	if(isEmpty(rect)) {
+		return;
+	}
+
+	// merge with all overlapping rects, the result might overlap others
+	auto merged = true;
+	while(merged) {
+		merged = false;
+		for(auto it = rects_.begin(); it != rects_.end(); ++it) {
+			if(overlap(*it, rect)) {
+				rect = uniteRects(rect, *it);
+				rects_.erase(it);
+				merged = true;
+				break;
+			}
+		}
+	}
+
+	rects_.push_back(rect);
+	if(rects_.size() > maxRects) {
+		rect = {};
+		for(auto& r : rects_) {
+			rect = uniteRects(rect, r);
+		}
+
+		rects_ = {rect};
+	}
+
+	if(rects_.size() == 1 && rects_[0].size.x >= 2.f &&
+			rects_[0].size.y >= 2.f) {
+		full_ = true;
+		rects_.clear();
+	}
+}
+
+} // namespace rvg
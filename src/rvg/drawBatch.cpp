@@ -0,0 +1,293 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/drawBatch.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/util.hpp>
+#include <vpp/vk.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+
+namespace rvg {
+
+constexpr auto cmdSize = sizeof(vk::DrawIndirectCommand);
+
+DrawBatch::DrawBatch(Context& ctx, DrawType type, bool deviceLocal) :
+		DeviceObject(ctx), type_(type), deviceLocal_(deviceLocal) {
+	dlg_assertm(type != DrawType::strokeFill,
+		"DrawBatch can either fill or stroke");
+}
+
+DrawBatch::~DrawBatch() {
+	for(auto* polygon : polygons_) {
+		polygon->batch_ = nullptr;
+	}
+
+	// pending frames might still read the commands
+	if(valid()) {
+		context().keepAlive(std::move(commands_));
+	}
+}
+
+DrawBatch::DrawBatch(DrawBatch&& rhs) noexcept :
+		DeviceObject(std::move(rhs)) {
+	type_ = rhs.type_;
+	deviceLocal_ = rhs.deviceLocal_;
+	dirty_ = rhs.dirty_;
+	polygons_ = std::move(rhs.polygons_);
+	runs_ = std::move(rhs.runs_);
+	commands_ = std::move(rhs.commands_);
+
+	for(auto* polygon : polygons_) {
+		polygon->batch_ = this;
+	}
+}
+
+DrawBatch& DrawBatch::operator=(DrawBatch&& rhs) noexcept {
+	for(auto* polygon : polygons_) {
+		polygon->batch_ = nullptr;
+	}
+
+	if(valid()) {
+		context().keepAlive(std::move(commands_));
+	}
+
+	DeviceObject::operator=(std::move(rhs));
+	type_ = rhs.type_;
+	deviceLocal_ = rhs.deviceLocal_;
+	dirty_ = rhs.dirty_;
+	polygons_ = std::move(rhs.polygons_);
+	runs_ = std::move(rhs.runs_);
+	commands_ = std::move(rhs.commands_);
+	rhs.polygons_.clear();
+
+	for(auto* polygon : polygons_) {
+		polygon->batch_ = this;
+	}
+
+	return *this;
+}
+
+void DrawBatch::add(Polygon& polygon) {
+	dlg_assert(valid() && polygon.valid());
+	dlg_assertm(!polygon.batch_, "Polygon is already part of a batch");
+	dlg_assert(&polygon.context() == &context());
+
+	polygon.batch_ = this;
+	polygon.batchIndex_ = polygons_.size();
+	polygons_.push_back(&polygon);
+	invalidate();
+}
+
+void DrawBatch::remove(Polygon& polygon) {
+	dlg_assert(polygon.batch_ == this);
+	auto i = polygon.batchIndex_;
+	dlg_assert(i < polygons_.size() && polygons_[i] == &polygon);
+
+	// keep the draw order of the others
+	polygons_.erase(polygons_.begin() + i);
+	for(auto j = i; j < polygons_.size(); ++j) {
+		polygons_[j]->batchIndex_ = j;
+	}
+
+	polygon.batch_ = nullptr;
+	invalidate();
+}
+
+void DrawBatch::moved(const Polygon& o, Polygon& n) noexcept {
+	dlg_assert(o.batchIndex_ < polygons_.size());
+	dlg_assert(polygons_[o.batchIndex_] == &o);
+	polygons_[o.batchIndex_] = &n;
+}
+
+void DrawBatch::invalidate() {
+	dirty_ = true;
+	context().registerUpdateDevice(this);
+}
+
+const VertexRange& DrawBatch::vertices(const Polygon& polygon) const {
+	return (type_ == DrawType::fill) ?
+		polygon.fill_.vertices :
+		polygon.stroke_.vertices;
+}
+
+std::pair<vk::Buffer, vk::DeviceSize> DrawBatch::binding(
+		const Polygon& polygon) const {
+	// polygons without vertices (not updated yet or not using the
+	// draw type of the batch) can be part of any run
+	auto& v = vertices(polygon);
+	if(!v.valid()) {
+		return {};
+	}
+
+	return {v.buffer(), v.streamOffset(VertexStream::position)};
+}
+
+vk::DrawIndirectCommand DrawBatch::command(const Polygon& polygon) const {
+	auto fill = (type_ == DrawType::fill);
+	auto& draw = fill ? polygon.fill_ : polygon.stroke_;
+	auto disabled = fill ?
+		(!polygon.flags_.fill || polygon.flags_.disableFill) :
+		(!polygon.flags_.stroke || polygon.flags_.disableStroke);
+
+	dlg_assertm(disabled || (fill ?
+			!polygon.flags_.aaFill && !polygon.flags_.colorFill :
+			!polygon.flags_.aaStroke && !polygon.flags_.colorStroke),
+		"DrawBatch doesn't support anti aliasing or per-point color");
+
+	// The position stream of the block is bound, see VertexRange
+	vk::DrawIndirectCommand cmd {};
+	cmd.instanceCount = 1;
+	if(!disabled && draw.vertices.valid() && draw.vertices.size()) {
+		cmd.vertexCount = draw.points.size();
+		cmd.firstVertex = draw.vertices.first();
+	}
+
+	return cmd;
+}
+
+void DrawBatch::updated(const Polygon& polygon) {
+	if(dirty_) {
+		return; // everything is written in updateDevice anyway
+	}
+
+	// moving to another block changes the runs, needs a rerecord
+	auto i = polygon.batchIndex_;
+	auto run = std::find_if(runs_.begin(), runs_.end(), [&](auto& r) {
+		return r.first <= i && i < r.first + r.count;
+	});
+
+	auto bind = binding(polygon);
+	auto hasVertices = (bind.first != vk::Buffer {});
+	if(run == runs_.end() || (hasVertices && run->binding != bind)) {
+		invalidate();
+		return;
+	}
+
+	auto cmd = command(polygon);
+	auto span = vpp::BufferSpan(commands_.buffer(),
+		{commands_.offset() + i * cmdSize, cmdSize});
+	upload140(*this, span, raw(cmd));
+}
+
+bool DrawBatch::updateDevice() {
+	dlg_assert(valid());
+	if(!dirty_) {
+		return false;
+	}
+
+	dirty_ = false;
+	auto rerecord = false;
+
+	// group consecutive polygons with vertices in the same block into
+	// runs. Polygons are not reordered since they might overlap.
+	std::vector<Run> runs;
+	std::vector<vk::DrawIndirectCommand> cmds;
+	cmds.reserve(polygons_.size());
+	for(auto i = 0u; i < polygons_.size(); ++i) {
+		auto& polygon = *polygons_[i];
+		polygon.batchIndex_ = i;
+		cmds.push_back(command(polygon));
+
+		// polygons without vertices join any run, a run of only
+		// such polygons takes the binding of the next one
+		auto bind = binding(polygon);
+		auto hasVertices = (bind.first != vk::Buffer {});
+		if(runs.empty()) {
+			runs.push_back({bind, i, 0u});
+		} else if(hasVertices && runs.back().binding != bind) {
+			if(runs.back().binding.first != vk::Buffer {}) {
+				runs.push_back({bind, i, 0u});
+			} else {
+				runs.back().binding = bind;
+			}
+		}
+
+		++runs.back().count;
+	}
+
+	auto sameRun = [](const Run& a, const Run& b) {
+		return a.binding == b.binding && a.first == b.first &&
+			a.count == b.count;
+	};
+
+	if(!std::equal(runs.begin(), runs.end(), runs_.begin(), runs_.end(),
+			sameRun)) {
+		runs_ = std::move(runs);
+		context().rerecordCause(*this, "DrawBatch: runs changed");
+		rerecord = true;
+	}
+
+	auto needed = std::max<vk::DeviceSize>(cmds.size() * cmdSize, cmdSize);
+	if(commands_.size() < needed) {
+		auto usage = nytl::Flags {vk::BufferUsageBits::indirectBuffer};
+		if(deviceLocal_ || !context().directWrites()) {
+			usage |= vk::BufferUsageBits::transferDst;
+		}
+
+		auto memBits = deviceLocal_ ?
+			context().device().deviceMemoryTypes() :
+			context().device().hostMemoryTypes();
+		context().keepAlive(std::move(commands_));
+		commands_ = {context().bufferAllocator(), 2 * needed, usage, 4u,
+			memBits};
+		context().rerecordCause(*this, "DrawBatch: commands buffer grew");
+		rerecord = true;
+	}
+
+	if(!cmds.empty()) {
+		upload140(*this, commands_, raw(*cmds.data(), cmds.size()));
+	}
+
+	return rerecord;
+}
+
+void DrawBatch::draw(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	draw(rec);
+}
+
+void DrawBatch::draw(Recorder& rec) const {
+	dlg_assert(valid());
+	rec.use(*this);
+	for(auto* polygon : polygons_) {
+		rec.use(*polygon);
+	}
+
+	if(runs_.empty()) {
+		return;
+	}
+
+	auto& ctx = context();
+	auto fill = (type_ == DrawType::fill);
+	rec.category(fill ? DrawCategory::fill : DrawCategory::stroke);
+	rec.bindPipeline(fill ?
+		vk::PrimitiveTopology::triangleFan :
+		vk::PrimitiveTopology::triangleStrip,
+		Context::drawTypeDefault);
+
+	auto multiDraw = ctx.settings().multiDrawIndirect;
+	for(auto& run : runs_) {
+		// only polygons without vertices, nothing to draw
+		auto [b, o] = run.binding;
+		if(b == vk::Buffer {}) {
+			continue;
+		}
+
+		// position buffer also serves as dummy uv and color buffer
+		rec.bindVertexBuffers({b, b, b}, {o, o, o});
+
+		auto off = commands_.offset() + run.first * cmdSize;
+		if(multiDraw) {
+			rec.drawIndirect(commands_.buffer(), off, run.count, cmdSize);
+		} else {
+			for(auto i = 0u; i < run.count; ++i) {
+				rec.drawIndirect(commands_.buffer(), off + i * cmdSize, 1, 0);
+			}
+		}
+	}
+}
+
+} // namespace rvg
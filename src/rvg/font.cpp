@@ -5,6 +5,7 @@
 #include <rvg/font.hpp>
 #include <rvg/context.hpp>
 #include <rvg/text.hpp>
+#include <rvg/tracing.hpp>
 #include <vpp/vk.hpp>
 #include <vpp/imageOps.hpp>
 #include <vpp/formats.hpp>
@@ -27,11 +28,16 @@ FontAtlas::FontAtlas(Context& ctx) : DeviceObject(ctx) {
 	params.height = 512;
 
 	ctx_ = fonsCreateInternal(&params);
-	ds_ = {ctx.dsAllocator(), ctx.dsLayoutFontAtlas()};
+	if(!ctx.bindless()) {
+		ds_ = {ctx.dsAllocator(), ctx.dsLayoutFontAtlas()};
+	}
 }
 
 FontAtlas::~FontAtlas() {
 	fonsDeleteInternal(ctx_);
+
+	// pending frames might still use it, the texture retires itself
+	context().keepAlive(std::move(ds_));
 }
 
 void FontAtlas::validate() {
@@ -44,6 +50,7 @@ void FontAtlas::validate() {
 
 void FontAtlas::expand() {
 	constexpr auto maxSize = 2048;
+	RVG_TRACE_EVENT("FontAtlas::expand", "FontAtlas");
 
 	int w, h;
 	fonsGetAtlasSize(ctx_, &w, &h);
@@ -57,7 +64,8 @@ void FontAtlas::expand() {
 	fonsResetAtlas(ctx_, w, h);
 	for(auto& t : texts_) {
 		dlg_assert(t);
-		t->update();
+		t->layout();
+		context().registerUpdateDevice(t);
 	}
 
 	context().registerUpdateDevice(this);
@@ -82,6 +90,7 @@ void FontAtlas::moved(Text& t, Text& tn) noexcept {
 
 bool FontAtlas::updateDevice() {
 	dlg_assert(valid());
+	RVG_TRACE_EVENT("FontAtlas::updateDevice", "FontAtlas");
 	auto& ctx = context();
 	bool rerecord = false;
 
@@ -96,9 +105,22 @@ bool FontAtlas::updateDevice() {
 	auto dptr = reinterpret_cast<const std::byte*>(data);
 	auto dsize = fs.x * fs.y;
 	if(fs != texture_.size()) {
+		// old texture and descriptor might still be used by pending frames
+		ctx.keepAlive(std::move(texture_));
 		texture_ = {ctx, fs, {dptr, dsize}, rvg::TextureType::a8};
+		ctx.rerecordCause(*this, "FontAtlas: texture size changed");
 		rerecord = true;
+		RVG_TRACE_RERECORD(rerecord);
 
+		if(ctx.bindless()) {
+			ctx.keepAlive(std::move(texSlot_));
+			texSlot_ = ctx.bindlessTextures().allocate(
+				texture_.vkImageView());
+			return rerecord;
+		}
+
+		ctx.keepAlive(std::move(ds_));
+		ds_ = {ctx.dsAllocator(), ctx.dsLayoutFontAtlas()};
 		vpp::DescriptorSetUpdate update(ds_);
 		update.imageSampler({{{}, texture_.vkImageView(),
 			vk::ImageLayout::shaderReadOnlyOptimal}});
@@ -144,12 +166,7 @@ Font::Font(Context& ctx, std::vector<std::byte> blob) :
 
 nytl::Rect2f Font::bounds(std::string_view text, unsigned height) const {
 	dlg_assert(id_ != FONS_INVALID);
-	float bounds[4];
-
-	fonsSetFont(atlas().stash(), id_);
-	fonsSetSize(atlas().stash(), height);
-	fonsTextBounds(atlas().stash(), 0, 0, text.begin(), text.end(), bounds);
-	return {bounds[0], bounds[1], bounds[2] - bounds[0], bounds[3] - bounds[1]};
+	return textBounds(*atlas().stash(), id_, height, text);
 }
 
 float Font::width(std::string_view text, unsigned height) const {
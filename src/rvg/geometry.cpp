@@ -0,0 +1,445 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/geometry.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/util.hpp>
+#include <vpp/vk.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+
+namespace rvg {
+
+// GeometryRange
+void GeometryRange::reset() {
+	if(arena_) {
+		auto base = arena_->blocks_[block_]->buffer.offset();
+		arena_->free(block_, span_.offset() - base, span_.size());
+		arena_ = {};
+		span_ = {};
+	}
+}
+
+void swap(GeometryRange& a, GeometryRange& b) noexcept {
+	using std::swap;
+	swap(a.arena_, b.arena_);
+	swap(a.block_, b.block_);
+	swap(a.span_, b.span_);
+}
+
+// VertexRange
+void VertexRange::reset() {
+	if(arena_) {
+		arena_->free(block_, first_, size_);
+		arena_ = {};
+		first_ = size_ = 0u;
+	}
+}
+
+vk::Buffer VertexRange::buffer() const {
+	dlg_assert(arena_);
+	return arena_->blocks_[block_]->buffer.buffer();
+}
+
+vk::DeviceSize VertexRange::streamOffset(VertexStream stream) const {
+	dlg_assert(arena_);
+	return arena_->streamOffset(*arena_->blocks_[block_], stream);
+}
+
+vpp::BufferSpan VertexRange::stream(VertexStream stream) const {
+	dlg_assert(arena_);
+	auto& block = *arena_->blocks_[block_];
+	auto stride = GeometryArena::stride(stream);
+	auto off = arena_->streamOffset(block, stream) + first_ * stride;
+	return {block.buffer.buffer(), {off, size_ * stride}};
+}
+
+void swap(VertexRange& a, VertexRange& b) noexcept {
+	using std::swap;
+	swap(a.arena_, b.arena_);
+	swap(a.block_, b.block_);
+	swap(a.first_, b.first_);
+	swap(a.size_, b.size_);
+}
+
+// InstanceBuffer
+InstanceBuffer::InstanceBuffer(Context& ctx, vk::DeviceSize instanceSize,
+		bool deviceLocal) : arena_(&ctx.geometryArena()),
+			instanceSize_(instanceSize), deviceLocal_(deviceLocal) {
+	constexpr auto initialCapacity = 16u; // in instances
+	buffer_ = arena_->allocate(initialCapacity * instanceSize, deviceLocal,
+		4u);
+	cmd_ = arena_->allocate(sizeof(vk::DrawIndirectCommand), deviceLocal, 4u);
+	countChanged_ = true;
+}
+
+void InstanceBuffer::changed(unsigned first, unsigned count) {
+	if(!count) {
+		return;
+	}
+
+	if(dirtyBegin_ == dirtyEnd_) {
+		dirtyBegin_ = first;
+		dirtyEnd_ = first + count;
+	} else {
+		dirtyBegin_ = std::min(dirtyBegin_, first);
+		dirtyEnd_ = std::max(dirtyEnd_, first + count);
+	}
+}
+
+void InstanceBuffer::resized(unsigned old, unsigned count) {
+	dirtyEnd_ = std::min(dirtyEnd_, count);
+	dirtyBegin_ = std::min(dirtyBegin_, dirtyEnd_);
+	countChanged_ = true;
+	changed(old, count > old ? count - old : 0u);
+}
+
+bool InstanceBuffer::reserve(unsigned count) {
+	dlg_assert(valid());
+	auto needed = count * instanceSize_;
+	if(buffer_.size() >= needed) {
+		return false;
+	}
+
+	// the buffer is bound at its offset, so a new offset needs a
+	// rerecord as well.
+	// Assigning retires the old range, pending frames might still read it
+	auto old = buffer_.buffer().vkHandle();
+	auto oldOffset = buffer_.offset();
+	buffer_ = arena_->allocate(2 * needed, deviceLocal_, 4u);
+
+	dirtyBegin_ = 0u;
+	dirtyEnd_ = count;
+	countChanged_ = true;
+	return buffer_.buffer().vkHandle() != old ||
+		buffer_.offset() != oldOffset;
+}
+
+void InstanceBuffer::upload(DeviceObject& owner, unsigned count,
+		Span<const std::byte> instances) {
+	dlg_assert(valid() && count * instanceSize_ <= buffer_.size());
+	dlg_assert(instances.size() == (dirtyEnd_ - dirtyBegin_) * instanceSize_);
+	if(dirtyBegin_ < dirtyEnd_) {
+		auto span = vpp::BufferSpan(buffer_.buffer(),
+			{buffer_.offset() + dirtyBegin_ * instanceSize_,
+			vk::DeviceSize(instances.size())});
+		upload140(owner, span, raw(*instances.data(), instances.size()));
+	}
+
+	if(countChanged_) {
+		vk::DrawIndirectCommand cmd {};
+		cmd.vertexCount = 4u;
+		cmd.instanceCount = count;
+		cmd.firstInstance = 0u; // nonzero needs drawIndirectFirstInstance
+		upload140(owner, cmd_.span(), raw(cmd));
+	}
+
+	dirtyBegin_ = dirtyEnd_ = 0u;
+	countChanged_ = false;
+}
+
+void InstanceBuffer::draw(Recorder& rec) const {
+	dlg_assert(valid());
+
+	// Only binding 0 is used, the others are dummies (see SdfShape::draw)
+	auto buf = buffer_.buffer().vkHandle();
+	auto off = buffer_.offset();
+	rec.bindVertexBuffers({buf, buf, buf}, {off, off, off});
+	rec.drawIndirect(cmd_.buffer(), cmd_.offset(), 1, 0);
+}
+
+// GeometryArena
+vk::DeviceSize GeometryArena::stride(VertexStream stream) {
+	return (stream == VertexStream::color) ? 4u : 8u;
+}
+
+vk::DeviceSize GeometryArena::stride(VertexFormat format) {
+	auto f = unsigned(format);
+	return stride(VertexStream::position) +
+		((f & 1u) ? stride(VertexStream::aux) : 0u) +
+		((f & 2u) ? stride(VertexStream::color) : 0u);
+}
+
+GeometryArena::GeometryArena(Context& ctx) : context_(&ctx) {
+}
+
+GeometryArena::~GeometryArena() = default;
+
+unsigned GeometryArena::createBlock(vk::DeviceSize capacity, bool deviceLocal,
+		bool vertices, VertexFormat format) {
+	auto& ctx = context();
+	auto& dev = ctx.device();
+	auto usage = vertices ?
+		nytl::Flags {vk::BufferUsageBits::vertexBuffer} :
+		vk::BufferUsageBits::indirectBuffer |
+			vk::BufferUsageBits::uniformBuffer |
+			vk::BufferUsageBits::vertexBuffer; // instance data
+	if(deviceLocal || !ctx.directWrites()) {
+		usage |= vk::BufferUsageBits::transferDst;
+	}
+
+	auto memBits = deviceLocal ?
+		dev.deviceMemoryTypes() :
+		dev.hostMemoryTypes();
+	auto uboAlign = dev.properties().limits.minUniformBufferOffsetAlignment;
+	auto align = std::max<vk::DeviceSize>(uboAlign, 16u);
+	auto size = vertices ? capacity * stride(format) : capacity;
+
+	auto block = std::make_unique<Block>();
+	block->buffer = {ctx.bufferAllocator(), size, usage, unsigned(align),
+		memBits};
+	block->deviceLocal = deviceLocal;
+	block->vertices = vertices;
+	block->format = format;
+	block->capacity = capacity;
+	block->free.emplace(0u, capacity);
+
+	auto it = std::find(blocks_.begin(), blocks_.end(), nullptr);
+	if(it == blocks_.end()) {
+		it = blocks_.emplace(blocks_.end());
+	}
+
+	*it = std::move(block);
+	return unsigned(it - blocks_.begin());
+}
+
+vk::DeviceSize GeometryArena::streamOffset(const Block& block,
+		VertexStream stream) const {
+	dlg_assert(block.vertices);
+
+	// the streams are stored one after another
+	auto f = unsigned(block.format);
+	auto off = block.buffer.offset();
+	auto pos = stride(VertexStream::position);
+	switch(stream) {
+		case VertexStream::position:
+			return off;
+		case VertexStream::aux:
+			return (f & 1u) ? off + block.capacity * pos : off;
+		case VertexStream::color:
+			if(!(f & 2u)) {
+				return off;
+			}
+
+			return off + block.capacity * (pos +
+				((f & 1u) ? stride(VertexStream::aux) : 0u));
+	}
+
+	return off;
+}
+
+GeometryRange GeometryArena::allocate(vk::DeviceSize size, bool deviceLocal,
+		vk::DeviceSize align) {
+	constexpr auto granularity = vk::DeviceSize(16u);
+	size = std::max(size, granularity);
+	size = (size + granularity - 1) & ~(granularity - 1);
+
+	auto set = [&](unsigned id, vk::DeviceSize off) {
+		auto& block = *blocks_[id];
+		GeometryRange ret;
+		ret.arena_ = this;
+		ret.block_ = id;
+		ret.span_ = vpp::BufferSpan(block.buffer.buffer(),
+			{block.buffer.offset() + off, size});
+		return ret;
+	};
+
+	vk::DeviceSize off;
+	for(auto i = 0u; i < blocks_.size(); ++i) {
+		auto& block = blocks_[i];
+		if(block && !block->vertices && block->deviceLocal == deviceLocal &&
+				allocate(i, size, align, off)) {
+			return set(i, off);
+		}
+	}
+
+	// no space left, create a new block
+	auto capacity = std::max(smallBlockSize, size + align);
+	auto id = createBlock(capacity, deviceLocal, false, {});
+	auto success = allocate(id, size, align, off);
+	dlg_assert(success);
+	return set(id, off);
+}
+
+bool GeometryArena::resize(VertexRange& range, unsigned count,
+		VertexFormat format, bool deviceLocal) {
+	dlg_assert(!range.arena_ || range.arena_ == this);
+	count = std::max(count, 1u);
+
+	auto fits = [&](const Block& block) {
+		return block.vertices && block.format == format &&
+			block.deviceLocal == deviceLocal;
+	};
+
+	auto set = [&](unsigned id, vk::DeviceSize first, unsigned size) {
+		VertexRange ret;
+		ret.arena_ = this;
+		ret.block_ = id;
+		ret.first_ = unsigned(first);
+		ret.size_ = size;
+		return ret;
+	};
+
+	vk::DeviceSize first;
+	auto prevBlock = range.arena_ ? int(range.block_) : -1;
+	if(range.arena_ && fits(*blocks_[range.block_])) {
+		if(range.size() >= count) {
+			return false;
+		}
+
+		// try to grow into the free range directly after it
+		auto& block = *blocks_[range.block_];
+		auto end = range.first() + range.size();
+		auto extra = count - range.size();
+		auto it = block.free.find(end);
+		if(it != block.free.end() && it->second >= extra) {
+			auto fsize = it->second;
+			block.free.erase(it);
+			if(fsize > extra) {
+				block.free.emplace(end + extra, fsize - extra);
+			}
+
+			block.used += extra;
+			range.size_ = count;
+			return false;
+		}
+
+		// some headroom for ranges that keep growing
+		count += count / 4;
+
+		// moving inside the block only changes the first vertex.
+		// Pending frames might still read the old range, it is retired
+		// (see free) and can therefore not overlap the new one.
+		auto id = range.block_;
+		range.reset();
+		if(allocate(id, count, 1u, first)) {
+			range = set(id, first, count);
+			return false;
+		}
+	}
+
+	range.reset();
+	for(auto i = 0u; i < blocks_.size(); ++i) {
+		auto& block = blocks_[i];
+		if(block && fits(*block) && allocate(i, count, 1u, first)) {
+			range = set(i, first, count);
+			return int(i) != prevBlock;
+		}
+	}
+
+	// no space left, create a new block
+	auto capacity = std::max<vk::DeviceSize>(blockSize / stride(format),
+		2 * count);
+	auto id = createBlock(capacity, deviceLocal, true, format);
+	auto success = allocate(id, count, 1u, first);
+	dlg_assert(success);
+	range = set(id, first, count);
+	return true;
+}
+
+bool GeometryArena::allocate(unsigned id, vk::DeviceSize size,
+		vk::DeviceSize align, vk::DeviceSize& offset) {
+	// first fit, byte offsets are aligned in the vulkan buffer
+	auto& block = *blocks_[id];
+	auto base = block.vertices ? vk::DeviceSize(0u) : block.buffer.offset();
+	for(auto it = block.free.begin(); it != block.free.end(); ++it) {
+		auto [off, fsize] = *it;
+		auto aligned = ((base + off + align - 1) / align) * align - base;
+		auto pad = aligned - off;
+		if(pad + size > fsize) {
+			continue;
+		}
+
+		block.free.erase(it);
+		if(pad) {
+			block.free.emplace(off, pad);
+		}
+
+		if(auto rest = fsize - pad - size; rest) {
+			block.free.emplace(aligned + size, rest);
+		}
+
+		block.used += size;
+		offset = aligned;
+		return true;
+	}
+
+	return false;
+}
+
+void GeometryArena::free(unsigned id, vk::DeviceSize offset,
+		vk::DeviceSize size) {
+	// pending frames might still read from it
+	dlg_assert(id < blocks_.size() && blocks_[id]);
+	context().retireRange(id, offset, size);
+}
+
+void GeometryArena::release(unsigned id, vk::DeviceSize offset,
+		vk::DeviceSize size) {
+	dlg_assert(id < blocks_.size() && blocks_[id]);
+	auto& block = *blocks_[id];
+	dlg_assert(block.used >= size);
+	block.used -= size;
+
+	// merge with the neighbors
+	auto next = block.free.lower_bound(offset);
+	if(next != block.free.end() && next->first == offset + size) {
+		size += next->second;
+		next = block.free.erase(next);
+	}
+
+	if(next != block.free.begin()) {
+		auto prev = std::prev(next);
+		if(prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+
+	block.free.emplace(offset, size);
+}
+
+void GeometryArena::trim() {
+	// keep one empty block for each kind of block and memory
+	bool keep[2][5] {};
+	for(auto& block : blocks_) {
+		if(!block || block->used) {
+			continue;
+		}
+
+		auto kind = block->vertices ? 1u + unsigned(block->format) : 0u;
+		if(!keep[block->deviceLocal][kind]) {
+			keep[block->deviceLocal][kind] = true;
+			continue;
+		}
+
+		// pending frames might still read from it
+		context().keepAlive(std::move(block->buffer));
+		block.reset();
+	}
+}
+
+vk::DeviceSize GeometryArena::used() const {
+	vk::DeviceSize ret {};
+	for(auto& block : blocks_) {
+		if(block) {
+			auto unit = block->vertices ? stride(block->format) : 1u;
+			ret += block->used * unit;
+		}
+	}
+
+	return ret;
+}
+
+vk::DeviceSize GeometryArena::capacity() const {
+	vk::DeviceSize ret {};
+	for(auto& block : blocks_) {
+		ret += block ? block->buffer.size() : 0u;
+	}
+
+	return ret;
+}
+
+} // namespace rvg
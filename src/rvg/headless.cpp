@@ -0,0 +1,130 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/headless.hpp>
+#include <vpp/vk.hpp>
+#include <vpp/imageOps.hpp>
+#include <vpp/formats.hpp>
+#include <dlg/dlg.hpp>
+#include <array>
+
+namespace rvg {
+namespace {
+
+vpp::RenderPass createRenderPass(const vpp::Device& dev, vk::Format format) {
+	vk::AttachmentDescription attachment;
+	attachment.format = format;
+	attachment.samples = vk::SampleCountBits::e1;
+	attachment.loadOp = vk::AttachmentLoadOp::clear;
+	attachment.storeOp = vk::AttachmentStoreOp::store;
+	attachment.stencilLoadOp = vk::AttachmentLoadOp::dontCare;
+	attachment.stencilStoreOp = vk::AttachmentStoreOp::dontCare;
+	attachment.initialLayout = vk::ImageLayout::undefined;
+	attachment.finalLayout = vk::ImageLayout::transferSrcOptimal;
+
+	vk::AttachmentReference colorReference;
+	colorReference.attachment = 0;
+	colorReference.layout = vk::ImageLayout::colorAttachmentOptimal;
+
+	vk::SubpassDescription subpass;
+	subpass.pipelineBindPoint = vk::PipelineBindPoint::graphics;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorReference;
+
+	// the previous frame might still be read (write-after-read),
+	// the image is read after rendering
+	std::array<vk::SubpassDependency, 2> dependencies;
+	dependencies[0].srcSubpass = vk::subpassExternal;
+	dependencies[0].dstSubpass = 0u;
+	dependencies[0].srcStageMask = vk::PipelineStageBits::transfer;
+	dependencies[0].dstStageMask =
+		vk::PipelineStageBits::colorAttachmentOutput;
+	dependencies[0].dstAccessMask = vk::AccessBits::colorAttachmentWrite;
+
+	dependencies[1].srcSubpass = 0u;
+	dependencies[1].dstSubpass = vk::subpassExternal;
+	dependencies[1].srcStageMask =
+		vk::PipelineStageBits::colorAttachmentOutput;
+	dependencies[1].srcAccessMask = vk::AccessBits::colorAttachmentWrite;
+	dependencies[1].dstStageMask = vk::PipelineStageBits::transfer;
+	dependencies[1].dstAccessMask = vk::AccessBits::transferRead;
+
+	vk::RenderPassCreateInfo info;
+	info.attachmentCount = 1;
+	info.pAttachments = &attachment;
+	info.subpassCount = 1;
+	info.pSubpasses = &subpass;
+	info.dependencyCount = dependencies.size();
+	info.pDependencies = dependencies.data();
+
+	return {dev, info};
+}
+
+} // anon namespace
+
+HeadlessTarget::HeadlessTarget(const vpp::Device& dev, Vec2ui size,
+		vk::Format format) : device_(&dev), size_(size), format_(format) {
+	dlg_assert(size.x > 0 && size.y > 0);
+
+	rp_ = createRenderPass(dev, format);
+
+	auto usage = vk::ImageUsageBits::colorAttachment |
+		vk::ImageUsageBits::transferSrc;
+	auto extent = vk::Extent3D {size.x, size.y, 1u};
+	auto info = vpp::ViewableImageCreateInfo::color(dev, extent, usage,
+		{format}).value();
+	auto memBits = dev.memoryTypeBits(vk::MemoryPropertyBits::deviceLocal);
+	image_ = {dev, info, memBits};
+
+	vk::FramebufferCreateInfo fbInfo;
+	fbInfo.renderPass = rp_;
+	fbInfo.attachmentCount = 1;
+	fbInfo.pAttachments = &image_.vkImageView();
+	fbInfo.width = size.x;
+	fbInfo.height = size.y;
+	fbInfo.layers = 1u;
+	fb_ = {dev, fbInfo};
+}
+
+HeadlessTarget::~HeadlessTarget() = default;
+
+ContextSettings HeadlessTarget::contextSettings() const {
+	ContextSettings settings {};
+	settings.renderPass = rp_;
+	settings.subpass = 0u;
+	return settings;
+}
+
+void HeadlessTarget::beginRenderPass(vk::CommandBuffer cb,
+		const Vec4f& clear, vk::SubpassContents contents) const {
+	auto clearValue = vk::ClearValue {{clear[0], clear[1], clear[2],
+		clear[3]}};
+	vk::cmdBeginRenderPass(cb, {
+		rp_,
+		fb_,
+		{0u, 0u, size_.x, size_.y},
+		1,
+		&clearValue
+	}, contents);
+
+	// secondary command buffers have to set them themselves
+	if(contents != vk::SubpassContents::secondaryCommandBuffers) {
+		vk::Viewport vp {0.f, 0.f, float(size_.x), float(size_.y), 0.f, 1.f};
+		vk::cmdSetViewport(cb, 0, 1, vp);
+		vk::cmdSetScissor(cb, 0, 1, {0, 0, size_.x, size_.y});
+	}
+}
+
+void HeadlessTarget::endRenderPass(vk::CommandBuffer cb) const {
+	vk::cmdEndRenderPass(cb);
+}
+
+vpp::SubBuffer HeadlessTarget::read(vk::CommandBuffer cb) const {
+	auto extent = vk::Extent3D {size_.x, size_.y, 1u};
+	return vpp::retrieveStaging(cb, image_.image(), format_,
+		vk::ImageLayout::transferSrcOptimal, extent,
+		{vk::ImageAspectBits::color, 0, 0});
+}
+
+} // namespace rvg
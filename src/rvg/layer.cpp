@@ -0,0 +1,92 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/layer.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <vpp/vk.hpp>
+#include <vpp/queue.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+
+namespace rvg {
+
+Layer::Layer(Context& ctx, Recording recording, vk::RenderPass rp,
+		unsigned subpass) : context_(&ctx), recording_(std::move(recording)),
+			renderPass_(rp), subpass_(subpass) {
+	dlg_assert(recording_);
+	if(!renderPass_) {
+		renderPass_ = ctx.settings().renderPass;
+		subpass_ = ctx.settings().subpass;
+	}
+
+	ctx.addLayer(*this);
+}
+
+Layer::~Layer() {
+	context().removeLayer(*this);
+	context().keepAlive(std::move(cmdBuf_));
+}
+
+bool Layer::record() {
+	// an invalidation while recording makes it invalid again
+	if(!invalid_.exchange(false)) {
+		return false;
+	}
+
+	// pending frames might still execute the old command buffer
+	auto& ctx = context();
+	auto& dev = ctx.device();
+	auto family = dev.queueSubmitter().queue().family();
+	ctx.keepAlive(std::move(cmdBuf_));
+	cmdBuf_ = dev.commandAllocator().get(family, {},
+		vk::CommandBufferLevel::secondary);
+
+	vk::CommandBufferInheritanceInfo inheritance;
+	inheritance.renderPass = renderPass_;
+	inheritance.subpass = subpass_;
+
+	vk::CommandBufferBeginInfo beginInfo;
+	beginInfo.flags = vk::CommandBufferUsageBits::renderPassContinue;
+	if(ctx.settings().framesInFlight > 1) {
+		// might be executed by multiple pending frames
+		beginInfo.flags |= vk::CommandBufferUsageBits::simultaneousUse;
+	}
+
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	auto old = std::move(refs_);
+	refs_.clear();
+	changed_ = false;
+
+	vk::beginCommandBuffer(cmdBuf_, beginInfo);
+	Recorder rec(ctx, cmdBuf_, this);
+	ctx.bindDefaults(rec);
+	recording_(rec);
+	vk::endCommandBuffer(cmdBuf_);
+
+	std::sort(refs_.begin(), refs_.end());
+	refs_.erase(std::unique(refs_.begin(), refs_.end()), refs_.end());
+	ctx.layerRecorded(*this, old);
+	return true;
+}
+
+void Layer::execute(vk::CommandBuffer cb) const {
+	dlg_assertm(!invalid_ && cmdBuf_.vkHandle(), "Layer must be recorded");
+	vk::cmdExecuteCommands(cb, {cmdBuf_.vkHandle()});
+}
+
+void Layer::invalidate() {
+	invalid_ = true;
+}
+
+void Layer::use(const DeviceObject& obj) {
+	refs_.push_back(&obj);
+}
+
+void Layer::moved(const DeviceObject& o, const DeviceObject& n) {
+	std::replace(refs_.begin(), refs_.end(), &o, &n);
+}
+
+} // namespace rvg
@@ -5,6 +5,7 @@
 #include <rvg/util.hpp>
 #include <rvg/paint.hpp>
 #include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
 
 #include <vpp/vk.hpp>
 #include <vpp/imageOps.hpp>
@@ -322,8 +323,16 @@ Paint::Paint(Context& ctx, const PaintData& xpaint, bool deviceLocal) :
 	}
 
 	oldView_ = paint_.texture;
+	oldType_ = paint_.data.frag.type;
+	if(ctx.bindless()) {
+		slot_ = ctx.bindlessPaints().allocate();
+		texSlot_ = ctx.bindlessTextures().allocate(paint_.texture);
+		upload();
+		return;
+	}
+
 	auto usage = nytl::Flags{vk::BufferUsageBits::uniformBuffer};
-	if(deviceLocal) {
+	if(deviceLocal || !ctx.directWrites()) {
 		usage |= vk::BufferUsageBits::transferDst;
 	}
 	auto memBits = deviceLocal ?
@@ -331,9 +340,37 @@ Paint::Paint(Context& ctx, const PaintData& xpaint, bool deviceLocal) :
 		context().device().hostMemoryTypes();
 	ubo_ = {ctx.bufferAllocator(), paintUboSize, usage, 0u, memBits};
 
-	ds_ = {ctx.dsAllocator(), ctx.dsLayoutPaint()};
 	upload();
+	writeDs();
+}
+
+Paint::~Paint() {
+	// pending frames might still use them
+	if(valid()) {
+		context().keepAlive(std::move(ubo_));
+		context().keepAlive(std::move(ds_));
+	}
+}
 
+Paint& Paint::operator=(Paint&& rhs) noexcept {
+	if(valid()) {
+		context().keepAlive(std::move(ubo_));
+		context().keepAlive(std::move(ds_));
+	}
+
+	DeviceObject::operator=(std::move(rhs));
+	paint_ = rhs.paint_;
+	ubo_ = std::move(rhs.ubo_);
+	ds_ = std::move(rhs.ds_);
+	oldView_ = rhs.oldView_;
+	oldType_ = rhs.oldType_;
+	slot_ = std::move(rhs.slot_);
+	texSlot_ = std::move(rhs.texSlot_);
+	return *this;
+}
+
+void Paint::writeDs() {
+	ds_ = {context().dsAllocator(), context().dsLayoutPaint()};
 	vpp::DescriptorSetUpdate update(ds_);
 	auto m4 = sizeof(nytl::Mat4f);
 	update.uniform({{ubo_.buffer(), ubo_.offset(), m4}});
@@ -343,43 +380,92 @@ Paint::Paint(Context& ctx, const PaintData& xpaint, bool deviceLocal) :
 }
 
 void Paint::update() {
-	dlg_assert(valid() && ds_ && ubo_.size());
+	dlg_assert(valid() && ((ds_ && ubo_.size()) || slot_.valid()));
 	context().registerUpdateDevice(this);
 }
 
 void Paint::upload() {
-	dlg_assert(valid() && ubo_.size());
 	auto inner = linearize(paint_.data.frag.inner);
 	auto outer = linearize(paint_.data.frag.outer);
 
+	if(slot_.valid()) {
+		// std430 layout, see bindless.glsl
+		auto ptr = context().bindlessPaints().write(slot_.slot());
+		write(ptr, paint_.data.transform);
+		write(ptr, inner);
+		write(ptr, outer);
+		write(ptr, paint_.data.frag.custom);
+		write(ptr, static_cast<std::uint32_t>(paint_.data.frag.type));
+		write(ptr, texSlot_.slot());
+		return;
+	}
+
+	dlg_assert(valid() && ubo_.size());
 	upload140(*this, ubo_,
-		vpp::raw(paint_.data.transform),
-		vpp::raw(inner),
-		vpp::raw(outer),
-		vpp::raw(paint_.data.frag.custom),
-		vpp::raw(static_cast<std::uint32_t>(paint_.data.frag.type)));
+		raw(paint_.data.transform),
+		raw(inner),
+		raw(outer),
+		raw(paint_.data.frag.custom),
+		raw(static_cast<std::uint32_t>(paint_.data.frag.type)));
 }
 
 void Paint::bind(vk::CommandBuffer cb) const {
+	if(slot_.valid()) {
+		Recorder rec(context(), cb);
+		bind(rec);
+		return;
+	}
+
 	dlg_assert(valid() && ds_ && ubo_.size());
 	vk::cmdBindDescriptorSets(cb, vk::PipelineBindPoint::graphics,
 		context().pipeLayout(), Context::paintBindSet, {ds_}, {});
 }
 
-bool Paint::updateDevice() {
+void Paint::bind(Recorder& rec) const {
+	rec.use(*this);
+	if(slot_.valid()) {
+		rec.push(Context::paintPushSlot, slot_.slot());
+		return;
+	}
+
 	dlg_assert(valid() && ds_ && ubo_.size());
+	rec.bindDescriptorSet(Context::paintBindSet, ds_);
+}
+
+bool Paint::updateDevice() {
+	dlg_assert(valid() && ((ds_ && ubo_.size()) || slot_.valid()));
 	auto re = false;
 	if(!paint_.texture) {
 		paint_.texture = context().emptyImage().vkImageView();
 	}
 
+	// the pipeline variant is chosen by the paint type when recording
+	if(oldType_ != paint_.data.frag.type) {
+		oldType_ = paint_.data.frag.type;
+		if(context().settings().pipelineVariants) {
+			context().rerecordCause(*this, "Paint: type changed");
+			re = true;
+		}
+	}
+
+	if(slot_.valid()) {
+		// a changed texture slot is signaled by the Context
+		if(oldView_ != paint_.texture) {
+			context().keepAlive(std::move(texSlot_));
+			texSlot_ = context().bindlessTextures().allocate(paint_.texture);
+			oldView_ = paint_.texture;
+		}
+
+		upload();
+		return re;
+	}
+
 	upload();
 
 	if(oldView_ != paint_.texture) {
-		vpp::DescriptorSetUpdate update(ds_);
-		update.skip(2);
-		update.imageSampler({{{}, paint_.texture,
-			vk::ImageLayout::shaderReadOnlyOptimal}});
+		// the old descriptor set might still be used by a pending frame
+		context().keepAlive(std::move(ds_));
+		writeDs();
 		oldView_ = paint_.texture;
 		re = true;
 	}
@@ -446,6 +532,26 @@ Texture::Texture(Context& ctx, Vec2ui size, nytl::Span<const std::byte> data,
 	upload(data, vk::ImageLayout::undefined);
 }
 
+Texture::~Texture() {
+	// pending frames might still sample it
+	if(valid()) {
+		context().keepAlive(std::move(*this));
+	}
+}
+
+Texture& Texture::operator=(Texture&& rhs) noexcept {
+	if(valid()) {
+		context().keepAlive(std::move(*this));
+	}
+
+	DeviceObject::operator=(std::move(rhs));
+	image_ = std::move(rhs.image_);
+	size_ = rhs.size_;
+	type_ = rhs.type_;
+	pending_ = std::move(rhs.pending_);
+	return *this;
+}
+
 void Texture::create() {
 	constexpr auto usage =
 		vk::ImageUsageBits::transferDst |
@@ -485,31 +591,15 @@ void Texture::create() {
 }
 
 void Texture::upload(nytl::Span<const std::byte> data, vk::ImageLayout layout) {
-	auto cmdBuf = context().uploadCmdBuf();
-	vpp::changeLayout(cmdBuf, image_.image(),
-		layout, vk::PipelineStageBits::topOfPipe, {},
-		vk::ImageLayout::transferDstOptimal, vk::PipelineStageBits::transfer,
-		vk::AccessBits::transferWrite,
-		{vk::ImageAspectBits::color, 0, 1, 0, 1});
-	layout = vk::ImageLayout::transferDstOptimal;
-
-	auto size = vk::Extent3D{size_.x, size_.y, 1u};
-	auto format = type_ == Type::a8 ?
-		vk::Format::r8Unorm :
-		vk::Format::r8g8b8a8Srgb;
-	auto stage = vpp::fillStaging(cmdBuf, image_.image(), format, layout,
-		size, data, {vk::ImageAspectBits::color});
-
-	vpp::changeLayout(cmdBuf, image_.image(),
-		layout, vk::PipelineStageBits::transfer,
-		vk::AccessBits::transferWrite,
-		vk::ImageLayout::shaderReadOnlyOptimal,
-		vk::PipelineStageBits::allGraphics,
-		vk::AccessBits::shaderRead,
-		{vk::ImageAspectBits::color, 0, 1, 0, 1});
-
-	context().addStage(std::move(stage));
-	context().addCommandBuffer(this, std::move(cmdBuf));
+	auto stage = context().stage(data.size());
+	std::memcpy(stage.data, data.data(), data.size());
+
+	vk::BufferImageCopy copy {};
+	copy.bufferOffset = stage.span.offset();
+	copy.imageExtent = {size_.x, size_.y, 1u};
+	copy.imageSubresource = {vk::ImageAspectBits::color, 0, 0, 1};
+	context().addCopy(*this, stage.span.buffer(), image_.image(), layout,
+		copy);
 }
 
 void Texture::update(std::vector<std::byte> data) {
@@ -518,6 +608,32 @@ void Texture::update(std::vector<std::byte> data) {
 	context().registerUpdateDevice(this);
 }
 
+void Texture::update(Vec2ui offset, Vec2ui size,
+		nytl::Span<const std::byte> data) {
+	auto texel = (type_ == Type::a8) ? 1u : 4u;
+	dlg_assert(offset.x + size.x <= size_.x && offset.y + size.y <= size_.y);
+	dlg_assert(std::size_t(data.size()) >= size_.x * size_.y * texel);
+	if(!size.x || !size.y) {
+		return;
+	}
+
+	// only the rows of the region are staged, tightly packed
+	auto rowSize = size.x * texel;
+	auto stage = context().stage(rowSize * size.y);
+	for(auto y = 0u; y < size.y; ++y) {
+		auto src = ((offset.y + y) * size_.x + offset.x) * texel;
+		std::memcpy(stage.data + y * rowSize, data.data() + src, rowSize);
+	}
+
+	vk::BufferImageCopy copy {};
+	copy.bufferOffset = stage.span.offset();
+	copy.imageOffset = {int(offset.x), int(offset.y), 0};
+	copy.imageExtent = {size.x, size.y, 1u};
+	copy.imageSubresource = {vk::ImageAspectBits::color, 0, 0, 1};
+	context().addCopy(*this, stage.span.buffer(), image_.image(),
+		vk::ImageLayout::shaderReadOnlyOptimal, copy);
+}
+
 bool Texture::updateDevice() {
 	upload(pending_, vk::ImageLayout::shaderReadOnlyOptimal);
 	return false;
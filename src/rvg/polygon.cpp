@@ -4,35 +4,64 @@
 
 #include <rvg/polygon.hpp>
 #include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/drawBatch.hpp>
 #include <rvg/util.hpp>
+#include <rvg/tracing.hpp>
 #include <katachi/stroke.hpp>
 #include <vpp/vk.hpp>
 #include <vpp/bufferOps.hpp>
 #include <nytl/vecOps.hpp>
 #include <dlg/dlg.hpp>
 #include <optional>
+#include <array>
 
 namespace rvg {
 
-// Polygon
-Polygon::Polygon(Context& ctx) : DeviceObject(ctx) {
-}
+void tessellateFill(Span<const Vec2f> points, const DrawMode& mode,
+		Vertices& fill, Vertices& fillAA) {
+	if(!mode.aaFill) {
+		// just copy color and points, no processing needed
+		fill.points.insert(fill.points.end(), points.begin(), points.end());
+		if(mode.color.fill) {
+			dlg_assert(mode.color.points.size() == points.size());
+			fill.color.insert(fill.color.end(),
+				mode.color.points.begin(), mode.color.points.end());
+		}
 
-void Polygon::updateStroke(Span<const Vec2f> points, const DrawMode& mode) {
-	if(mode.color.stroke != flags_.colorStroke) {
-		flags_.colorStroke = mode.color.stroke;
-		context().rerecord();
+		return;
 	}
 
-	if(mode.aaStroke != flags_.aaStroke) {
-		flags_.aaStroke = mode.aaStroke;
-		context().rerecord();
-	}
+	// inset fill points and generate alpha blended stroke at
+	// the edges for smoothness
+	auto fillHandler = [&](const auto& vertex) {
+		fill.points.push_back(vertex.position);
+		if(mode.color.fill) {
+			fill.color.push_back(vertex.color);
+		}
+	};
 
-	dlg_assertm(!flags_.aaStroke || context().antiAliasing(),
-		"Anti aliasing must be enabled in the context");
+	auto strokeHandler = [&](const auto& vertex) {
+		fillAA.points.push_back(vertex.position);
+		fillAA.aa.push_back(vertex.aa);
+		if(mode.color.fill) {
+			fillAA.color.push_back(vertex.color);
+		}
+	};
+
+	auto fringe = Context::fringe();
+	if(mode.color.fill) {
+		ktc::bakeColoredFillAA(points, mode.color.points, fringe,
+			fillHandler, strokeHandler);
+	} else {
+		ktc::bakeFillAA(points, fringe, fillHandler, strokeHandler);
+	}
+}
 
-	auto sf = mode.aaStroke ? context().fringe() : 0.f;
+void tessellateStroke(Span<const Vec2f> points, const DrawMode& mode,
+		Vertices& stroke) {
+	auto fringe = Context::fringe();
+	auto sf = mode.aaStroke ? fringe : 0.f;
 	auto width = mode.stroke + sf;
 	auto loop = mode.loop;
 	if(points.size() > 2 && points.front() == points.back()) {
@@ -41,90 +70,197 @@ void Polygon::updateStroke(Span<const Vec2f> points, const DrawMode& mode) {
 	}
 
 	auto settings = ktc::StrokeSettings {width, loop, sf};
+	if(mode.aaStroke) {
+		settings.width += fringe * 0.5f;
+	}
+
 	auto vertHandler = [&](const auto& vertex) {
-		stroke_.points.push_back(vertex.position);
-		if(flags_.aaStroke) {
-			stroke_.aa.push_back(vertex.aa);
+		stroke.points.push_back(vertex.position);
+		if(mode.aaStroke) {
+			stroke.aa.push_back(vertex.aa);
 		}
 
-		if(flags_.colorStroke) {
-			stroke_.color.push_back(vertex.color);
+		if(mode.color.stroke) {
+			stroke.color.push_back(vertex.color);
 		}
 	};
 
-	if(flags_.aaStroke) {
-		auto fringe = context().fringe();
-		strokeMult_ = (mode.stroke * 0.5f + fringe * 0.5f) / fringe;
-		settings.width += fringe * 0.5f;
-	}
-
 	if(mode.color.stroke) {
 		ktc::bakeColoredStroke(points, mode.color.points, settings,
 			vertHandler);
 	} else {
 		ktc::bakeStroke(points, settings, vertHandler);
 	}
+}
+
+// Polygon
+Polygon::Polygon(Context& ctx) : DeviceObject(ctx) {
+}
+
+Polygon::~Polygon() {
+	if(batch_) {
+		batch_->remove(*this);
+	}
 
-	if(flags_.aaStroke && !strokeDs_) {
-		auto& layout = context().dsLayoutStrokeAA();
-		strokeDs_ = {context().dsAllocator(), layout};
+	// pending frames might still use it, the arena retires the ranges
+	if(valid()) {
+		context().keepAlive(std::move(strokeDs_));
 	}
 }
 
+Polygon::Polygon(Polygon&& rhs) noexcept : DeviceObject(std::move(rhs)),
+		flags_(rhs.flags_),
+		fill_(std::move(rhs.fill_)),
+		fillAA_(std::move(rhs.fillAA_)),
+		stroke_(std::move(rhs.stroke_)),
+		strokeMultBuf_(std::move(rhs.strokeMultBuf_)),
+		strokeDs_(std::move(rhs.strokeDs_)),
+		strokeMult_(rhs.strokeMult_),
+		pending_(std::move(rhs.pending_)),
+		batch_(rhs.batch_),
+		batchIndex_(rhs.batchIndex_) {
+	rhs.batch_ = nullptr;
+	if(batch_) {
+		batch_->moved(rhs, *this);
+	}
+}
+
+Polygon& Polygon::operator=(Polygon&& rhs) noexcept {
+	if(batch_) {
+		batch_->remove(*this);
+	}
+
+	if(valid()) {
+		context().keepAlive(std::move(strokeDs_));
+	}
+
+	DeviceObject::operator=(std::move(rhs));
+	flags_ = rhs.flags_;
+	fill_ = std::move(rhs.fill_);
+	fillAA_ = std::move(rhs.fillAA_);
+	stroke_ = std::move(rhs.stroke_);
+	strokeMultBuf_ = std::move(rhs.strokeMultBuf_);
+	strokeDs_ = std::move(rhs.strokeDs_);
+	strokeMult_ = rhs.strokeMult_;
+	pending_ = std::move(rhs.pending_);
+
+	batch_ = rhs.batch_;
+	batchIndex_ = rhs.batchIndex_;
+	rhs.batch_ = nullptr;
+	if(batch_) {
+		batch_->moved(rhs, *this);
+	}
+
+	return *this;
+}
+
+void Polygon::updateStroke(Span<const Vec2f> points, const DrawMode& mode) {
+	if(mode.color.stroke != flags_.colorStroke) {
+		flags_.colorStroke = mode.color.stroke;
+		context().rerecord(*this, "Polygon: stroke color changed");
+	}
+
+	if(mode.aaStroke != flags_.aaStroke) {
+		flags_.aaStroke = mode.aaStroke;
+		context().rerecord(*this, "Polygon: aaStroke changed");
+	}
+
+	dlg_assertm(!flags_.aaStroke || context().antiAliasing(),
+		"Anti aliasing must be enabled in the context");
+
+	if(flags_.aaStroke) {
+		auto fringe = context().fringe();
+		auto mult = (mode.stroke * 0.5f + fringe * 0.5f) / fringe;
+		if(context().bindless() && mult != strokeMult_) {
+			// recorded as push constant
+			context().rerecord(*this, "Polygon: stroke width changed");
+		}
+
+		strokeMult_ = mult;
+	}
+
+	tessellateStroke(points, mode, stroke_);
+}
+
 void Polygon::updateFill(Span<const Vec2f> points, const DrawMode& mode) {
 	if(mode.color.fill != flags_.colorFill) {
 		flags_.colorFill = mode.color.fill;
-		context().rerecord();
+		context().rerecord(*this, "Polygon: fill color changed");
 	}
 
 	if(mode.aaFill != flags_.aaFill) {
 		flags_.aaFill = mode.aaFill;
-		context().rerecord();
+		context().rerecord(*this, "Polygon: aaFill changed");
 	}
 
-	if(flags_.aaFill) {
-		dlg_assertm(context().antiAliasing(), "Anti aliasing must be \
-			enabled in the context");
-
-		// inset fill points and generate alpha blended stroke at
-		// the edges for smoothness
-		auto fillHandler = [&](const auto& vertex) {
-			fill_.points.push_back(vertex.position);
-			if(mode.color.fill) {
-				fill_.color.push_back(vertex.color);
-			}
-		};
+	dlg_assertm(!flags_.aaFill || context().antiAliasing(),
+		"Anti aliasing must be enabled in the context");
+	tessellateFill(points, mode, fill_, fillAA_);
+}
 
-		auto strokeHandler = [&](const auto& vertex) {
-			fillAA_.points.push_back(vertex.position);
-			fillAA_.aa.push_back(vertex.aa);
-			if(mode.color.fill) {
-				fillAA_.color.push_back(vertex.color);
-			}
-		};
+void Polygon::updateMode(const DrawMode& mode) {
+	dlg_assertm(valid(), "Polygon must not be in invalid state");
+	dlg_assertm(mode.stroke >= 0.f, "DrawMode::stroke must not be negative");
 
-		if(mode.color.fill) {
-			ktc::bakeColoredFillAA(points, mode.color.points,
-				context().fringe(), fillHandler, strokeHandler);
-		} else {
-			ktc::bakeFillAA(points, context().fringe(), fillHandler,
-				strokeHandler);
-		}
-	} else {
-		// just copy color and points, no processing needed
-		fill_.points.insert(fill_.points.end(), points.begin(), points.end());
-		if(mode.color.fill) {
-			dlg_assert(mode.color.points.size() == points.size());
-			fill_.color.insert(fill_.color.end(),
-				mode.color.points.begin(), mode.color.points.end());
-		}
+	if(mode.deviceLocal != flags_.deviceLocal) {
+		// frees the ranges, updateDevice allocates new ones
+		flags_.deviceLocal = mode.deviceLocal;
+		fill_ = {};
+		fillAA_ = {};
+		stroke_ = {};
+		strokeMultBuf_ = {};
 	}
 }
 
 void Polygon::update(Span<const Vec2f> points, const DrawMode& mode) {
-	dlg_assertm(valid(), "Polygon must not be in invalid state");
-	dlg_assertm(mode.stroke >= 0.f, "DrawMode::stroke must not be negative");
+	RVG_TRACE_EVENT("Polygon::update", "Polygon");
+	updateMode(mode);
+
+	pending_.outline = {};
+	if(context().deferredUpdates()) {
+		pending_.points.assign(points.begin(), points.end());
+		pending_.mode = mode;
+		pending_.valid = true;
+	} else {
+		pending_.valid = false;
+		bake(points, mode);
+	}
+
+	context().registerUpdateDevice(this);
+}
+
+void Polygon::update(Outline outline, const DrawMode& mode) {
+	dlg_assert(outline);
+	RVG_TRACE_EVENT("Polygon::update", "Polygon");
+	updateMode(mode);
 
+	pending_.outline = std::move(outline);
+	pending_.mode = mode;
+	pending_.valid = true;
+	if(!context().deferredUpdates()) {
+		updateHost();
+	}
+
+	context().registerUpdateDevice(this);
+}
+
+void Polygon::updateHost() {
+	if(!pending_.valid) {
+		return;
+	}
+
+	pending_.valid = false;
+	if(pending_.outline) {
+		pending_.points.clear();
+		pending_.outline(pending_.points);
+		pending_.outline = {};
+	}
+
+	bake(pending_.points, pending_.mode);
+}
+
+void Polygon::bake(Span<const Vec2f> points, const DrawMode& mode) {
+	context().countTessellation();
 	fill_.points.clear();
 	fill_.color.clear();
 	fillAA_.points.clear();
@@ -134,13 +270,6 @@ void Polygon::update(Span<const Vec2f> points, const DrawMode& mode) {
 	stroke_.color.clear();
 	stroke_.aa.clear();
 
-	if(mode.deviceLocal != flags_.deviceLocal) {
-		flags_.deviceLocal = mode.deviceLocal;
-		fill_ = {};
-		fillAA_ = {};
-		stroke_ = {};
-	}
-
 	flags_.fill = mode.fill;
 	if(flags_.fill) {
 		updateFill(points, mode);
@@ -150,8 +279,6 @@ void Polygon::update(Span<const Vec2f> points, const DrawMode& mode) {
 	if(flags_.stroke) {
 		updateStroke(points, mode);
 	}
-
-	context().registerUpdateDevice(this);
 }
 
 void Polygon::disable(bool disable, DrawType type) {
@@ -182,76 +309,61 @@ bool Polygon::disabled(DrawType type) const {
 	return ret;
 }
 
-bool Polygon::checkResize(vpp::SubBuffer& buf, vk::DeviceSize needed,
-		vk::BufferUsageFlags usage) {
-	needed = std::max(needed, vk::DeviceSize(16u));
-	if(buf.size() < needed) {
-		if(flags_.deviceLocal) {
-			usage |= vk::BufferUsageBits::transferDst;
-		}
+Rect2f Polygon::drawBounds() const {
+	Rect2f ret {};
+	if(flags_.fill && !flags_.disableFill) {
+		ret = uniteRects(ret, pointBounds(fill_.points));
+		ret = uniteRects(ret, pointBounds(fillAA_.points));
+	}
 
-		auto memBits = flags_.deviceLocal ?
-			context().device().deviceMemoryTypes() :
-			context().device().hostMemoryTypes();
-		buf = {context().bufferAllocator(), needed * 2, usage, 4u, memBits};
-		return true;
+	if(flags_.stroke && !flags_.disableStroke) {
+		ret = uniteRects(ret, pointBounds(stroke_.points));
 	}
 
-	return false;
+	return ret;
 }
 
-bool Polygon::upload(Draw& draw, bool disable, bool color) {
+bool Polygon::upload(Draw& draw, bool disable, bool aa, bool color) {
+	auto& arena = context().geometryArena();
 	auto rerecord = false;
-	auto pneeded = sizeof(vk::DrawIndirectCommand);
-	pneeded += !disable * (sizeof(draw.points[0]) * draw.points.size());
-	rerecord |= checkResize(draw.pBuf, pneeded,
-		vk::BufferUsageBits::vertexBuffer);
+	if(!draw.cmd.size()) {
+		draw.cmd = arena.allocate(sizeof(vk::DrawIndirectCommand),
+			flags_.deviceLocal, 4u);
+		context().rerecordCause(*this, "Polygon: command allocated");
+		rerecord = true;
+	}
+
+	auto count = unsigned(draw.points.size());
+	auto format = vertexFormat(aa, color);
+	auto& v = draw.vertices;
+	if(arena.resize(v, count, format, flags_.deviceLocal)) {
+		context().rerecordCause(*this, "Polygon: vertices changed block");
+		rerecord = true;
+	}
 
 	vk::DrawIndirectCommand cmd {};
-	cmd.vertexCount = !disable * draw.points.size();
+	cmd.vertexCount = !disable * count;
 	cmd.instanceCount = 1;
+	cmd.firstVertex = v.first();
+	upload140(*this, draw.cmd.span(), raw(cmd));
 
-	if(disable) {
-		upload140(*this, draw.pBuf, vpp::raw(cmd));
-	} else {
-		auto points = vpp::raw(*draw.points.data(), draw.points.size());
-		upload140(*this, draw.pBuf, vpp::raw(cmd), points);
-	}
-
-	// color
-	if(!color) {
+	if(disable || !count) {
 		return rerecord;
 	}
 
-	auto cneeded = color * (sizeof(draw.color[0])) * draw.color.size();
-	rerecord |= checkResize(draw.cBuf, cneeded,
-		vk::BufferUsageBits::vertexBuffer);
-	upload140(*this, draw.cBuf, vpp::raw(*draw.color.data(),
-		draw.color.size()));
-
-	return rerecord;
-}
-
-bool Polygon::upload(Stroke& stroke, bool disable, bool color, bool aa,
-		float* mult) {
+	upload140(*this, v.stream(VertexStream::position),
+		raw(*draw.points.data(), count));
 
-	bool rerecord = upload(static_cast<Draw&>(stroke), disable, color);
 	if(aa) {
-		auto needed = stroke.aa.size() * sizeof(stroke.aa[0]);
-		vk::BufferUsageFlags usage = vk::BufferUsageBits::vertexBuffer;
-		if(mult) {
-			needed += sizeof(float);
-			usage |= vk::BufferUsageBits::uniformBuffer;
-		}
-
-		rerecord |= checkResize(stroke.aaBuf, needed, usage);
-		auto data = vpp::raw(*stroke.aa.data(), stroke.aa.size());
+		dlg_assert(draw.aa.size() == count);
+		upload140(*this, v.stream(VertexStream::aux),
+			raw(*draw.aa.data(), count));
+	}
 
-		if(mult) {
-			upload140(*this, stroke.aaBuf, *mult, data);
-		} else {
-			upload140(*this, stroke.aaBuf, data);
-		}
+	if(color) {
+		dlg_assert(draw.color.size() == count);
+		upload140(*this, v.stream(VertexStream::color),
+			raw(*draw.color.data(), count));
 	}
 
 	return rerecord;
@@ -259,122 +371,125 @@ bool Polygon::upload(Stroke& stroke, bool disable, bool color, bool aa,
 
 bool Polygon::updateDevice() {
 	dlg_assertm(valid(), "Polygon must not be in invalid state");
+	updateHost();
 
 	bool rerecord = false;
 
 	if(flags_.fill) {
-		rerecord |= upload(fill_, flags_.disableFill, flags_.colorFill);
+		rerecord |= upload(fill_, flags_.disableFill, false, flags_.colorFill);
 		if(flags_.aaFill) {
-			rerecord |= upload(fillAA_, flags_.disableFill, flags_.colorFill,
-				true, nullptr);
+			rerecord |= upload(fillAA_, flags_.disableFill, true,
+				flags_.colorFill);
 		}
 	}
 
 	if(flags_.stroke) {
-		auto prev = stroke_.aaBuf.size();
-		rerecord |= upload(stroke_, flags_.disableStroke, flags_.colorStroke,
-			flags_.aaStroke, &strokeMult_);
-
-		// check if buffer with our uniform was recreated
-		auto next = stroke_.aaBuf.size();
-		if(prev != next || (!strokeDs_ && next > 0)) {
-			if(!strokeDs_) {
+		rerecord |= upload(stroke_, flags_.disableStroke, flags_.aaStroke,
+			flags_.colorStroke);
+
+		// in bindless mode, the multiplier is a push constant
+		if(flags_.aaStroke && !context().bindless()) {
+			if(!strokeMultBuf_.size()) {
+				auto& arena = context().geometryArena();
+				auto& limits = context().device().properties().limits;
+				strokeMultBuf_ = arena.allocate(sizeof(float),
+					flags_.deviceLocal, limits.minUniformBufferOffsetAlignment);
+
+				// a previously written descriptor set might still be in use
+				// by a pending frame, we can't update it.
 				auto& layout = context().dsLayoutStrokeAA();
+				context().keepAlive(std::move(strokeDs_));
 				strokeDs_ = {context().dsAllocator(), layout};
+
+				auto& b = strokeMultBuf_;
+				vpp::DescriptorSetUpdate update(strokeDs_);
+				update.uniform({{b.buffer(), b.offset(), sizeof(float)}});
+				context().rerecordCause(*this, "Polygon: aaStroke allocated");
+				rerecord = true;
 			}
 
-			auto& b = stroke_.aaBuf;
-			vpp::DescriptorSetUpdate update(strokeDs_);
-			update.uniform({{b.buffer(), b.offset(), sizeof(float)}});
+			upload140(*this, strokeMultBuf_.span(), raw(strokeMult_));
 		}
 	}
 
+	if(batch_) {
+		batch_->updated(*this);
+	}
+
 	return rerecord;
 }
 
 void Polygon::fill(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	fill(rec);
+}
+
+void Polygon::fill(Recorder& rec) const {
 	dlg_assertm(flags_.fill, "Polygon has no fill data");
 	dlg_assertm(valid(), "Polygon must not be in an invalid state");
+	rec.use(*this);
+	rec.category(flags_.aaFill ? DrawCategory::aaFill : DrawCategory::fill);
 
 	// fill
-	vk::cmdBindPipeline(cb, vk::PipelineBindPoint::graphics,
-		context().fanPipe());
-
-	static constexpr auto type = uint32_t(0);
-	vk::cmdPushConstants(cb, context().pipeLayout(),
-		vk::ShaderStageBits::fragment, 0, 4, &type);
-
-	auto& b = fill_.pBuf;
-	auto off = b.offset() + sizeof(vk::DrawIndirectCommand);
-	vk::cmdBindVertexBuffers(cb, 0, {b.buffer()}, {off});
-	vk::cmdBindVertexBuffers(cb, 1, {b.buffer()}, {off}); // dummy uv
-
-	if(flags_.colorFill) {
-		auto& c = fill_.cBuf;
-		dlg_assert(c.size());
-		vk::cmdBindVertexBuffers(cb, 2, {c.buffer()}, {c.offset()});
-	} else {
-		vk::cmdBindVertexBuffers(cb, 2, {b.buffer()}, {off}); // dummy color
-	}
-
-	vk::cmdDrawIndirect(cb, b.buffer(), b.offset(), 1, 0);
+	rec.bindPipeline(vk::PrimitiveTopology::triangleFan,
+		Context::drawTypeDefault);
+
+	// streams that aren't there are bound to the positions as dummies
+	auto& v = fill_.vertices;
+	auto buf = v.buffer();
+	rec.bindVertexBuffers({buf, buf, buf}, {
+		v.streamOffset(VertexStream::position),
+		v.streamOffset(VertexStream::aux),
+		v.streamOffset(VertexStream::color)});
+	rec.drawIndirect(fill_.cmd.buffer(), fill_.cmd.offset(), 1, 0);
 
 	// aa stroke
 	if(flags_.aaFill) {
-		stroke(cb, fillAA_, true, flags_.colorFill, context().defaultStrokeAA(), 0u);
+		stroke(rec, fillAA_, true, context().defaultStrokeAA(), 1.f);
 	}
 }
 
 void Polygon::stroke(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	stroke(rec);
+}
+
+void Polygon::stroke(Recorder& rec) const {
 	dlg_assertm(flags_.stroke, "Polygon has no stroke data");
 	dlg_assertm(valid(), "Polygon must not be in an invalid state");
+	rec.use(*this);
+	rec.category(DrawCategory::stroke);
 
-	stroke(cb, stroke_, flags_.aaStroke, flags_.colorStroke, strokeDs_, 4u);
+	stroke(rec, stroke_, flags_.aaStroke, strokeDs_, strokeMult_);
 }
 
-void Polygon::stroke(vk::CommandBuffer cb, const Stroke& stroke, bool aa,
-		bool color, vk::DescriptorSet aaDs, unsigned aaOff) const {
-
-	dlg_assert(stroke.pBuf.size());
+void Polygon::stroke(Recorder& rec, const Draw& draw, bool aa,
+		vk::DescriptorSet aaDs, float mult) const {
 
-	vk::cmdBindPipeline(cb, vk::PipelineBindPoint::graphics,
-		context().stripPipe());
+	dlg_assert(draw.cmd.size());
 
-	// position and dummy uv buffer
-	auto& b = stroke.pBuf;
-	auto off = b.offset() + sizeof(vk::DrawIndirectCommand);
-	vk::cmdBindVertexBuffers(cb, 0, {b.buffer()}, {off});
-
-	// aa
-	auto type = uint32_t(0);
+	// used to determine whether aa alpha blending is used
+	auto type = Context::drawTypeDefault;
 	if(aa) {
-		type = 2u;
-		auto& a = stroke.aaBuf;
-		dlg_assert(a.size());
-		dlg_assert(aaDs);
-
-		vk::cmdBindVertexBuffers(cb, 1, {a.buffer()}, {a.offset() + aaOff});
-		vk::cmdBindDescriptorSets(cb, vk::PipelineBindPoint::graphics,
-			context().pipeLayout(), Context::aaStrokeBindSet,
-			{aaDs}, {});
-	} else {
-		vk::cmdBindVertexBuffers(cb, 1, {b.buffer()}, {off}); // dummy aa uv
+		type = Context::drawTypeStroke;
+		if(context().bindless()) {
+			rec.push(Context::strokeMultPushSlot, mult);
+		} else {
+			dlg_assert(aaDs);
+			rec.bindDescriptorSet(Context::aaStrokeBindSet, aaDs);
+		}
 	}
 
-	// used to determine whether aa alpha blending is used
-	vk::cmdPushConstants(cb, context().pipeLayout(),
-		vk::ShaderStageBits::fragment, 0, 4, &type);
-
-	// color
-	if(color) {
-		auto& c = stroke.cBuf;
-		dlg_assert(c.size());
-		vk::cmdBindVertexBuffers(cb, 2, {c.buffer()}, {c.offset()});
-	} else {
-		vk::cmdBindVertexBuffers(cb, 2, {b.buffer()}, {off}); // dummy color
-	}
+	rec.bindPipeline(vk::PrimitiveTopology::triangleStrip, type);
 
-	vk::cmdDrawIndirect(cb, b.buffer(), b.offset(), 1, 0);
+	// streams that aren't there are bound to the positions as dummies
+	auto& v = draw.vertices;
+	auto buf = v.buffer();
+	rec.bindVertexBuffers({buf, buf, buf}, {
+		v.streamOffset(VertexStream::position),
+		v.streamOffset(VertexStream::aux),
+		v.streamOffset(VertexStream::color)});
+	rec.drawIndirect(draw.cmd.buffer(), draw.cmd.offset(), 1, 0);
 }
 
 } // namespace rvg
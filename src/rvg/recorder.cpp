@@ -0,0 +1,205 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/recorder.hpp>
+#include <rvg/context.hpp>
+#include <rvg/layer.hpp>
+#include <rvg/state.hpp>
+#include <rvg/paint.hpp>
+#include <rvg/polygon.hpp>
+#include <rvg/text.hpp>
+#include <rvg/sdf.hpp>
+#include <rvg/shapeBatch.hpp>
+#include <rvg/spriteBatch.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace rvg {
+
+Recorder::Recorder(Context& ctx, vk::CommandBuffer cb, Layer* layer) :
+	context_(&ctx), cmdBuf_(cb), layer_(layer) {
+}
+
+void Recorder::bindPipeline(vk::Pipeline pipe) {
+	if(pipe == pipeline_) {
+		++stats_.pipelineBindsElided;
+		return;
+	}
+
+	vk::cmdBindPipeline(cmdBuf_, vk::PipelineBindPoint::graphics, pipe);
+	pipeline_ = pipe;
+	++stats_.pipelineBinds;
+}
+
+void Recorder::bindPipeline(vk::PrimitiveTopology topology,
+		std::uint32_t drawType) {
+	bindPipeline(ShaderProgram::fill, topology, drawType);
+}
+
+void Recorder::bindPipeline(ShaderProgram program,
+		vk::PrimitiveTopology topology, std::uint32_t drawType) {
+	bindPipeline(context().pipeline(program, topology, drawType, paintType_));
+	pushType(drawType);
+}
+
+void Recorder::pushType(std::uint32_t type) {
+	push(Context::typePushSlot, type);
+}
+
+void Recorder::push(unsigned slot, std::uint32_t value) {
+	dlg_assert(slot < maxPushSlots);
+	auto bit = 1u << slot;
+	if((pushValid_ & bit) && push_[slot] == value) {
+		++stats_.pushConstantsElided;
+		return;
+	}
+
+	vk::cmdPushConstants(cmdBuf_, context().pipeLayout(),
+		context().pushConstantStages(), 4 * slot, 4, &value);
+	push_[slot] = value;
+	pushValid_ |= bit;
+	++stats_.pushConstants;
+}
+
+void Recorder::push(unsigned slot, float value) {
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	push(slot, bits);
+}
+
+void Recorder::bindDescriptorSet(unsigned set, vk::DescriptorSet ds) {
+	dlg_assert(set < maxDescriptorSets);
+	if(descriptors_[set] == ds) {
+		++stats_.descriptorBindsElided;
+		return;
+	}
+
+	// all pipelines use the same layout, so bound sets stay
+	// valid when the pipeline changes
+	vk::cmdBindDescriptorSets(cmdBuf_, vk::PipelineBindPoint::graphics,
+		context().pipeLayout(), set, {ds}, {});
+	descriptors_[set] = ds;
+	++stats_.descriptorBinds;
+}
+
+void Recorder::bindVertexBuffers(
+		const std::array<vk::Buffer, vertexBindingCount>& buffers,
+		const std::array<vk::DeviceSize, vertexBindingCount>& offsets) {
+
+	// find the range of bindings that changed
+	auto first = vertexBindingCount;
+	auto last = 0u;
+	for(auto i = 0u; i < vertexBindingCount; ++i) {
+		if(buffers[i] != vertexBuffers_[i] ||
+				offsets[i] != vertexOffsets_[i]) {
+			first = std::min(first, i);
+			last = i;
+		}
+	}
+
+	if(first == vertexBindingCount) {
+		++stats_.vertexBufferBindsElided;
+		return;
+	}
+
+	auto count = last + 1 - first;
+	vk::cmdBindVertexBuffers(cmdBuf_, first, {buffers.data() + first, count},
+		{offsets.data() + first, count});
+	vertexBuffers_ = buffers;
+	vertexOffsets_ = offsets;
+	++stats_.vertexBufferBinds;
+}
+
+void Recorder::drawIndirect(vk::Buffer buf, vk::DeviceSize offset,
+		unsigned count, unsigned stride) {
+	vk::cmdDrawIndirect(cmdBuf_, buf, offset, count, stride);
+	++stats_.draws;
+}
+
+void Recorder::draw(unsigned vertexCount, unsigned instanceCount,
+		unsigned firstVertex, unsigned firstInstance) {
+	vk::cmdDraw(cmdBuf_, vertexCount, instanceCount, firstVertex,
+		firstInstance);
+	++stats_.draws;
+}
+
+void Recorder::use(const DeviceObject& obj) {
+	if(layer_) {
+		layer_->use(obj);
+	}
+}
+
+void Recorder::use(const Transform& transform) {
+	use(static_cast<const DeviceObject&>(transform));
+	bound_.transform = &transform;
+}
+
+void Recorder::use(const Scissor& scissor) {
+	use(static_cast<const DeviceObject&>(scissor));
+	bound_.scissor = &scissor;
+}
+
+void Recorder::use(const Paint& paint) {
+	use(static_cast<const DeviceObject&>(paint));
+	bound_.paint = &paint;
+	paintType_ = static_cast<std::uint32_t>(paint.paint().data.frag.type);
+}
+
+void Recorder::use(const Polygon& polygon) {
+	use(static_cast<const DeviceObject&>(polygon));
+	if(trackDamage_ && context().damageTracker()) {
+		context().damageTracker()->drawn(polygon, bound_);
+	}
+}
+
+void Recorder::use(const Text& text) {
+	use(static_cast<const DeviceObject&>(text));
+	if(trackDamage_ && context().damageTracker()) {
+		context().damageTracker()->drawn(text, bound_);
+	}
+}
+
+void Recorder::use(const SdfShape& shape) {
+	use(static_cast<const DeviceObject&>(shape));
+	if(trackDamage_ && context().damageTracker()) {
+		context().damageTracker()->drawn(shape, bound_);
+	}
+}
+
+void Recorder::use(const ShapeBatch& batch) {
+	use(static_cast<const DeviceObject&>(batch));
+	if(trackDamage_ && context().damageTracker()) {
+		context().damageTracker()->drawn(batch, bound_);
+	}
+}
+
+void Recorder::use(const SpriteBatch& batch) {
+	use(static_cast<const DeviceObject&>(batch));
+	if(trackDamage_ && context().damageTracker()) {
+		context().damageTracker()->drawn(batch, bound_);
+	}
+}
+
+void Recorder::category(DrawCategory category) {
+	if(category == category_) {
+		return;
+	}
+
+	category_ = category;
+	if(timingScope_ != GpuTimer::noScope) {
+		context().gpuTimer()->categoryChanged(*this, timingScope_);
+	}
+}
+
+void Recorder::reset() {
+	pipeline_ = {};
+	paintType_ = Context::anyType;
+	pushValid_ = {};
+	vertexBuffers_ = {};
+	vertexOffsets_ = {};
+	descriptors_ = {};
+}
+
+} // namespace rvg
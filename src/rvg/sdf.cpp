@@ -0,0 +1,158 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/sdf.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/util.hpp>
+#include <vpp/vk.hpp>
+#include <dlg/dlg.hpp>
+
+namespace rvg {
+
+constexpr auto instanceSize = sizeof(SdfInstance);
+
+SdfPrimitive sdfRect(Vec2f position, Vec2f size,
+		const std::array<float, 4>& rounding, float stroke) {
+	SdfPrimitive ret;
+	ret.position = position;
+	ret.size = size;
+	ret.rounding = rounding;
+	ret.stroke = stroke;
+	return ret;
+}
+
+SdfPrimitive sdfCircle(Vec2f center, Vec2f radius, float stroke) {
+	SdfPrimitive ret;
+	ret.position = center - radius;
+	ret.size = 2.f * radius;
+	ret.stroke = stroke;
+	ret.ellipse = true;
+	return ret;
+}
+
+SdfPrimitive sdfCircle(Vec2f center, float radius, float stroke) {
+	return sdfCircle(center, {radius, radius}, stroke);
+}
+
+Rect2f sdfBounds(const SdfPrimitive& prim, bool stroke) {
+	// the quad of fill.vert
+	auto expand = stroke ? 0.5f * prim.stroke : 0.f;
+	expand += prim.aa ? Context::fringe() : 0.f;
+	return {prim.position - Vec {expand, expand},
+		prim.size + Vec {2 * expand, 2 * expand}};
+}
+
+SdfInstance sdfInstance(const SdfPrimitive& prim, bool disableFill,
+		bool disableStroke) {
+	dlg_assertm(prim.stroke >= 0.f, "Stroke width must not be negative");
+
+	SdfInstance ret {};
+	ret.position = prim.position;
+	ret.size = prim.size;
+	ret.radii = prim.rounding;
+	ret.color = prim.color;
+	ret.stroke = prim.stroke;
+	ret.flags = (prim.ellipse ? SdfInstance::flagEllipse : 0u) |
+		(prim.aa ? SdfInstance::flagAA : 0u) |
+		(disableFill ? SdfInstance::flagDisableFill : 0u) |
+		(disableStroke ? SdfInstance::flagDisableStroke : 0u);
+	return ret;
+}
+
+// SdfShape
+SdfShape::SdfShape(Context& ctx, const SdfPrimitive& prim, bool deviceLocal) :
+		DeviceObject(ctx), primitive_(prim), deviceLocal_(deviceLocal) {
+	// Aligned to the instance size in the vulkan buffer, so all shapes
+	// in a buffer can share the binding at offset 0, see draw.
+	instance_ = ctx.geometryArena().allocate(instanceSize, deviceLocal,
+		instanceSize);
+	update();
+}
+
+void SdfShape::update() {
+	dlg_assert(valid() && instance_.size());
+	context().registerUpdateDevice(this);
+}
+
+bool SdfShape::updateDevice() {
+	dlg_assert(valid() && instance_.size());
+	auto instance = sdfInstance(primitive_, disableFill_, disableStroke_);
+	upload140(*this, instance_.span(), raw(instance));
+	return false;
+}
+
+void SdfShape::disable(bool disable, DrawType type) {
+	if(type == DrawType::strokeFill || type == DrawType::fill) {
+		disableFill_ = disable;
+	}
+
+	if(type == DrawType::strokeFill || type == DrawType::stroke) {
+		disableStroke_ = disable;
+	}
+
+	context().registerUpdateDevice(this);
+}
+
+bool SdfShape::disabled(DrawType type) const {
+	bool ret = true;
+	if(type == DrawType::strokeFill || type == DrawType::fill) {
+		ret &= disableFill_;
+	}
+
+	if(type == DrawType::strokeFill || type == DrawType::stroke) {
+		ret &= disableStroke_;
+	}
+
+	return ret;
+}
+
+Rect2f SdfShape::drawBounds() const {
+	// the stroke quad contains the fill quad
+	if(!disableStroke_ && primitive_.stroke > 0.f) {
+		return sdfBounds(primitive_, true);
+	} else if(!disableFill_) {
+		return sdfBounds(primitive_, false);
+	}
+
+	return {};
+}
+
+void SdfShape::fill(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	fill(rec);
+}
+
+void SdfShape::fill(Recorder& rec) const {
+	dlg_assertm(valid(), "SdfShape must not be in an invalid state");
+	rec.use(*this);
+	rec.category(primitive_.aa ? DrawCategory::aaFill : DrawCategory::fill);
+	draw(rec, Context::drawTypeDefault);
+}
+
+void SdfShape::stroke(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	stroke(rec);
+}
+
+void SdfShape::stroke(Recorder& rec) const {
+	dlg_assertm(valid(), "SdfShape must not be in an invalid state");
+	rec.use(*this);
+	rec.category(DrawCategory::stroke);
+	draw(rec, Context::drawTypeStroke);
+}
+
+void SdfShape::draw(Recorder& rec, std::uint32_t drawType) const {
+	rec.bindPipeline(ShaderProgram::sdf, vk::PrimitiveTopology::triangleStrip,
+		drawType);
+
+	// The buffer is bound at offset 0 and the instance selected with
+	// firstInstance, so drawing shapes sharing a buffer binds it once.
+	// Only binding 0 is used, the others are dummies.
+	auto buf = instance_.buffer().vkHandle();
+	rec.bindVertexBuffers({buf, buf, buf}, {0u, 0u, 0u});
+	rec.draw(4u, 1u, 0u, unsigned(instance_.offset() / instanceSize));
+}
+
+} // namespace rvg
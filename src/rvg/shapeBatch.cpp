@@ -0,0 +1,198 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/shapeBatch.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/util.hpp>
+#include <vpp/vk.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+
+namespace rvg {
+
+ShapeBatch::ShapeBatch(Context& ctx, bool deviceLocal) :
+		DeviceObject(ctx), buffer_(ctx, sizeof(SdfInstance), deviceLocal) {
+	ctx.registerUpdateDevice(this);
+}
+
+unsigned ShapeBatch::add(const SdfPrimitive& prim) {
+	return add(Span<const SdfPrimitive>(&prim, 1u));
+}
+
+unsigned ShapeBatch::add(Span<const SdfPrimitive> prims) {
+	dlg_assert(valid());
+	auto first = unsigned(instances_.size());
+	for(auto& prim : prims) {
+		instances_.push_back(sdfInstance(prim));
+	}
+
+	buffer_.resized(first, unsigned(instances_.size()));
+	context().registerUpdateDevice(this);
+	return first;
+}
+
+void ShapeBatch::set(unsigned first, const SdfPrimitive& prim) {
+	set(first, Span<const SdfPrimitive>(&prim, 1u));
+}
+
+void ShapeBatch::set(unsigned first, Span<const SdfPrimitive> prims) {
+	dlg_assert(valid());
+	dlg_assert(first + prims.size() <= instances_.size());
+
+	constexpr auto disableMask = SdfInstance::flagDisableFill |
+		SdfInstance::flagDisableStroke;
+	for(auto i = 0u; i < prims.size(); ++i) {
+		auto& instance = instances_[first + i];
+		auto flags = instance.flags & disableMask;
+		instance = sdfInstance(prims[i]);
+		instance.flags |= flags;
+	}
+
+	changed(first, unsigned(prims.size()));
+}
+
+void ShapeBatch::resize(unsigned count) {
+	dlg_assert(valid());
+	auto old = unsigned(instances_.size());
+	if(count == old) {
+		return;
+	}
+
+	instances_.resize(count, sdfInstance({}));
+	buffer_.resized(old, count);
+	context().registerUpdateDevice(this);
+}
+
+void ShapeBatch::disable(unsigned i, bool disable, DrawType type) {
+	dlg_assert(valid() && i < instances_.size());
+	auto bits = 0u;
+	if(type == DrawType::strokeFill || type == DrawType::fill) {
+		bits |= SdfInstance::flagDisableFill;
+	}
+
+	if(type == DrawType::strokeFill || type == DrawType::stroke) {
+		bits |= SdfInstance::flagDisableStroke;
+	}
+
+	auto& flags = instances_[i].flags;
+	flags = disable ? (flags | bits) : (flags & ~bits);
+	changed(i, 1u);
+}
+
+bool ShapeBatch::disabled(unsigned i, DrawType type) const {
+	dlg_assert(i < instances_.size());
+	auto flags = instances_[i].flags;
+	bool ret = true;
+	if(type == DrawType::strokeFill || type == DrawType::fill) {
+		ret &= bool(flags & SdfInstance::flagDisableFill);
+	}
+
+	if(type == DrawType::strokeFill || type == DrawType::stroke) {
+		ret &= bool(flags & SdfInstance::flagDisableStroke);
+	}
+
+	return ret;
+}
+
+SdfPrimitive ShapeBatch::primitive(unsigned i) const {
+	dlg_assert(i < instances_.size());
+	auto& instance = instances_[i];
+	SdfPrimitive ret;
+	ret.position = instance.position;
+	ret.size = instance.size;
+	ret.rounding = instance.radii;
+	ret.stroke = instance.stroke;
+	ret.color = instance.color;
+	ret.ellipse = instance.flags & SdfInstance::flagEllipse;
+	ret.aa = instance.flags & SdfInstance::flagAA;
+	return ret;
+}
+
+void ShapeBatch::changed(unsigned first, unsigned count) {
+	buffer_.changed(first, count);
+	context().registerUpdateDevice(this);
+}
+
+Rect2f ShapeBatch::drawBounds() const {
+	Rect2f ret {};
+	for(auto i = 0u; i < instances_.size(); ++i) {
+		auto prim = primitive(i);
+		auto fill = !disabled(i, DrawType::fill);
+		auto stroke = !disabled(i, DrawType::stroke) && prim.stroke > 0.f;
+		if(fill || stroke) {
+			ret = uniteRects(ret, sdfBounds(prim, stroke));
+		}
+	}
+
+	return ret;
+}
+
+bool ShapeBatch::updateDevice() {
+	dlg_assert(valid() && buffer_.valid());
+	auto count = unsigned(instances_.size());
+	auto rerecord = buffer_.reserve(count);
+	if(rerecord) {
+		context().rerecordCause(*this, "ShapeBatch: instance buffer changed");
+	}
+
+	auto first = buffer_.dirtyBegin();
+	auto size = (buffer_.dirtyEnd() - first) * sizeof(SdfInstance);
+	auto data = reinterpret_cast<const std::byte*>(instances_.data() + first);
+	buffer_.upload(*this, count, {data, size});
+	return rerecord;
+}
+
+void ShapeBatch::fill(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	fill(rec);
+}
+
+void ShapeBatch::fill(Recorder& rec) const {
+	dlg_assertm(valid(), "ShapeBatch must not be in an invalid state");
+	rec.use(*this);
+	rec.category(DrawCategory::fill);
+	draw(rec, Context::drawTypeDefault);
+}
+
+void ShapeBatch::stroke(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	stroke(rec);
+}
+
+void ShapeBatch::stroke(Recorder& rec) const {
+	dlg_assertm(valid(), "ShapeBatch must not be in an invalid state");
+	rec.use(*this);
+	rec.category(DrawCategory::stroke);
+	draw(rec, Context::drawTypeStroke);
+}
+
+void ShapeBatch::draw(Recorder& rec, std::uint32_t drawType) const {
+	rec.bindPipeline(ShaderProgram::sdf, vk::PrimitiveTopology::triangleStrip,
+		drawType);
+	buffer_.draw(rec);
+}
+
+// RectBatch
+unsigned RectBatch::add(Vec2f position, Vec2f size, Vec4u8 color,
+		float stroke, const std::array<float, 4>& rounding) {
+	auto prim = sdfRect(position, size, rounding, stroke);
+	prim.color = color;
+	return add(prim);
+}
+
+// CircleBatch
+unsigned CircleBatch::add(Vec2f center, Vec2f radius, Vec4u8 color,
+		float stroke) {
+	auto prim = sdfCircle(center, radius, stroke);
+	prim.color = color;
+	return add(prim);
+}
+
+unsigned CircleBatch::add(Vec2f center, float radius, Vec4u8 color,
+		float stroke) {
+	return add(center, Vec {radius, radius}, color, stroke);
+}
+
+} // namespace rvg
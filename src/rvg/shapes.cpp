@@ -10,6 +10,93 @@
 
 namespace rvg {
 
+void rectOutline(std::vector<Vec2f>& points, Vec2f position, Vec2f size,
+		const std::array<float, 4>& rounding) {
+	constexpr auto steps = 12u;
+	auto first = points.size();
+
+	// topRight
+	if(rounding[0] != 0.f) {
+		dlg_assert(rounding[0] > 0.f);
+		points.push_back(position + Vec {0.f, rounding[0]});
+		auto a1 = ktc::CenterArc {
+			position + Vec{rounding[0], rounding[0]},
+			{rounding[0], rounding[0]},
+			nytl::constants::pi,
+			nytl::constants::pi * 1.5f
+		};
+		ktc::flatten(a1, points, steps);
+	} else {
+		points.push_back(position);
+	}
+
+	// topLeft
+	if(rounding[1] != 0.f) {
+		dlg_assert(rounding[1] > 0.f);
+		auto x = position.x + size.x - rounding[1];
+		points.push_back({x, position.y});
+		auto a1 = ktc::CenterArc {
+			{x, position.y + rounding[1]},
+			{rounding[1], rounding[1]},
+			nytl::constants::pi * 1.5f,
+			nytl::constants::pi * 2.f
+		};
+		ktc::flatten(a1, points, steps);
+	} else {
+		points.push_back(position + Vec {size.x, 0.f});
+	}
+
+	// bottomRight
+	if(rounding[2] != 0.f) {
+		dlg_assert(rounding[2] > 0.f);
+		auto y = position.y + size.y - rounding[2];
+		points.push_back({position.x + size.x, y});
+		auto a1 = ktc::CenterArc {
+			{position.x + size.x - rounding[2], y},
+			{rounding[2], rounding[2]},
+			0.f,
+			nytl::constants::pi * 0.5f
+		};
+		ktc::flatten(a1, points, steps);
+	} else {
+		points.push_back(position + size);
+	}
+
+	// bottomLeft
+	if(rounding[3] != 0.f) {
+		dlg_assert(rounding[3] > 0.f);
+		points.push_back({position.x + rounding[3], position.y + size.y});
+		auto y = position.y + size.y - rounding[3];
+		auto a1 = ktc::CenterArc {
+			{position.x + rounding[3], y},
+			{rounding[3], rounding[3]},
+			nytl::constants::pi * 0.5f,
+			nytl::constants::pi * 1.f,
+		};
+		ktc::flatten(a1, points, steps);
+	} else {
+		points.push_back(position + Vec {0.f, size.y});
+	}
+
+	// close it
+	auto start = points[first];
+	points.push_back(start);
+}
+
+void circleOutline(std::vector<Vec2f>& points, Vec2f center, Vec2f radius,
+		unsigned count, float startAngle) {
+	points.reserve(points.size() + count + 1);
+
+	auto a = startAngle;
+	auto d = 2 * nytl::constants::pi / count;
+	for(auto i = 0u; i < count + 1; ++i) {
+		using namespace nytl::vec::cw::operators;
+		auto p = Vec {std::cos(a), std::sin(a)} * radius;
+		points.push_back(center + p);
+		a += d;
+	}
+}
+
 // Shape
 Shape::Shape(Context& ctx, std::vector<Vec2f> p, const DrawMode& d) :
 		state_{std::move(p), std::move(d)}, polygon_(ctx) {
@@ -40,90 +127,18 @@ RectShape::RectShape(Context& ctx, Vec2f p, Vec2f s,
 }
 
 void RectShape::update() {
-	if(state_.rounding == std::array<float, 4>{}) {
-		auto points = {
-			state_.position,
-			state_.position + Vec {state_.size.x, 0.f},
-			state_.position + state_.size,
-			state_.position + Vec {0.f, state_.size.y},
-			state_.position
-		};
-		polygon_.update(points, state_.drawMode);
-	} else {
-		constexpr auto steps = 12u;
-		std::vector<Vec2f> points;
-
-		auto& position = state_.position;
-		auto& size = state_.size;
-		auto& rounding = state_.rounding;
-
-		// topRight
-		if(rounding[0] != 0.f) {
-			dlg_assert(rounding[0] > 0.f);
-			points.push_back(position + Vec {0.f, rounding[0]});
-			auto a1 = ktc::CenterArc {
-				position + Vec{rounding[0], rounding[0]},
-				{rounding[0], rounding[0]},
-				nytl::constants::pi,
-				nytl::constants::pi * 1.5f
-			};
-			ktc::flatten(a1, points, steps);
-		} else {
-			points.push_back(position);
-		}
-
-		// topLeft
-		if(rounding[1] != 0.f) {
-			dlg_assert(rounding[1] > 0.f);
-			auto x = position.x + size.x - rounding[1];
-			points.push_back({x, position.y});
-			auto a1 = ktc::CenterArc {
-				{x, position.y + rounding[1]},
-				{rounding[1], rounding[1]},
-				nytl::constants::pi * 1.5f,
-				nytl::constants::pi * 2.f
-			};
-			ktc::flatten(a1, points, steps);
-		} else {
-			points.push_back(position + Vec {size.x, 0.f});
-		}
-
-		// bottomRight
-		if(rounding[2] != 0.f) {
-			dlg_assert(rounding[2] > 0.f);
-			auto y = position.y + size.y - rounding[2];
-			points.push_back({position.x + size.x, y});
-			auto a1 = ktc::CenterArc {
-				{position.x + size.x - rounding[2], y},
-				{rounding[2], rounding[2]},
-				0.f,
-				nytl::constants::pi * 0.5f
-			};
-			ktc::flatten(a1, points, steps);
+	// the outline is only generated when the polygon is computed
+	polygon_.update([s = state_](std::vector<Vec2f>& points) {
+		if(s.rounding == std::array<float, 4>{}) {
+			points.push_back(s.position);
+			points.push_back(s.position + Vec {s.size.x, 0.f});
+			points.push_back(s.position + s.size);
+			points.push_back(s.position + Vec {0.f, s.size.y});
+			points.push_back(s.position);
 		} else {
-			points.push_back(position + size);
+			rectOutline(points, s.position, s.size, s.rounding);
 		}
-
-		// bottomLeft
-		if(rounding[3] != 0.f) {
-			dlg_assert(rounding[3] > 0.f);
-			points.push_back({position.x + rounding[3], position.y + size.y});
-			auto y = position.y + size.y - rounding[3];
-			auto a1 = ktc::CenterArc {
-				{position.x + rounding[3], y},
-				{rounding[3], rounding[3]},
-				nytl::constants::pi * 0.5f,
-				nytl::constants::pi * 1.f,
-			};
-			ktc::flatten(a1, points, steps);
-		} else {
-			points.push_back(position + Vec {0.f, size.y});
-		}
-
-		// close it
-		points.push_back(points[0]);
-		polygon_.update(points, state_.drawMode);
-	}
+	}, state_.drawMode);
 }
 
 void RectShape::disable(bool d, DrawType t) {
@@ -160,19 +175,11 @@ CircleShape::CircleShape(Context& ctx,
 void CircleShape::update() {
 	dlg_assertl(dlg_level_warn, state_.pointCount > 2);
 
-	std::vector<Vec2f> pts;
-	pts.reserve(state_.pointCount);
-
-	auto a = state_.startAngle;
-	auto d = 2 * nytl::constants::pi / state_.pointCount;
-	for(auto i = 0u; i < state_.pointCount + 1; ++i) {
-		using namespace nytl::vec::cw::operators;
-		auto p = Vec {std::cos(a), std::sin(a)} * state_.radius;
-		pts.push_back(state_.center + p);
-		a += d;
-	}
-
-	polygon_.update(pts, state_.drawMode);
+	// the outline is only generated when the polygon is computed
+	polygon_.update([s = state_](std::vector<Vec2f>& points) {
+		circleOutline(points, s.center, s.radius, s.pointCount,
+			s.startAngle);
+	}, state_.drawMode);
 }
 
 void CircleShape::disable(bool d, DrawType t) {
@@ -0,0 +1,184 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/spriteBatch.hpp>
+#include <rvg/textureAtlas.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <rvg/util.hpp>
+#include <vpp/vk.hpp>
+#include <dlg/dlg.hpp>
+#include <nytl/vecOps.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace rvg {
+
+SpriteInstance spriteInstance(const Sprite& sprite, bool disabled) {
+	auto c = std::cos(sprite.rotation);
+	auto s = std::sin(sprite.rotation);
+	auto center = sprite.position + 0.5f * sprite.size;
+
+	SpriteInstance ret {};
+	ret.axisX = sprite.size.x * Vec2f {c, s};
+	ret.axisY = sprite.size.y * Vec2f {-s, c};
+	ret.origin = center - 0.5f * ret.axisX - 0.5f * ret.axisY;
+	ret.tint = sprite.tint;
+	ret.flags = disabled ? SpriteInstance::flagDisabled : 0u;
+	ret.regionPosition = sprite.region.position;
+	ret.regionSize = sprite.region.size;
+	return ret;
+}
+
+Rect2f spriteBounds(const Sprite& sprite) {
+	auto instance = spriteInstance(sprite);
+	auto min = instance.origin;
+	auto max = instance.origin;
+	for(auto p : {instance.origin + instance.axisX,
+			instance.origin + instance.axisY,
+			instance.origin + instance.axisX + instance.axisY}) {
+		for(auto i = 0u; i < 2; ++i) {
+			min[i] = std::min(min[i], p[i]);
+			max[i] = std::max(max[i], p[i]);
+		}
+	}
+
+	return {min, max - min};
+}
+
+// SpriteBatch
+SpriteBatch::SpriteBatch(Context& ctx, const TextureAtlas& atlas,
+		bool deviceLocal) : DeviceObject(ctx), atlas_(&atlas),
+			buffer_(ctx, sizeof(SpriteInstance), deviceLocal) {
+	ctx.registerUpdateDevice(this);
+}
+
+unsigned SpriteBatch::add(const Sprite& sprite) {
+	return add(Span<const Sprite>(&sprite, 1u));
+}
+
+unsigned SpriteBatch::add(Span<const Sprite> sprites) {
+	dlg_assert(valid());
+	auto first = unsigned(sprites_.size());
+	sprites_.insert(sprites_.end(), sprites.begin(), sprites.end());
+	disabled_.resize(sprites_.size(), false);
+	buffer_.resized(first, unsigned(sprites_.size()));
+	context().registerUpdateDevice(this);
+	return first;
+}
+
+void SpriteBatch::set(unsigned first, const Sprite& sprite) {
+	set(first, Span<const Sprite>(&sprite, 1u));
+}
+
+void SpriteBatch::set(unsigned first, Span<const Sprite> sprites) {
+	dlg_assert(valid());
+	dlg_assert(first + sprites.size() <= sprites_.size());
+	std::copy(sprites.begin(), sprites.end(), sprites_.begin() + first);
+	changed(first, unsigned(sprites.size()));
+}
+
+void SpriteBatch::remove(unsigned i) {
+	dlg_assert(valid() && i < sprites_.size());
+	auto last = unsigned(sprites_.size() - 1);
+	if(i != last) {
+		sprites_[i] = sprites_[last];
+		disabled_[i] = disabled_[last];
+		changed(i, 1u);
+	}
+
+	resize(last);
+}
+
+void SpriteBatch::resize(unsigned count) {
+	dlg_assert(valid());
+	auto old = unsigned(sprites_.size());
+	if(count == old) {
+		return;
+	}
+
+	sprites_.resize(count);
+	disabled_.resize(count, false);
+	buffer_.resized(old, count);
+	context().registerUpdateDevice(this);
+}
+
+void SpriteBatch::disable(unsigned i, bool disable) {
+	dlg_assert(valid() && i < sprites_.size());
+	disabled_[i] = disable;
+	changed(i, 1u);
+}
+
+bool SpriteBatch::disabled(unsigned i) const {
+	dlg_assert(i < sprites_.size());
+	return disabled_[i];
+}
+
+const Sprite& SpriteBatch::sprite(unsigned i) const {
+	dlg_assert(i < sprites_.size());
+	return sprites_[i];
+}
+
+void SpriteBatch::changed(unsigned first, unsigned count) {
+	buffer_.changed(first, count);
+	context().registerUpdateDevice(this);
+}
+
+Rect2f SpriteBatch::drawBounds() const {
+	Rect2f ret {};
+	for(auto i = 0u; i < sprites_.size(); ++i) {
+		if(!disabled_[i]) {
+			ret = uniteRects(ret, spriteBounds(sprites_[i]));
+		}
+	}
+
+	return ret;
+}
+
+bool SpriteBatch::updateDevice() {
+	dlg_assert(valid() && buffer_.valid());
+	auto count = unsigned(sprites_.size());
+	auto rerecord = buffer_.reserve(count);
+	if(rerecord) {
+		context().rerecordCause(*this, "SpriteBatch: instance buffer changed");
+	}
+
+	std::vector<SpriteInstance> instances;
+	instances.reserve(buffer_.dirtyEnd() - buffer_.dirtyBegin());
+	for(auto i = buffer_.dirtyBegin(); i < buffer_.dirtyEnd(); ++i) {
+		instances.push_back(spriteInstance(sprites_[i], disabled_[i]));
+	}
+
+	auto data = reinterpret_cast<const std::byte*>(instances.data());
+	auto size = instances.size() * sizeof(SpriteInstance);
+	buffer_.upload(*this, count, {data, size});
+	return rerecord;
+}
+
+void SpriteBatch::draw(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	draw(rec);
+}
+
+void SpriteBatch::draw(Recorder& rec) const {
+	dlg_assertm(valid(), "SpriteBatch must not be in an invalid state");
+	dlg_assert(atlas_ && atlas_->valid());
+	rec.use(*this);
+	rec.use(*atlas_);
+	rec.category(DrawCategory::fill);
+
+	// the atlas is bound like the font atlas of texts
+	if(context().bindless()) {
+		auto& slot = atlas_->bindlessSlot();
+		rec.push(Context::fontPushSlot, slot.valid() ? slot.slot() : 0u);
+	} else {
+		rec.bindDescriptorSet(Context::fontBindSet, atlas_->ds());
+	}
+
+	rec.bindPipeline(ShaderProgram::sprite,
+		vk::PrimitiveTopology::triangleStrip, Context::drawTypeDefault);
+	buffer_.draw(rec);
+}
+
+} // namespace rvg
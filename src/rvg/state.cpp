@@ -4,6 +4,7 @@
 
 #include <rvg/util.hpp>
 #include <rvg/state.hpp>
+#include <rvg/recorder.hpp>
 #include <vpp/trackedDescriptor.hpp>
 #include <vpp/vk.hpp>
 #include <nytl/matOps.hpp>
@@ -19,8 +20,14 @@ Transform::Transform(Context& ctx, bool deviceLocal) :
 Transform::Transform(Context& ctx, const Mat4f& m, bool deviceLocal) :
 		DeviceObject(ctx), matrix_(m) {
 
+	if(ctx.bindless()) {
+		slot_ = ctx.bindlessTransforms().allocate();
+		updateDevice();
+		return;
+	}
+
 	auto usage = nytl::Flags {vk::BufferUsageBits::uniformBuffer};
-	if(deviceLocal) {
+	if(deviceLocal || !ctx.directWrites()) {
 		usage |= vk::BufferUsageBits::transferDst;
 	}
 
@@ -36,30 +43,81 @@ Transform::Transform(Context& ctx, const Mat4f& m, bool deviceLocal) :
 	update.uniform({{ubo_.buffer(), ubo_.offset(), ubo_.size()}});
 }
 
+Transform::~Transform() {
+	// pending frames might still use them
+	if(valid()) {
+		context().keepAlive(std::move(ubo_));
+		context().keepAlive(std::move(ds_));
+	}
+}
+
+Transform& Transform::operator=(Transform&& rhs) noexcept {
+	if(valid()) {
+		context().keepAlive(std::move(ubo_));
+		context().keepAlive(std::move(ds_));
+	}
+
+	DeviceObject::operator=(std::move(rhs));
+	matrix_ = rhs.matrix_;
+	ubo_ = std::move(rhs.ubo_);
+	ds_ = std::move(rhs.ds_);
+	slot_ = std::move(rhs.slot_);
+	return *this;
+}
+
 bool Transform::updateDevice() {
+	if(slot_.valid()) {
+		auto ptr = context().bindlessTransforms().write(slot_.slot());
+		write(ptr, matrix_);
+		return false;
+	}
+
 	dlg_assert(valid() && ubo_.size() && ds_);
-	upload140(*this, ubo_, vpp::raw(matrix_));
+	upload140(*this, ubo_, raw(matrix_));
 	return false;
 }
 
 void Transform::update() {
-	dlg_assert(valid() && ds_ && ubo_.size());
+	dlg_assert(valid() && ((ds_ && ubo_.size()) || slot_.valid()));
 	context().registerUpdateDevice(this);
 }
 
 void Transform::bind(vk::CommandBuffer cb) const {
+	if(slot_.valid()) {
+		Recorder rec(context(), cb);
+		bind(rec);
+		return;
+	}
+
 	dlg_assert(valid() && ubo_.size() && ds_);
 	vk::cmdBindDescriptorSets(cb, vk::PipelineBindPoint::graphics,
 		context().pipeLayout(), Context::transformBindSet, {ds_}, {});
 }
 
+void Transform::bind(Recorder& rec) const {
+	rec.use(*this);
+	if(slot_.valid()) {
+		rec.push(Context::transformPushSlot, slot_.slot());
+		return;
+	}
+
+	dlg_assert(valid() && ubo_.size() && ds_);
+	rec.bindDescriptorSet(Context::transformBindSet, ds_);
+}
+
 // Scissor
 constexpr auto scissorUboSize = sizeof(Vec2f) * 2;
 Scissor::Scissor(Context& ctx, const Rect2f& r, bool deviceLocal)
 	: DeviceObject(ctx), rect_(r) {
 
+	if(ctx.bindless()) {
+		slot_ = ctx.bindlessScissors().allocate();
+		updateDevice();
+		return;
+	}
+
 	auto usage = nytl::Flags {vk::BufferUsageBits::uniformBuffer};
-	if(deviceLocal) {
+	if(deviceLocal || !ctx.directWrites()) {
 		usage |= vk::BufferUsageBits::transferDst;
 	}
 
@@ -75,22 +133,68 @@ Scissor::Scissor(Context& ctx, const Rect2f& r, bool deviceLocal)
 	update.uniform({{ubo_.buffer(), ubo_.offset(), ubo_.size()}});
 }
 
+Scissor::~Scissor() {
+	// pending frames might still use them
+	if(valid()) {
+		context().keepAlive(std::move(ubo_));
+		context().keepAlive(std::move(ds_));
+	}
+}
+
+Scissor& Scissor::operator=(Scissor&& rhs) noexcept {
+	if(valid()) {
+		context().keepAlive(std::move(ubo_));
+		context().keepAlive(std::move(ds_));
+	}
+
+	DeviceObject::operator=(std::move(rhs));
+	rect_ = rhs.rect_;
+	ubo_ = std::move(rhs.ubo_);
+	ds_ = std::move(rhs.ds_);
+	slot_ = std::move(rhs.slot_);
+	return *this;
+}
+
 void Scissor::update() {
-	dlg_assert(valid() && ds_ && ubo_.size());
+	dlg_assert(valid() && ((ds_ && ubo_.size()) || slot_.valid()));
 	context().registerUpdateDevice(this);
 }
 
 bool Scissor::updateDevice() {
+	if(slot_.valid()) {
+		auto ptr = context().bindlessScissors().write(slot_.slot());
+		write(ptr, rect_.position);
+		write(ptr, rect_.size);
+		return false;
+	}
+
 	dlg_assert(ubo_.size() && ds_);
-	upload140(*this, ubo_, vpp::raw(rect_.position),
-		vpp::raw(rect_.size));
+	upload140(*this, ubo_, raw(rect_.position),
+		raw(rect_.size));
 	return false;
 }
 
 void Scissor::bind(vk::CommandBuffer cmdb) const {
+	if(slot_.valid()) {
+		Recorder rec(context(), cmdb);
+		bind(rec);
+		return;
+	}
+
 	dlg_assert(ubo_.size() && ds_);
 	vk::cmdBindDescriptorSets(cmdb, vk::PipelineBindPoint::graphics,
 		context().pipeLayout(), Context::scissorBindSet, {ds_}, {});
 }
 
+void Scissor::bind(Recorder& rec) const {
+	rec.use(*this);
+	if(slot_.valid()) {
+		rec.push(Context::scissorPushSlot, slot_.slot());
+		return;
+	}
+
+	dlg_assert(ubo_.size() && ds_);
+	rec.bindDescriptorSet(Context::scissorBindSet, ds_);
+}
+
 } // namespace rvg
@@ -3,8 +3,10 @@
 // See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
 
 #include <rvg/util.hpp>
+#include <rvg/tracing.hpp>
 #include <rvg/font.hpp>
 #include <rvg/text.hpp>
+#include <rvg/recorder.hpp>
 #include <vpp/vk.hpp>
 #include <nytl/utf.hpp>
 #include <rvg/fontstash.h>
@@ -14,12 +16,74 @@ namespace rvg {
 constexpr auto vertIndex0 = 2; // vertex index on the left
 constexpr auto vertIndex2 = 3; // vertex index on the right
 
+void layoutText(FONScontext& stash, int font, unsigned height,
+		Vec2f position, std::string_view text, std::vector<Vec2f>& positions,
+		std::vector<Vec2f>& uvs, const std::function<void()>& expand) {
+	// good approximation for usually-ascii
+	positions.reserve(positions.size() + text.size());
+	uvs.reserve(uvs.size() + text.size());
+
+	auto addVert = [&](const FONSquad& q, unsigned i) {
+		auto left = i == 0 || i == 3;
+		auto top = i == 0 || i == 1;
+
+		positions.push_back({
+			left ? q.x0 : q.x1,
+			top ? q.y0 : q.y1});
+		uvs.push_back({
+			left ? q.s0 : q.s1,
+			top ? q.t0 : q.t1});
+	};
+
+	FONSquad q;
+	FONStextIter iter;
+
+	fonsSetSize(&stash, height);
+	fonsSetFont(&stash, font);
+
+	fonsTextIterInit(&stash, &iter, position.x, position.y, text.data(),
+		text.data() + text.size(), FONS_GLYPH_BITMAP_REQUIRED);
+
+	auto prev = iter;
+	while(fonsTextIterNext(&stash, &iter, &q)) {
+		if(iter.prevGlyphIndex == -1) {
+			if(!expand) {
+				prev = iter;
+				continue;
+			}
+
+			expand();
+			iter = prev;
+			fonsTextIterNext(&stash, &iter, &q); // try again
+			dlg_assert(iter.prevGlyphIndex != -1);
+		}
+
+		// we render using a strip pipe. Those doubled points allow us to
+		// jump to the next quad. Not less efficient than using a list pipe
+		for(auto i : {1, 1, 0, 2, 3, 3}) {
+			addVert(q, i);
+		}
+
+		prev = iter;
+	}
+}
+
+Rect2f textBounds(FONScontext& stash, int font, unsigned height,
+		std::string_view text) {
+	float bounds[4];
+	fonsSetFont(&stash, font);
+	fonsSetSize(&stash, height);
+	fonsTextBounds(&stash, 0, 0, text.data(), text.data() + text.size(),
+		bounds);
+	return {bounds[0], bounds[1], bounds[2] - bounds[0], bounds[3] - bounds[1]};
+}
+
 // Text
 Text::Text(Context& ctx, Vec2f p, std::string t, Font& f, unsigned h) :
 		DeviceObject(ctx), state_{std::move(t), f, p, h} {
 
 	f.atlas().added(*this);
-	update();
+	layout();
 	updateDevice();
 }
 
@@ -31,9 +95,10 @@ Text::Text(Text&& rhs) noexcept : DeviceObject(std::move(rhs)) {
 	disable_ = rhs.disable_;
 	posCache_ = std::move(rhs.posCache_);
 	uvCache_ = std::move(rhs.uvCache_);
-	posBuf_ = std::move(rhs.posBuf_);
-	uvBuf_ = std::move(rhs.uvBuf_);
+	cmd_ = std::move(rhs.cmd_);
+	vertices_ = std::move(rhs.vertices_);
 	oldAtlas_  = rhs.oldAtlas_;
+	pendingLayout_ = rhs.pendingLayout_;
 
 	if(valid()) {
 		font().atlas().moved(rhs, *this);
@@ -47,9 +112,10 @@ Text& Text::operator=(Text&& rhs) noexcept {
 	disable_ = rhs.disable_;
 	posCache_ = std::move(rhs.posCache_);
 	uvCache_ = std::move(rhs.uvCache_);
-	posBuf_ = std::move(rhs.posBuf_);
-	uvBuf_ = std::move(rhs.uvBuf_);
+	cmd_ = std::move(rhs.cmd_);
+	vertices_ = std::move(rhs.vertices_);
 	oldAtlas_  = rhs.oldAtlas_;
+	pendingLayout_ = rhs.pendingLayout_;
 
 	if(valid()) {
 		font().atlas().moved(rhs, *this);
@@ -67,140 +133,113 @@ Text::~Text() {
 
 void Text::update() {
 	dlg_assert(valid() && font().valid() && height() > 0);
+	RVG_TRACE_EVENT("Text::update", "Text");
 	auto& font = state_.font;
-	auto& text = state_.text;
-	auto& position = state_.position;
-
-	dlg_assert(font.valid());
 
 	if(oldAtlas_ && &font.atlas() != oldAtlas_) {
-		context().rerecord();
+		context().rerecord(*this, "Text: atlas changed");
 		oldAtlas_->removed(*this);
 		font.atlas().added(*this);
 		oldAtlas_ = &font.atlas();
 	}
 
-	posCache_.clear();
-	uvCache_.clear();
-
-	// good approximation for usually-ascii
-	posCache_.reserve(text.size());
-	uvCache_.reserve(text.size());
-
-	auto addVert = [&](const FONSquad& q, unsigned i) {
-		auto left = i == 0 || i == 3;
-		auto top = i == 0 || i == 1;
-
-		posCache_.push_back({
-			left ? q.x0 : q.x1,
-			top ? q.y0 : q.y1});
-		uvCache_.push_back({
-			left ? q.s0 : q.s1,
-			top ? q.t0 : q.t1});
-	};
-
-	auto* stash = font.atlas().stash();
-	FONSquad q;
-	FONStextIter iter;
+	if(context().deferredUpdates()) {
+		pendingLayout_ = true;
+	} else {
+		layout();
+	}
 
-	fonsSetSize(stash, state_.height);
-	fonsSetFont(stash, font.id());
+	context().registerUpdateDevice(this);
+}
 
-	fonsTextIterInit(stash, &iter, position.x, position.y, text.data(),
-		text.data() + text.size(), FONS_GLYPH_BITMAP_REQUIRED);
+void Text::updateHost() {
+	if(pendingLayout_) {
+		layout();
+	}
+}
 
-	auto prev = iter;
-	while(fonsTextIterNext(stash, &iter, &q)) {
-		if(iter.prevGlyphIndex == -1) {
-			font.atlas().expand();
+void Text::layout() {
+	auto& font = state_.font;
+	auto& atlas = font.atlas();
 
-			iter = prev;
-			fonsTextIterNext(stash, &iter, &q); // try again
-			dlg_assert(iter.prevGlyphIndex != -1);
-		}
+	dlg_assert(font.valid());
+	pendingLayout_ = false;
+	posCache_.clear();
+	uvCache_.clear();
 
-		// we render using a strip pipe. Those doubled points allow us to
-		// jump to the next quad. Not less efficient than using a list pipe
-		for(auto i : {1, 1, 0, 2, 3, 3}) {
-			addVert(q, i);
-		}
+	layoutText(*atlas.stash(), font.id(), state_.height, state_.position,
+		state_.text, posCache_, uvCache_, [&]{ atlas.expand(); });
 
-		prev = iter;
-	}
-
-	font.atlas().validate();
-	context().registerUpdateDevice(this);
+	atlas.validate();
 	dlg_assert(posCache_.size() == uvCache_.size());
 }
 
 bool Text::updateDevice() {
+	updateHost();
 	bool rerecord = false;
 
 	// now upload data to gpu
+	// the indirect command has a fixed place, so moving the vertices
+	// inside their block only changes the command, see VertexRange
 	dlg_assert(posCache_.size() == uvCache_.size());
-	auto checkResize = [&](auto& buf, auto needed) {
-		if(buf.size() == 0u || buf.size() < needed) {
-			needed = std::max<vk::DeviceSize>(2u * needed, 32u);
-			auto usage = nytl::Flags{vk::BufferUsageBits::vertexBuffer};
-			if(deviceLocal_) {
-				usage |= vk::BufferUsageBits::transferDst;
-			}
-
-			auto memBits = deviceLocal_ ?
-				context().device().deviceMemoryTypes() :
-				context().device().hostMemoryTypes();
-			buf = {context().bufferAllocator(), needed, usage, 4u, memBits};
-			rerecord = true;
-		}
-	};
+	auto& arena = context().geometryArena();
+	if(!cmd_.size()) {
+		cmd_ = arena.allocate(sizeof(vk::DrawIndirectCommand),
+			deviceLocal_, 4u);
+		context().rerecordCause(*this, "Text: command allocated");
+		rerecord = true;
+	}
 
-	auto posCacheSize = sizeof(Vec2f) * posCache_.size();
-	checkResize(posBuf_, sizeof(vk::DrawIndirectCommand) + posCacheSize);
-	checkResize(uvBuf_, sizeof(Vec2f) * uvCache_.size());
+	auto count = unsigned(posCache_.size());
+	if(arena.resize(vertices_, count, VertexFormat::aux, deviceLocal_)) {
+		context().rerecordCause(*this, "Text: vertices changed block");
+		rerecord = true;
+	}
 
-	// positionBuf contains the indirect draw command
 	vk::DrawIndirectCommand cmd {};
-	cmd.vertexCount = !disable_ * posCache_.size();
+	cmd.vertexCount = !disable_ * count;
 	cmd.instanceCount = 1;
-
-	// upload140(*this, posBuf_, vpp::raw(cmd), vpp::raw(posCache_));
-	upload140(*this, posBuf_, vpp::raw(cmd), vpp::raw(*posCache_.data(),
-		posCache_.size()));
-
-	if(!uvCache_.empty()) {
-		// upload140(*this, uvBuf_, vpp::raw(uvCache_));
-		upload140(*this, uvBuf_, vpp::raw(*uvCache_.data(),
-			uvCache_.size()));
-	} else {
-		// write something for validation layers
-		upload140(*this, uvBuf_, vpp::raw(cmd));
+	cmd.firstVertex = vertices_.first();
+	upload140(*this, cmd_.span(), raw(cmd));
+
+	if(count) {
+		upload140(*this, vertices_.stream(VertexStream::position),
+			raw(*posCache_.data(), count));
+		upload140(*this, vertices_.stream(VertexStream::aux),
+			raw(*uvCache_.data(), count));
 	}
 
 	return rerecord;
 }
 
 void Text::draw(vk::CommandBuffer cb) const {
+	Recorder rec(context(), cb);
+	draw(rec);
+}
+
+void Text::draw(Recorder& rec) const {
 	dlg_assert(valid() && font().valid());
+	rec.use(*this);
+	rec.use(font().atlas());
+	rec.category(DrawCategory::text);
+
+	if(context().bindless()) {
+		auto& slot = font().atlas().bindlessSlot();
+		rec.push(Context::fontPushSlot, slot.valid() ? slot.slot() : 0u);
+	} else {
+		rec.bindDescriptorSet(Context::fontBindSet, font().atlas().ds());
+	}
 
-	vk::cmdBindPipeline(cb, vk::PipelineBindPoint::graphics,
-		context().stripPipe());
-	vk::cmdBindDescriptorSets(cb, vk::PipelineBindPoint::graphics,
-		context().pipeLayout(), Context::fontBindSet,
-		{font().atlas().ds()}, {});
-
-	static constexpr auto type = uint32_t(1);
-	vk::cmdPushConstants(cb, context().pipeLayout(),
-		vk::ShaderStageBits::fragment, 0, 4, &type);
-
-	auto ioff = sizeof(vk::DrawIndirectCommand);
-	auto off = posBuf_.offset() + ioff;
-
-	// use a dummy color buffer
-	auto pBuf = posBuf_.buffer().vkHandle();
-	auto uvBuf = uvBuf_.buffer().vkHandle();
-	vk::cmdBindVertexBuffers(cb, 0, {pBuf, uvBuf, pBuf},
-		{off, uvBuf_.offset(), off});
-	vk::cmdDrawIndirect(cb, posBuf_.buffer(), posBuf_.offset(), 1, 0);
+	rec.bindPipeline(vk::PrimitiveTopology::triangleStrip,
+		Context::drawTypeText);
+
+	// the position stream is used as dummy color buffer
+	auto buf = vertices_.buffer();
+	rec.bindVertexBuffers({buf, buf, buf}, {
+		vertices_.streamOffset(VertexStream::position),
+		vertices_.streamOffset(VertexStream::aux),
+		vertices_.streamOffset(VertexStream::color)});
+	rec.drawIndirect(cmd_.buffer(), cmd_.offset(), 1, 0);
 }
 
 unsigned Text::charAt(float x) const {
@@ -225,6 +264,10 @@ Rect2f Text::bounds() const {
 	return font().bounds(state_.text, state_.height);
 }
 
+Rect2f Text::drawBounds() const {
+	return disable_ ? Rect2f {} : pointBounds(posCache_);
+}
+
 Rect2f Text::ithBounds(unsigned n) const {
 	dlg_assert(valid() && state_.font.valid());
 
@@ -267,28 +310,13 @@ bool Text::disable(bool disable) {
 void Text::deviceLocal(bool set) {
 	if(deviceLocal_ != set) {
 		deviceLocal_ = set;
-
-		if(posBuf_.size()) {
-			auto needed = deviceLocal_ ?
-				context().device().deviceMemoryTypes() :
-				context().device().hostMemoryTypes();
-			auto ptype = posBuf_.buffer().memoryEntry().memory()->type();
-			auto uvtype = uvBuf_.buffer().memoryEntry().memory()->type();
-			bool ud = false;
-			if(!(needed & ptype)) {
-				posBuf_ = {};
-				ud = true;
-			}
-
-			if(!(needed & uvtype)) {
-				uvBuf_ = {};
-				ud = true;
-			}
-
-			if(ud) {
-				updateDevice();
-				context().rerecord();
-			}
+		if(cmd_.size()) {
+			// updateDevice allocates them in the other kind of memory.
+			// The old ranges are retired until pending frames completed
+			cmd_ = {};
+			vertices_ = {};
+			updateDevice();
+			context().rerecord(*this, "Text: deviceLocal changed");
 		}
 	}
 }
@@ -0,0 +1,184 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/textureAtlas.hpp>
+#include <rvg/context.hpp>
+#include <rvg/tracing.hpp>
+#include <vpp/vk.hpp>
+#include <dlg/dlg.hpp>
+#include <nytl/vecOps.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "stb_image.h"
+
+namespace rvg {
+
+constexpr auto padding = 1u; // transparent pixels between images
+
+TextureAtlas::TextureAtlas(Context& ctx, Vec2ui size, unsigned maxSize) :
+		DeviceObject(ctx), size_(size), maxSize_(maxSize) {
+	dlg_assert(size.x > 0 && size.y > 0);
+	dlg_assert(size.x <= maxSize && size.y <= maxSize);
+
+	data_.resize(size_.x * size_.y * 4u);
+	if(!ctx.bindless()) {
+		ds_ = {ctx.dsAllocator(), ctx.dsLayoutFontAtlas()};
+	}
+
+	// the texture is created in the first updateDevice call
+	ctx.registerUpdateDevice(this);
+}
+
+Rect2f TextureAtlas::add(Vec2ui size, nytl::Span<const std::byte> data) {
+	dlg_assert(valid());
+	dlg_assert(std::size_t(data.size()) >= size.x * size.y * 4u);
+
+	Vec2ui pos;
+	while(!pack(size, pos)) {
+		if(size_.x >= maxSize_ && size_.y >= maxSize_) {
+			throw std::runtime_error("TextureAtlas: image does not fit");
+		}
+
+		grow();
+	}
+
+	auto rowSize = size.x * 4u;
+	for(auto y = 0u; y < size.y; ++y) {
+		auto dst = ((pos.y + y) * size_.x + pos.x) * 4u;
+		std::memcpy(data_.data() + dst, data.data() + y * rowSize, rowSize);
+	}
+
+	if(dirtyMax_.x <= dirtyMin_.x || dirtyMax_.y <= dirtyMin_.y) {
+		dirtyMin_ = pos;
+		dirtyMax_ = pos + size;
+	} else {
+		dirtyMin_ = {std::min(dirtyMin_.x, pos.x),
+			std::min(dirtyMin_.y, pos.y)};
+		dirtyMax_ = {std::max(dirtyMax_.x, pos.x + size.x),
+			std::max(dirtyMax_.y, pos.y + size.y)};
+	}
+
+	context().registerUpdateDevice(this);
+	return {{float(pos.x), float(pos.y)}, {float(size.x), float(size.y)}};
+}
+
+Rect2f TextureAtlas::add(nytl::StringParam filename) {
+	int width, height, channels;
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height,
+		&channels, 4);
+	if(!data) {
+		std::string err = "Could not load image from ";
+		err += filename;
+		err += ": ";
+		err += stbi_failure_reason();
+		throw std::runtime_error(err);
+	}
+
+	auto size = Vec2ui {unsigned(width), unsigned(height)};
+	auto ptr = reinterpret_cast<const std::byte*>(data);
+	try {
+		auto ret = add(size, {ptr, size.x * size.y * 4u});
+		free(data);
+		return ret;
+	} catch(...) {
+		free(data);
+		throw;
+	}
+}
+
+bool TextureAtlas::pack(Vec2ui size, Vec2ui& pos) {
+	auto padded = size + Vec2ui {padding, padding};
+
+	// the shelf with enough space that wastes the least height
+	Shelf* shelf = nullptr;
+	for(auto& s : shelves_) {
+		if(s.height >= padded.y && s.width + padded.x <= size_.x &&
+				(!shelf || s.height < shelf->height)) {
+			shelf = &s;
+		}
+	}
+
+	if(!shelf) {
+		auto y = 0u;
+		if(!shelves_.empty()) {
+			y = shelves_.back().y + shelves_.back().height;
+		}
+
+		if(y + padded.y > size_.y || padded.x > size_.x) {
+			return false;
+		}
+
+		shelf = &shelves_.emplace_back();
+		*shelf = {y, padded.y, 0u};
+	}
+
+	pos = {shelf->width, shelf->y};
+	shelf->width += padded.x;
+	return true;
+}
+
+void TextureAtlas::grow() {
+	RVG_TRACE_EVENT("TextureAtlas::grow", "TextureAtlas");
+
+	// the packed regions stay where they are, the shelves only get
+	// wider and there is more space for new ones
+	auto old = size_;
+	auto oldData = std::move(data_);
+	size_.x = std::min(maxSize_, 2 * size_.x);
+	size_.y = std::min(maxSize_, 2 * size_.y);
+
+	data_.clear();
+	data_.resize(size_.x * size_.y * 4u);
+	for(auto y = 0u; y < old.y; ++y) {
+		std::memcpy(data_.data() + y * size_.x * 4u,
+			oldData.data() + y * old.x * 4u, old.x * 4u);
+	}
+}
+
+bool TextureAtlas::updateDevice() {
+	dlg_assert(valid());
+	RVG_TRACE_EVENT("TextureAtlas::updateDevice", "TextureAtlas");
+	auto& ctx = context();
+	bool rerecord = false;
+
+	auto dirtyPos = dirtyMin_;
+	auto dirtySize = dirtyMax_ - dirtyMin_;
+	auto dirty = dirtyMax_.x > dirtyMin_.x && dirtyMax_.y > dirtyMin_.y;
+	dirtyMin_ = dirtyMax_ = {};
+
+	if(size_ == texture_.size()) {
+		if(dirty) {
+			texture_.update(dirtyPos, dirtySize, data_);
+		}
+
+		return rerecord;
+	}
+
+	// old texture, descriptor and slot might still be used by
+	// pending frames
+	ctx.keepAlive(std::move(texture_));
+	texture_ = {ctx, size_, {data_.data(), data_.size()},
+		rvg::TextureType::rgba32};
+	ctx.rerecordCause(*this, "TextureAtlas: texture size changed");
+	rerecord = true;
+	RVG_TRACE_RERECORD(rerecord);
+
+	if(ctx.bindless()) {
+		ctx.keepAlive(std::move(texSlot_));
+		texSlot_ = ctx.bindlessTextures().allocate(texture_.vkImageView());
+		return rerecord;
+	}
+
+	ctx.keepAlive(std::move(ds_));
+	ds_ = {ctx.dsAllocator(), ctx.dsLayoutFontAtlas()};
+	vpp::DescriptorSetUpdate update(ds_);
+	update.imageSampler({{{}, texture_.vkImageView(),
+		vk::ImageLayout::shaderReadOnlyOptimal}});
+	return rerecord;
+}
+
+} // namespace rvg
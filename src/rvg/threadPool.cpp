@@ -0,0 +1,122 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/threadPool.hpp>
+#include <algorithm>
+
+namespace rvg {
+
+ThreadPool::ThreadPool(unsigned threads) {
+	threads_.reserve(threads);
+	for(auto i = 0u; i < threads; ++i) {
+		threads_.emplace_back([this]{ run(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(mutex_);
+		exit_ = true;
+	}
+
+	cv_.notify_all();
+	for(auto& thread : threads_) {
+		thread.join();
+	}
+}
+
+void ThreadPool::parallelFor(unsigned count,
+		const std::function<void(unsigned)>& func) {
+	if(count == 0) {
+		return;
+	}
+
+	// no need to wake anybody up for a single item
+	if(threads_.empty() || count == 1) {
+		for(auto i = 0u; i < count; ++i) {
+			func(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard lock(mutex_);
+		func_ = &func;
+		count_ = count;
+		// multiple chunks per thread for balancing, but big enough
+		// to not make the atomic counter a bottleneck
+		auto threads = unsigned(threads_.size() + 1);
+		chunk_ = std::max(1u, count / (8 * threads));
+		next_.store(0u);
+		active_ = threads_.size();
+		exception_ = {};
+		++generation_;
+	}
+
+	cv_.notify_all();
+	work(); // the calling thread participates
+
+	std::unique_lock lock(mutex_);
+	doneCv_.wait(lock, [&]{ return active_ == 0; });
+	func_ = {};
+
+	if(exception_) {
+		std::rethrow_exception(exception_);
+	}
+}
+
+void ThreadPool::run() {
+	std::uint64_t generation = 0u;
+	while(true) {
+		{
+			std::unique_lock lock(mutex_);
+			cv_.wait(lock, [&]{ return exit_ || generation_ != generation; });
+			if(exit_) {
+				return;
+			}
+
+			generation = generation_;
+		}
+
+		work();
+
+		{
+			std::lock_guard lock(mutex_);
+			--active_;
+		}
+
+		doneCv_.notify_one();
+	}
+}
+
+void ThreadPool::work() {
+	// func_, count_ and chunk_ are only written while no
+	// thread is working
+	auto& func = *func_;
+	auto count = count_;
+	auto chunk = chunk_;
+	while(true) {
+		auto begin = next_.fetch_add(chunk);
+		if(begin >= count) {
+			return;
+		}
+
+		auto end = std::min(begin + chunk, count);
+		try {
+			for(auto i = begin; i < end; ++i) {
+				func(i);
+			}
+		} catch(...) {
+			std::lock_guard lock(mutex_);
+			if(!exception_) {
+				exception_ = std::current_exception();
+			}
+
+			// skip remaining work
+			next_.store(count);
+		}
+	}
+}
+
+} // namespace rvg
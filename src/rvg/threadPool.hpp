@@ -0,0 +1,60 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#pragma once
+
+#include <nytl/nonCopyable.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rvg {
+
+/// Minimal fixed-size thread pool used by the Context to distribute
+/// independent per-object work (e.g. tessellation) in updateDevice.
+/// Not part of the public interface.
+class ThreadPool : public nytl::NonMovable {
+public:
+	/// Starts the given number of worker threads.
+	ThreadPool(unsigned threads);
+	~ThreadPool();
+
+	/// Calls func(i) for every i in [0, count) and returns when all
+	/// calls have finished. Indices are claimed dynamically in small
+	/// chunks by the workers and the calling thread, so idle threads
+	/// pick up work of busy ones. Must only be called from one thread
+	/// at a time. Rethrows the first exception thrown by func.
+	void parallelFor(unsigned count, const std::function<void(unsigned)>&);
+
+	unsigned size() const { return threads_.size(); }
+
+protected:
+	void run();
+	void work();
+
+protected:
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::condition_variable doneCv_;
+
+	// current job, guarded by mutex_
+	const std::function<void(unsigned)>* func_ {};
+	unsigned count_ {};
+	unsigned chunk_ {1};
+	unsigned active_ {}; // number of workers still in work()
+	std::uint64_t generation_ {};
+	std::exception_ptr exception_ {};
+	bool exit_ {};
+
+	std::atomic<unsigned> next_ {};
+};
+
+} // namespace rvg
@@ -0,0 +1,288 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/timer.hpp>
+#include <rvg/context.hpp>
+#include <rvg/recorder.hpp>
+#include <vpp/vk.hpp>
+#include <vpp/queue.hpp>
+#include <dlg/dlg.hpp>
+#include <algorithm>
+
+namespace rvg {
+
+// Scope
+GpuTimer::Scope::Scope(Recorder& rec, std::string_view name) :
+		recorder_(rec) {
+	if(auto* timer = rec.context().gpuTimer()) {
+		rec.timingScope(timer->beginScope(rec, name));
+	}
+}
+
+GpuTimer::Scope::~Scope() {
+	auto scope = recorder_.timingScope();
+	if(scope != noScope) {
+		recorder_.context().gpuTimer()->endScope(recorder_, scope);
+		recorder_.timingScope(noScope);
+	}
+}
+
+// GpuTimer
+GpuTimer::GpuTimer(Context& ctx) : context_(&ctx) {
+	auto& dev = ctx.device();
+	auto& qs = dev.queueSubmitter();
+	auto family = qs.queue().family();
+	auto families = vk::getPhysicalDeviceQueueFamilyProperties(
+		dev.vkPhysicalDevice());
+	auto bits = families[family].timestampValidBits;
+	if(!bits) {
+		dlg_warn("GpuTimer: the queue does not support timestamps");
+		return;
+	}
+
+	validMask_ = bits >= 64 ? ~std::uint64_t(0) :
+		(std::uint64_t(1) << bits) - 1;
+	period_ = dev.properties().limits.timestampPeriod;
+
+	queryCount_ = uploadQueries +
+		ctx.settings().gpuTimingScopes * queriesPerScope;
+	vk::QueryPoolCreateInfo info;
+	info.queryType = vk::QueryType::timestamp;
+	info.queryCount = queryCount_;
+	pool_ = vk::createQueryPool(dev, info);
+
+	// value and availability for every query
+	auto size = queryCount_ * 2 * sizeof(std::uint64_t);
+	auto flags = vk::CommandPoolCreateBits::resetCommandBuffer;
+	readbacks_.resize(ctx.settings().framesInFlight + 1);
+	for(auto& readback : readbacks_) {
+		readback.cmdBuf = dev.commandAllocator().get(family, flags);
+		readback.buffer = {ctx.bufferAllocator(), size,
+			vk::BufferUsageBits::transferDst, 8u, dev.hostMemoryTypes()};
+	}
+
+	// queries must be reset before their first use
+	auto& cb = readbacks_[0].cmdBuf;
+	vk::beginCommandBuffer(cb, {});
+	vk::cmdResetQueryPool(cb, pool_, 0, queryCount_);
+	vk::endCommandBuffer(cb);
+
+	vk::SubmitInfo submission;
+	submission.commandBufferCount = 1;
+	submission.pCommandBuffers = &cb.vkHandle();
+	qs.wait(qs.add(submission));
+}
+
+GpuTimer::~GpuTimer() {
+	if(!pool_) {
+		return;
+	}
+
+	auto& qs = context().device().queueSubmitter();
+	for(auto& readback : readbacks_) {
+		if(readback.submission) {
+			qs.wait(readback.submission);
+		}
+	}
+
+	vk::destroyQueryPool(context().device(), pool_);
+}
+
+unsigned GpuTimer::beginScope(Recorder& rec, std::string_view name) {
+	dlg_assertm(rec.timingScope() == noScope,
+		"GpuTimer: scopes can't be nested");
+	if(!pool_) {
+		return noScope;
+	}
+
+	auto it = std::find_if(scopes_.begin(), scopes_.end(),
+		[&](auto& scope) { return scope.name == name; });
+	if(it == scopes_.end()) {
+		if(scopes_.size() >= context().settings().gpuTimingScopes) {
+			dlg_warn("GpuTimer: too many scopes, {} is not measured", name);
+			return noScope;
+		}
+
+		auto& scope = scopes_.emplace_back();
+		scope.name = name;
+		scope.first = uploadQueries + (scopes_.size() - 1) * queriesPerScope;
+		it = scopes_.end() - 1;
+	}
+
+	auto& scope = *it;
+	scope.used = 1u;
+	scope.current = rec.category();
+	scope.intervals.clear();
+	scope.recorded = true;
+	write(rec.cmdBuf(), scope.first);
+	return it - scopes_.begin();
+}
+
+void GpuTimer::endScope(Recorder& rec, unsigned id) {
+	dlg_assert(id < scopes_.size());
+	auto& scope = scopes_[id];
+	write(rec.cmdBuf(), scope.first + scope.used);
+	scope.intervals.push_back(scope.current);
+	++scope.used;
+}
+
+void GpuTimer::categoryChanged(Recorder& rec, unsigned id) {
+	dlg_assert(id < scopes_.size());
+	auto& scope = scopes_[id];
+	if(scope.current == rec.category()) {
+		return;
+	}
+
+	// the last query is reserved for the end of the scope
+	if(scope.used + 1 >= queriesPerScope) {
+		scope.current = DrawCategory::none;
+		return;
+	}
+
+	write(rec.cmdBuf(), scope.first + scope.used);
+	scope.intervals.push_back(scope.current);
+	scope.current = rec.category();
+	++scope.used;
+}
+
+void GpuTimer::frame() {
+	if(!pool_) {
+		return;
+	}
+
+	++frame_;
+	auto& qs = context().device().queueSubmitter();
+
+	// The read back of framesInFlight calls ago has completed, like the
+	// frame rendered after it (as guaranteed by the caller of stageUpload).
+	// We still wait for it, which should never block.
+	auto& done = readbacks_[(readback_ + 1) % readbacks_.size()];
+	if(done.submission) {
+		qs.wait(done.submission);
+		done.submission = {};
+		resolve(done);
+	}
+
+	// read back the queries written by the frame rendered since the last
+	// call and reset them for the next one. Query commands are executed
+	// in submission order, the barrier makes sure that the rendering
+	// of pending frames has written its timestamps.
+	auto& readback = readbacks_[readback_];
+	readback_ = (readback_ + 1) % readbacks_.size();
+
+	auto& cb = readback.cmdBuf;
+	vk::CommandBufferBeginInfo beginInfo;
+	beginInfo.flags = vk::CommandBufferUsageBits::oneTimeSubmit;
+	vk::beginCommandBuffer(cb, beginInfo);
+	vk::cmdPipelineBarrier(cb, vk::PipelineStageBits::allCommands,
+		vk::PipelineStageBits::transfer, {}, {}, {}, {});
+
+	auto& buf = readback.buffer;
+	vk::cmdCopyQueryPoolResults(cb, pool_, 0, queryCount_, buf.buffer(),
+		buf.offset(), 2 * sizeof(std::uint64_t),
+		vk::QueryResultBits::e64 | vk::QueryResultBits::withAvailability);
+	vk::cmdResetQueryPool(cb, pool_, 0, queryCount_);
+
+	vk::MemoryBarrier barrier;
+	barrier.srcAccessMask = vk::AccessBits::transferWrite;
+	barrier.dstAccessMask = vk::AccessBits::hostRead;
+	vk::cmdPipelineBarrier(cb, vk::PipelineStageBits::transfer,
+		vk::PipelineStageBits::host, {}, {barrier}, {}, {});
+	vk::endCommandBuffer(cb);
+
+	// The reset must be executed before the next frame renders. It is
+	// added before the submission of that frame and the QueueSubmitter
+	// keeps the order, so it is submitted with it.
+	vk::SubmitInfo submission;
+	submission.commandBufferCount = 1;
+	submission.pCommandBuffers = &cb.vkHandle();
+	readback.submission = qs.add(submission);
+
+	// scopes recorded since the last call might not match the frame
+	readback.frame = frame_ - 1;
+	readback.upload = upload_;
+	readback.scopes.clear();
+	for(auto& scope : scopes_) {
+		if(!scope.recorded && scope.used > 1) {
+			readback.scopes.push_back(scope);
+		}
+
+		scope.recorded = false;
+	}
+
+	upload_ = false;
+}
+
+void GpuTimer::beginUpload(vk::CommandBuffer cb) {
+	if(pool_) {
+		vk::cmdWriteTimestamp(cb, vk::PipelineStageBits::transfer, pool_, 0);
+	}
+}
+
+void GpuTimer::endUpload(vk::CommandBuffer cb) {
+	if(pool_) {
+		vk::cmdWriteTimestamp(cb, vk::PipelineStageBits::transfer, pool_, 1);
+		upload_ = true;
+	}
+}
+
+void GpuTimer::write(vk::CommandBuffer cb, unsigned query) {
+	dlg_assert(query < queryCount_);
+	vk::cmdWriteTimestamp(cb, vk::PipelineStageBits::bottomOfPipe,
+		pool_, query);
+}
+
+void GpuTimer::resolve(Readback& readback) {
+	auto map = readback.buffer.memoryMap();
+	if(!map.coherent()) {
+		map.invalidate();
+	}
+
+	auto data = reinterpret_cast<const std::uint64_t*>(map.ptr());
+	auto available = [&](unsigned query) { return data[2 * query + 1]; };
+	auto ns = [&](unsigned from, unsigned to) {
+		auto ticks = (data[2 * to] - data[2 * from]) & validMask_;
+		return double(ticks) * period_;
+	};
+
+	FrameTimes times;
+	times.frame = readback.frame;
+	auto upload = unsigned(DrawCategory::upload);
+	if(readback.upload && available(0) && available(1)) {
+		times.categories[upload] = ns(0, 1);
+	}
+
+	for(auto& scope : readback.scopes) {
+		// not all queries are available if the scope wasn't executed
+		auto end = scope.first + scope.used;
+		auto complete = true;
+		for(auto q = scope.first; q < end; ++q) {
+			complete &= bool(available(q));
+		}
+
+		if(!complete) {
+			continue;
+		}
+
+		auto& time = times.scopes.emplace_back();
+		time.name = scope.name;
+		time.ns = ns(scope.first, end - 1);
+		time.categories = {};
+		for(auto i = 0u; i < scope.intervals.size(); ++i) {
+			auto category = scope.intervals[i];
+			if(category != DrawCategory::none) {
+				auto q = scope.first + i;
+				time.categories[unsigned(category)] += ns(q, q + 1);
+			}
+		}
+
+		for(auto i = 0u; i < drawCategoryCount; ++i) {
+			times.categories[i] += time.categories[i];
+		}
+	}
+
+	times_ = std::move(times);
+}
+
+} // namespace rvg
@@ -0,0 +1,120 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <rvg/trace.hpp>
+#include <rvg/tracing.hpp>
+
+#ifdef RVG_TRACE
+
+#include <dlg/dlg.hpp>
+#include <cstdio>
+#include <mutex>
+
+namespace rvg {
+namespace trace {
+
+thread_local Counters counters;
+std::atomic<bool> enabled {false};
+
+namespace {
+
+struct Writer {
+	std::mutex mutex;
+	std::FILE* file {};
+	bool first {};
+	Clock::time_point start;
+};
+
+Writer& writer() {
+	static Writer writer;
+	return writer;
+}
+
+unsigned threadID() {
+	static std::atomic<unsigned> next {1u};
+	thread_local auto id = next.fetch_add(1u);
+	return id;
+}
+
+void close(Writer& w) {
+	enabled.store(false);
+	if(w.file) {
+		std::fputs("\n]}\n", w.file);
+		std::fclose(w.file);
+		w.file = {};
+	}
+}
+
+} // anonymous namespace
+
+void write(const char* name, const char* type, Clock::time_point start,
+		Clock::time_point end, std::uint64_t bytes, bool rerecord) {
+	using Micro = std::chrono::duration<double, std::micro>;
+	auto tid = threadID();
+	auto& w = writer();
+	std::lock_guard lock(w.mutex);
+	if(!w.file) { // trace was stopped in the meantime
+		return;
+	}
+
+	std::fprintf(w.file, "%s\n{\"name\":\"%s\",\"cat\":\"rvg\",\"ph\":\"X\","
+		"\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{"
+		"\"type\":\"%s\",\"bytes\":%llu,\"rerecord\":%s}}",
+		w.first ? "" : ",", name,
+		Micro(start - w.start).count(), Micro(end - start).count(), tid,
+		type, static_cast<unsigned long long>(bytes),
+		rerecord ? "true" : "false");
+	w.first = false;
+}
+
+} // namespace trace
+
+bool traceAvailable() {
+	return true;
+}
+
+bool startTrace(const char* file) {
+	auto& w = trace::writer();
+	std::lock_guard lock(w.mutex);
+	trace::close(w);
+
+	w.file = std::fopen(file, "w");
+	if(!w.file) {
+		dlg_warn("startTrace: could not open '{}'", file);
+		return false;
+	}
+
+	std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", w.file);
+	w.first = true;
+	w.start = trace::Clock::now();
+	trace::enabled.store(true);
+	return true;
+}
+
+void stopTrace() {
+	auto& w = trace::writer();
+	std::lock_guard lock(w.mutex);
+	trace::close(w);
+}
+
+} // namespace rvg
+
+#else // RVG_TRACE
+
+namespace rvg {
+
+bool traceAvailable() {
+	return false;
+}
+
+bool startTrace(const char*) {
+	return false;
+}
+
+void stopTrace() {
+}
+
+} // namespace rvg
+
+#endif // RVG_TRACE
@@ -0,0 +1,119 @@
+// Copyright (c) 2018 nyorain
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Internal trace points, see rvg/trace.hpp.
+// Without RVG_TRACE all macros expand to nothing and their
+// arguments are not evaluated.
+//
+// RVG_TRACE_EVENT(name, type): traces the rest of the current scope.
+// RVG_TRACE_BYTES(n): adds n written bytes to all active events
+//   of this thread.
+// RVG_TRACE_RERECORD(r): marks the event of the current scope as
+//   rerecording if r is true.
+// RVG_TRACE_COUNT_RERECORD(): marks all active events of this
+//   thread as rerecording. Called by Context::rerecord.
+
+#pragma once
+
+#include <rvg/trace.hpp>
+
+#ifdef RVG_TRACE
+
+#include <rvg/fwd.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace rvg::trace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Per-thread totals, events report the difference over their duration.
+struct Counters {
+	std::uint64_t bytes {};
+	std::uint64_t rerecords {};
+};
+
+extern thread_local Counters counters;
+extern std::atomic<bool> enabled;
+
+inline bool active() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void write(const char* name, const char* type, Clock::time_point start,
+	Clock::time_point end, std::uint64_t bytes, bool rerecord);
+
+/// Scope guard for a single event. Does nothing if no trace is running
+/// at its construction.
+class Event {
+public:
+	Event(const char* name, const char* type) : name_(name), type_(type) {
+		if(active()) {
+			active_ = true;
+			bytes_ = counters.bytes;
+			rerecords_ = counters.rerecords;
+			start_ = Clock::now();
+		}
+	}
+
+	~Event() {
+		if(active_) {
+			rerecord_ |= counters.rerecords != rerecords_;
+			write(name_, type_, start_, Clock::now(),
+				counters.bytes - bytes_, rerecord_);
+		}
+	}
+
+	void rerecord(bool r) { rerecord_ |= r; }
+
+protected:
+	const char* name_;
+	const char* type_;
+	bool active_ {};
+	bool rerecord_ {};
+	std::uint64_t bytes_ {};
+	std::uint64_t rerecords_ {};
+	Clock::time_point start_ {};
+};
+
+// object type names
+inline const char* typeName(const Polygon&) { return "Polygon"; }
+inline const char* typeName(const Text&) { return "Text"; }
+inline const char* typeName(const Paint&) { return "Paint"; }
+inline const char* typeName(const Texture&) { return "Texture"; }
+inline const char* typeName(const Transform&) { return "Transform"; }
+inline const char* typeName(const Scissor&) { return "Scissor"; }
+inline const char* typeName(const FontAtlas&) { return "FontAtlas"; }
+inline const char* typeName(const DrawBatch&) { return "DrawBatch"; }
+inline const char* typeName(const SdfShape&) { return "SdfShape"; }
+inline const char* typeName(const ShapeBatch&) { return "ShapeBatch"; }
+inline const char* typeName(const TextureAtlas&) { return "TextureAtlas"; }
+inline const char* typeName(const SpriteBatch&) { return "SpriteBatch"; }
+inline const char* typeName(const BindlessBuffer&) {
+	return "BindlessBuffer";
+}
+
+template<typename T>
+const char* typeName(const T&) { return "DeviceObject"; }
+
+} // namespace rvg::trace
+
+#define RVG_TRACE_EVENT(name, type) \
+	::rvg::trace::Event rvgTraceEvent_((name), (type))
+#define RVG_TRACE_BYTES(n) \
+	(::rvg::trace::active() ? \
+		void(::rvg::trace::counters.bytes += (n)) : void())
+#define RVG_TRACE_RERECORD(r) rvgTraceEvent_.rerecord(r)
+#define RVG_TRACE_COUNT_RERECORD() (++::rvg::trace::counters.rerecords)
+
+#else // RVG_TRACE
+
+#define RVG_TRACE_EVENT(name, type) ((void) 0)
+#define RVG_TRACE_BYTES(n) ((void) 0)
+#define RVG_TRACE_RERECORD(r) ((void) 0)
+#define RVG_TRACE_COUNT_RERECORD() ((void) 0)
+
+#endif // RVG_TRACE
@@ -5,11 +5,16 @@
 #pragma once
 
 #include <rvg/context.hpp>
+#include <rvg/tracing.hpp>
 #include <vpp/bufferOps.hpp>
+#include <vpp/vk.hpp>
 #include <dlg/dlg.hpp>
+#include <nytl/span.hpp>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <type_traits>
 
 namespace rvg {
 
@@ -19,17 +24,91 @@ void write(std::byte*& ptr, T&& data) {
 	ptr += sizeof(data);
 }
 
-template<typename O, typename... Args>
-void upload140(O& dobj, const vpp::BufferSpan& buf, const Args&... args) {
+/// Returns the bytes of count objects starting at obj, for upload140.
+template<typename T>
+nytl::Span<const std::byte> raw(const T& obj, std::size_t count = 1u) {
+	return {reinterpret_cast<const std::byte*>(&obj), sizeof(T) * count};
+}
+
+/// Uploads the given raw data tightly packed (like vpp::raw data in a
+/// std140 buffer) to the given buffer range. Mappable buffers are written
+/// directly if the context allows it, otherwise the data is copied into
+/// the persistently mapped staging arena and a copy is recorded.
+template<typename O, typename... Data>
+void upload140(O& dobj, const vpp::BufferSpan& buf, const Data&... data) {
+	static_assert((std::is_same_v<Data, nytl::Span<const std::byte>> && ...),
+		"upload140 expects rvg::raw data");
 	dlg_assert(buf.valid());
-	if(buf.buffer().mappable()) {
-		vpp::writeMap140(buf, args...);
-	} else {
-		auto cmdBuf = dobj.context().uploadCmdBuf();
-		dobj.context().addStage(vpp::writeStaging(cmdBuf, buf,
-			vpp::BufferLayout::std140, args...));
-		dobj.context().addCommandBuffer(&dobj, std::move(cmdBuf));
+	RVG_TRACE_EVENT("upload140", ::rvg::trace::typeName(dobj));
+
+	auto& ctx = dobj.context();
+	auto size = (vk::DeviceSize(0u) + ... + vk::DeviceSize(data.size()));
+	if(!size) {
+		return;
+	}
+
+	if(buf.buffer().mappable() && ctx.directWrites()) {
+		RVG_TRACE_BYTES(size);
+		ctx.countWrite(size);
+		vpp::writeMap140(buf, vpp::raw(*data.data(), data.size())...);
+		return;
+	}
+
+	// traced by stage
+	auto stage = ctx.stage(size);
+	auto ptr = stage.data;
+	((std::memcpy(ptr, data.data(), data.size()), ptr += data.size()), ...);
+	ctx.addCopy(dobj, stage.span.buffer(), buf.buffer(),
+		{stage.span.offset(), buf.offset(), size});
+}
+
+/// Whether the given rect has no area.
+inline bool isEmpty(const Rect2f& rect) {
+	return rect.size.x <= 0.f || rect.size.y <= 0.f;
+}
+
+/// Returns the bounds of both rects. Empty rects are ignored.
+inline Rect2f uniteRects(const Rect2f& a, const Rect2f& b) {
+	if(isEmpty(a)) {
+		return b;
+	} else if(isEmpty(b)) {
+		return a;
 	}
+
+	auto x = std::min(a.position.x, b.position.x);
+	auto y = std::min(a.position.y, b.position.y);
+	auto ex = std::max(a.position.x + a.size.x, b.position.x + b.size.x);
+	auto ey = std::max(a.position.y + a.size.y, b.position.y + b.size.y);
+	return {x, y, ex - x, ey - y};
+}
+
+/// Returns the intersection of both rects, an empty rect if there is none.
+inline Rect2f intersectRects(const Rect2f& a, const Rect2f& b) {
+	auto x = std::max(a.position.x, b.position.x);
+	auto y = std::max(a.position.y, b.position.y);
+	auto ex = std::min(a.position.x + a.size.x, b.position.x + b.size.x);
+	auto ey = std::min(a.position.y + a.size.y, b.position.y + b.size.y);
+	if(ex <= x || ey <= y) {
+		return {};
+	}
+
+	return {x, y, ex - x, ey - y};
+}
+
+/// Returns the bounds of the given points.
+inline Rect2f pointBounds(Span<const Vec2f> points) {
+	if(points.empty()) {
+		return {};
+	}
+
+	auto min = points[0];
+	auto max = points[0];
+	for(auto& p : points) {
+		min = {std::min(min.x, p.x), std::min(min.y, p.y)};
+		max = {std::max(max.x, p.x), std::max(max.y, p.y)};
+	}
+
+	return {min.x, min.y, max.x - min.x, max.y - min.y};
 }
 
 } // namespace rvg
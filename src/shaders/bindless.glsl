@@ -0,0 +1,32 @@
+// State tables used in bindless mode, see rvg::ContextSettings::bindless.
+// Every draw selects its entries with the push constant indices.
+
+struct PaintEntry {
+	mat4 matrix;
+	vec4 inner;
+	vec4 outer;
+	vec4 custom;
+	uint type;
+	uint texture;
+};
+
+layout(row_major, std430, set = 0, binding = 0) readonly buffer Transforms {
+	mat4 matrices[];
+} transforms;
+
+layout(row_major, std430, set = 0, binding = 1) readonly buffer Paints {
+	PaintEntry entries[];
+} paints;
+
+layout(std430, set = 0, binding = 2) readonly buffer Scissors {
+	vec4 rects[]; // xy: position, zw: size
+} scissors;
+
+layout(push_constant) uniform Indices {
+	uint type;
+	uint transform;
+	uint paint;
+	uint scissor;
+	uint font;
+	float strokeMult;
+} indices;
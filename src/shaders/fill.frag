@@ -9,31 +9,121 @@ layout(location = 2) in vec4 in_color;
 
 layout(location = 0) out vec4 out_color;
 
-layout(set = 1, binding = 1) uniform Paint {
-	PaintData data;
-} paint;
-
-layout(set = 1, binding = 2) uniform sampler2D tex;
-layout(set = 2, binding = 0) uniform sampler2D font;
-
 const uint TypeDefault = 0;
 const uint TypeText = 1;
 const uint TypeStroke = 2;
-layout(push_constant) uniform Type {
-	uint type;
-} type;
+
+// Pipeline variants specialize the draw and paint type, so that
+// e.g. plain color fills don't branch over the other paint types.
+// AnyType reads them at runtime. See Context::pipeline.
+const uint AnyType = 0xFFFFFFFFu;
+layout(constant_id = 1) const uint drawTypeSpec = 0xFFFFFFFFu;
+layout(constant_id = 2) const uint paintTypeSpec = 0xFFFFFFFFu;
+
+uint specialized(uint spec, uint dynamic) {
+	return spec == AnyType ? dynamic : spec;
+}
+
+#ifdef BINDLESS
+	#include "bindless.glsl"
+
+	// size of the array, set to ContextSettings::bindlessTextures
+	layout(constant_id = 0) const uint textureCount = 64;
+	layout(set = 0, binding = 3) uniform sampler2D textures[textureCount];
+
+	uint drawType() {
+		return indices.type;
+	}
+
+	vec4 scissorRect() {
+		return scissors.rects[indices.scissor];
+	}
+
+	float strokeMult() {
+		return indices.strokeMult;
+	}
+
+	vec4 fontColor(vec2 uv) {
+		return texture(textures[indices.font], uv);
+	}
+
+	// the sprite atlas is bound like the font atlas
+	vec4 atlasColor(vec2 pixel) {
+		vec2 size = vec2(textureSize(textures[indices.font], 0));
+		return texture(textures[indices.font], pixel / size);
+	}
+
+	vec4 drawColor(vec2 coords, vec4 col) {
+		PaintEntry entry = paints.entries[indices.paint];
+		return paintColor(coords, PaintData(
+			entry.inner,
+			entry.outer,
+			entry.custom,
+			specialized(paintTypeSpec, entry.type)),
+			textures[entry.texture], col);
+	}
+#else // BINDLESS
+	layout(set = 1, binding = 1) uniform Paint {
+		PaintData data;
+	} paint;
+
+	layout(set = 1, binding = 2) uniform sampler2D tex;
+	layout(set = 2, binding = 0) uniform sampler2D font;
+
+	layout(push_constant) uniform Type {
+		uint type;
+	} type;
+
+	uint drawType() {
+		return type.type;
+	}
+
+	#ifdef FRAG_SCISSOR
+		layout(set = 3, binding = 0) uniform Scissor {
+			vec2 pos;
+			vec2 size;
+		} scissor;
+
+		vec4 scissorRect() {
+			return vec4(scissor.pos, scissor.size);
+		}
+	#endif
+
+	#ifdef EDGE_AA
+		layout(set = 4, binding = 0) uniform Stroke {
+			float mult;
+		} stroke;
+
+		float strokeMult() {
+			return stroke.mult;
+		}
+	#endif
+
+	vec4 fontColor(vec2 uv) {
+		return texture(font, uv);
+	}
+
+	// the sprite atlas is bound like the font atlas
+	vec4 atlasColor(vec2 pixel) {
+		return texture(font, pixel / vec2(textureSize(font, 0)));
+	}
+
+	vec4 drawColor(vec2 coords, vec4 col) {
+		return paintColor(coords, PaintData(
+			paint.data.inner,
+			paint.data.outer,
+			paint.data.custom,
+			specialized(paintTypeSpec, paint.data.type)), tex, col);
+	}
+#endif
 
 // - scissor -
 #ifdef FRAG_SCISSOR
 	layout(location = 3) in vec2 in_rawpos;
 
-	layout(set = 3, binding = 0) uniform Scissor {
-		vec2 pos;
-		vec2 size;
-	} scissor;
-
 	void applyScissor() {
-		vec2 c = clamp(in_rawpos, scissor.pos, scissor.pos + scissor.size);
+		vec4 rect = scissorRect();
+		vec2 c = clamp(in_rawpos, rect.xy, rect.xy + rect.zw);
 		if(in_rawpos != c) {
 			discard;
 		}
@@ -42,30 +132,91 @@ layout(push_constant) uniform Type {
 	void applyScissor() {}
 #endif
 
-// - anti aliasing -
-#ifdef EDGE_AA
-	layout(set = 4, binding = 0) uniform Stroke {
-		float mult;
-	} stroke;
-#endif
+// - analytic shapes -
+#ifdef SDF
+	// see fill.vert, in_uv is the position relative to the center
+	layout(location = 4) flat in vec4 in_shape; // xy: half size, z: stroke
+	layout(location = 5) flat in vec4 in_radii;
+	layout(location = 6) flat in uint in_flags;
+
+	const uint FlagEllipse = 1u;
+	const uint FlagAA = 2u;
+
+	// signed distance to a rect with the given half size and
+	// corner radii (topLeft, topRight, bottomRight, bottomLeft)
+	float roundedRect(vec2 p, vec2 b, vec4 radii) {
+		float r = p.x > 0.0 ?
+			(p.y > 0.0 ? radii.z : radii.y) :
+			(p.y > 0.0 ? radii.w : radii.x);
+		r = min(r, min(b.x, b.y));
+		vec2 q = abs(p) - b + r;
+		return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - r;
+	}
+
+	// approximated signed distance to an ellipse with the given radii,
+	// exact for circles
+	float ellipse(vec2 p, vec2 ab) {
+		float k1 = length(p / (ab * ab));
+		if(k1 < 1e-6) {
+			return -min(ab.x, ab.y);
+		}
+
+		float k0 = length(p / ab);
+		return k0 * (k0 - 1.0) / k1;
+	}
+
+	// The part of the fragment covered by the fill or stroke.
+	// Must be evaluated in uniform control flow for fwidth.
+	float coverage(uint type) {
+		float d = (in_flags & FlagEllipse) != 0 ?
+			ellipse(in_uv, in_shape.xy) :
+			roundedRect(in_uv, in_shape.xy, in_radii);
+		if(type == TypeStroke) {
+			d = abs(d) - 0.5 * in_shape.z;
+		}
+
+		float fw = max(fwidth(d), 1e-5);
+		if((in_flags & FlagAA) != 0) {
+			return clamp(0.5 - d / fw, 0.0, 1.0);
+		}
+
+		return float(d <= 0.0);
+	}
+#endif // SDF
 
 // - main -
+#ifdef SDF
+void main() {
+	uint type = specialized(drawTypeSpec, drawType());
+	float cov = coverage(type);
+	if(cov <= 0.0) {
+		discard;
+	}
+
+	applyScissor();
+	out_color = drawColor(in_paint, in_color);
+	out_color.a *= cov;
+}
+#elif defined(SPRITE)
+void main() {
+	// in_uv is the position in the atlas in pixels, see fill.vert
+	applyScissor();
+	out_color = drawColor(in_paint, in_color) * atlasColor(in_uv);
+}
+#else // SDF
 void main() {
 	applyScissor();
-	out_color = paintColor(in_paint, PaintData(
-		paint.data.inner,
-		paint.data.outer,
-		paint.data.custom,
-		paint.data.type), tex, in_color);
+	out_color = drawColor(in_paint, in_color);
 
-	if(type.type == TypeText) {
-		out_color.a *= texture(font, in_uv).a;
+	uint type = specialized(drawTypeSpec, drawType());
+	if(type == TypeText) {
+		out_color.a *= fontColor(in_uv).a;
 	}
 
 #ifdef EDGE_AA
-	if(type.type == TypeStroke) {
-		// float fac = (1.0 - abs(in_uv.y)) * stroke.mult * in_uv.x;
-		float fac = (min(1.0, 1.0 - abs(in_uv.y)) * stroke.mult) * in_uv.x;
+	if(type == TypeStroke) {
+		// float fac = (1.0 - abs(in_uv.y)) * strokeMult() * in_uv.x;
+		float fac = (min(1.0, 1.0 - abs(in_uv.y)) * strokeMult()) * in_uv.x;
 		out_color.a *= fac;
 	}
 #endif
@@ -73,3 +224,4 @@ void main() {
 	// float gamma = 2.2;
 	// out_color.rgb = pow(out_color.rgb, vec3(gamma));
 }
+#endif // SDF, SPRITE
@@ -1,28 +1,109 @@
 #version 450
 
-layout(location = 0) in vec2 in_pos;
-layout(location = 1) in vec2 in_uv;
-layout(location = 2) in vec4 in_color;
+#extension GL_GOOGLE_include_directive : enable
+
+#ifdef SDF
+	// Analytic shapes: one instance per shape, drawn as a quad strip
+	// of 4 vertices. See rvg::SdfInstance for the layout.
+	layout(location = 0) in vec4 in_rect; // xy: position, zw: size
+	layout(location = 1) in vec4 in_radii;
+	layout(location = 2) in vec4 in_color;
+	layout(location = 3) in float in_stroke;
+	layout(location = 4) in uint in_flags;
+
+	// passed to the fragment shader, out_uv is the position
+	// relative to the center of the shape
+	layout(location = 4) flat out vec4 out_shape; // xy: half size, z: stroke
+	layout(location = 5) flat out vec4 out_radii;
+	layout(location = 6) flat out uint out_flags;
+
+	const uint TypeStroke = 2;
+	const uint FlagAA = 2u;
+	const uint FlagDisableFill = 4u;
+	const uint FlagDisableStroke = 8u;
+	const float fringe = 1.5; // Context::fringe
+
+	// see fill.frag
+	layout(constant_id = 1) const uint drawTypeSpec = 0xFFFFFFFFu;
+#elif defined(SPRITE)
+	// Atlas images: one instance per sprite, drawn as a quad strip
+	// of 4 vertices. See rvg::SpriteInstance for the layout.
+	layout(location = 0) in vec4 in_axes; // xy: x axis, zw: y axis
+	layout(location = 1) in vec2 in_origin;
+	layout(location = 2) in vec4 in_color;
+	layout(location = 3) in vec4 in_region; // in atlas pixels
+	layout(location = 4) in uint in_flags;
+
+	const uint FlagDisabled = 1u;
+#else // SDF
+	layout(location = 0) in vec2 in_pos;
+	layout(location = 1) in vec2 in_uv;
+	layout(location = 2) in vec4 in_color;
+#endif
 
 layout(location = 0) out vec2 out_uv;
 layout(location = 1) out vec2 out_paint;
 layout(location = 2) out vec4 out_color;
 
-layout(row_major, set = 0, binding = 0) uniform Transform {
-	mat4 matrix;
-} transform;
+#ifdef BINDLESS
+	#include "bindless.glsl"
 
-layout(row_major, set = 1, binding = 0) uniform Paint {
-	mat4 matrix;
-} paint;
+	mat4 transformMatrix() {
+		return transforms.matrices[indices.transform];
+	}
+
+	mat4 paintMatrix() {
+		return paints.entries[indices.paint].matrix;
+	}
+
+	uint drawType() {
+		return indices.type;
+	}
+#else // BINDLESS
+	layout(row_major, set = 0, binding = 0) uniform Transform {
+		mat4 matrix;
+	} transform;
+
+	layout(row_major, set = 1, binding = 0) uniform Paint {
+		mat4 matrix;
+	} paint;
+
+	mat4 transformMatrix() {
+		return transform.matrix;
+	}
+
+	mat4 paintMatrix() {
+		return paint.matrix;
+	}
+
+	#ifdef SDF
+		layout(push_constant) uniform Type {
+			uint type;
+		} type;
+
+		uint drawType() {
+			return type.type;
+		}
+	#endif
+#endif
 
 #if defined(PLANE_SCISSOR)
 	out float gl_ClipDistance[4];
 
-	layout(set = 3, binding = 0) uniform Scissor {
-		vec2 pos;
-		vec2 size;
-	} scissor;
+	#ifdef BINDLESS
+		vec4 scissorRect() {
+			return scissors.rects[indices.scissor];
+		}
+	#else
+		layout(set = 3, binding = 0) uniform Scissor {
+			vec2 pos;
+			vec2 size;
+		} scissor;
+
+		vec4 scissorRect() {
+			return vec4(scissor.pos, scissor.size);
+		}
+	#endif
 
 	vec2 point(vec2 rpos, vec2 rsize, uint id) {
 		vec2 ret = rpos;
@@ -31,31 +112,81 @@ layout(row_major, set = 1, binding = 0) uniform Paint {
 		return ret;
 	}
 
-	void applyScissor() {
+	void applyScissor(vec2 pos) {
+		const vec4 rect = scissorRect();
+		const vec2 rpos = rect.xy;
+		const vec2 rsize = rect.zw;
 		uint last = 3;
 		for(int i = 0; i < 4; ++i) {
-			const vec2 p = point(scissor.pos, scissor.size, i);
-			const vec2 diff = point(scissor.pos, scissor.size, last) - p;
+			const vec2 p = point(rpos, rsize, i);
+			const vec2 diff = point(rpos, rsize, last) - p;
 			const vec2 normal = normalize(vec2(diff.y, -diff.x));
-			gl_ClipDistance[i] = dot(in_pos, normal) - dot(p, normal);
+			gl_ClipDistance[i] = dot(pos, normal) - dot(p, normal);
 			last = i;
 		}
 	}
 #elif defined(FRAG_SCISSOR)
 	layout(location = 3) out vec2 out_rawpos;
 
-	void applyScissor() {
-		out_rawpos = in_pos;
+	void applyScissor(vec2 pos) {
+		out_rawpos = pos;
 	}
 #else
-	void applyScissor() {}
+	void applyScissor(vec2 pos) {}
 #endif
 
+#ifdef SDF
+void main() {
+	uint type = drawTypeSpec == 0xFFFFFFFFu ? drawType() : drawTypeSpec;
+	bool stroke = (type == TypeStroke);
+	uint disable = stroke ? FlagDisableStroke : FlagDisableFill;
+	if((in_flags & disable) != 0) {
+		gl_Position = vec4(-2.0, -2.0, 0.0, 1.0); // degenerate, clipped
+		return;
+	}
+
+	// the quad covers the stroke and the anti aliasing fringe
+	float expand = stroke ? 0.5 * in_stroke : 0.0;
+	expand += (in_flags & FlagAA) != 0 ? fringe : 0.0;
+
+	vec2 halfSize = 0.5 * in_rect.zw;
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	vec2 local = (2.0 * corner - 1.0) * (halfSize + expand);
+	vec2 pos = in_rect.xy + halfSize + local;
+
+	gl_Position = transformMatrix() * vec4(pos, 0.0, 1.0);
+	out_paint = (paintMatrix() * vec4(pos, 0.0, 1.0)).xy;
+	out_uv = local;
+	out_color = in_color;
+
+	out_shape = vec4(halfSize, in_stroke, 0.0);
+	out_radii = in_radii;
+	out_flags = in_flags;
+	applyScissor(pos);
+}
+#elif defined(SPRITE)
+void main() {
+	if((in_flags & FlagDisabled) != 0) {
+		gl_Position = vec4(-2.0, -2.0, 0.0, 1.0); // degenerate, clipped
+		return;
+	}
+
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	vec2 pos = in_origin + corner.x * in_axes.xy + corner.y * in_axes.zw;
+
+	gl_Position = transformMatrix() * vec4(pos, 0.0, 1.0);
+	out_paint = (paintMatrix() * vec4(pos, 0.0, 1.0)).xy;
+	out_uv = in_region.xy + corner * in_region.zw;
+	out_color = in_color;
+	applyScissor(pos);
+}
+#else // SDF
 void main() {
-	gl_Position = transform.matrix * vec4(in_pos, 0.0, 1.0);
-	out_paint = (paint.matrix * vec4(in_pos, 0.0, 1.0)).xy;
+	gl_Position = transformMatrix() * vec4(in_pos, 0.0, 1.0);
+	out_paint = (paintMatrix() * vec4(in_pos, 0.0, 1.0)).xy;
 	out_uv = in_uv;
 
 	out_color = in_color;
-	applyScissor();
+	applyScissor(in_pos);
 }
+#endif // SDF, SPRITE